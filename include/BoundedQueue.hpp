@@ -0,0 +1,78 @@
+/*
+BoundedQueue为有界的多生产者多消费者队列，用于连接流水线的各个阶段：
+队列满时push阻塞(反压，上游不会无限制地堆积数据)，队列空时pop阻塞；
+close之后push失败，pop取完剩余元素后返回false，下游据此结束。
+*/
+#ifndef _BOUNDED_QUEUE_HPP_
+#define _BOUNDED_QUEUE_HPP_
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+template <typename T>
+class BoundedQueue
+{
+private:
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    std::mutex mtx;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(capacity, 1)) {}
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    // 队列满时等待，队列已关闭时返回false
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        not_full.wait(lock, [this]
+                      { return closed || items.size() < capacity; });
+        if (closed)
+            return false;
+        items.push_back(std::move(item));
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+    // 队列空时等待，队列已关闭且为空时返回false
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        not_empty.wait(lock, [this]
+                       { return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        return true;
+    }
+
+    // 不再接受新元素，唤醒所有等待的生产者和消费者
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            closed = true;
+        }
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return items.size();
+    }
+};
+
+#endif // _BOUNDED_QUEUE_HPP_
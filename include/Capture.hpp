@@ -20,6 +20,8 @@ Capture用于调用tcpdump进行抓包，并将抓到的数据包保存到pcap
 #include <cstring>
 #include <sys/wait.h>
 
+#include "LabelMap.hpp"
+
 class Capture
 {
 private:
@@ -64,7 +66,7 @@ public:
         }
 
         // 构建pcap储存目录
-        std::string site_name = extract_site_name_from_url(host);
+        std::string site_name = LabelMap::site_name_from_domain(host);
 
         std::string all_data_dir = "../data";
         std::string pcap_dir = all_data_dir + "/" + site_name;
@@ -76,12 +78,49 @@ public:
 
         std::string timestamp = std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
         std::string pcap_file = pcap_dir + "/" + timestamp + ".pcap";
+        return start_process(pcap_file, filter_cmd);
+    }
+
+    /*
+    @brief 抓包写入指定的pcap文件，使用构造时给出的过滤规则。用于整个采集过程只启动一次tcpdump，
+           抓到的包事后按会话分离(见SessionDemux)
+    @param file_size_mb 大于0时每个文件写满该大小(百万字节)后切换到下一个文件(tcpdump -C)
+    @param file_count 大于0时最多保留该数量的文件，文件名为pcap_file加编号，写满后覆盖最早的文件(tcpdump -W)
+    */
+    bool start_file(const std::string &pcap_file, size_t file_size_mb = 0, size_t file_count = 0)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (capturing)
+        {
+            std::cerr << "[WARN] tcpdump is already running. Unable to start capturing again." << std::endl;
+            return false;
+        }
+        size_t last_slash = pcap_file.find_last_of('/');
+        if (last_slash != std::string::npos && !ensure_dir_exists(pcap_file.substr(0, last_slash)))
+            return false;
+
+        std::string options;
+        if (file_size_mb > 0)
+        {
+            // 切换文件时tcpdump默认会降低权限，-Z root保证后续文件仍可写入采集目录
+            options += " -C " + std::to_string(file_size_mb) + " -Z root";
+            if (file_count > 0)
+                options += " -W " + std::to_string(file_count);
+        }
+        return start_process(pcap_file, filter, options);
+    }
+
+private:
+    // fork并exec tcpdump，调用者持有mtx
+    bool start_process(const std::string &pcap_file, const std::string &filter_cmd, const std::string &options = "")
+    {
         output_file = pcap_file; //* 更新output_file，供stop调用
         std::cout << "[INFO] Setting up capture to output file: " << pcap_file << std::endl;
 
         // 构建tcpdump命令并exec
         std::stringstream tcpdump_cmd; // tcpdump -i any -w ../data/baidu/123.pcap host www.baidu.com and port 443
-        tcpdump_cmd << "tcpdump -i" << interface << " -w " << pcap_file << " " << filter_cmd;
+        tcpdump_cmd << "tcpdump -i" << interface << options << " -w " << pcap_file << " " << filter_cmd;
         std::cout << "[INFO] Running tcpdump with command: " << tcpdump_cmd.str() << std::endl
                   << std::flush;
 
@@ -163,6 +202,7 @@ public:
         return true;
     }
 
+public:
     bool stop()
     {
         std::lock_guard<std::mutex> lock(mtx);
@@ -185,6 +225,7 @@ public:
             }
         }
 
+        waitpid(tcpdump_pid, nullptr, 0); // 等待tcpdump写完缓冲区并退出，之后才能读取pcap文件
         tcpdump_pid = -1;
         capturing = false;
         std::cout << "[INFO] Packet capture stopped." << std::endl;
@@ -200,6 +241,7 @@ public:
 
 public:
     bool is_capturing() const { return capturing; }
+    const std::string &get_output_file() const { return output_file; }
 
 private:
     static bool is_tcpdump_available()
@@ -213,27 +255,6 @@ private:
         return found;
     }
 
-    static std::string extract_site_name_from_url(const std::string &url)
-    {
-        // www.baidu.com -> baidu
-        std::vector<std::string> parts;
-        std::string part;
-        std::istringstream iss(url);
-        std::string site_name;
-
-        while (std::getline(iss, part, '.'))
-        {
-            parts.emplace_back(part);
-        }
-        if (parts.size() >= 2)
-            return parts[parts.size() - 2];
-        else
-        {
-            std::cerr << "[WARN] Invalid URL format:" << url << std::endl;
-            return url;
-        }
-    }
-
     static bool ensure_dir_exists(const std::string &dir)
     {
         struct stat dir_st;
@@ -0,0 +1,193 @@
+/*
+DatasetStream按分片流式读取二进制数据集(FeatureDataset文件或ShardedDataset)用于训练，内存占用为O(分片大小)而不是O(数据集)：
+    - 只在打开时遍历样本表(不读取记录)来划分训练/测试集和确定特征维度
+    - 训练集保持划分时打乱后的顺序，每个分片是从整个训练集中随机抽取的一组样本(数据集按网站依次写入，
+      按文件顺序切分时一个分片往往只含一个类别)；加载分片时按文件顺序读取，对mmap文件的访问仍近似顺序
+    - 每个epoch打乱分片的顺序，分片内部再打乱样本的顺序
+    - 后台线程在当前分片训练的同时提取下一个分片的特征(双缓冲)，两个缓冲区跨分片复用，不再分配内存
+特征提取使用Featurizer，与TLSDataProcessor、predictCNN和liveClassify完全一致。
+*/
+#ifndef _DATASET_STREAM_HPP_
+#define _DATASET_STREAM_HPP_
+
+#include <vector>
+#include <string>
+#include <span>
+#include <thread>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+
+#include "ShardedDataset.hpp"
+#include "TLSDataProcessor.hpp"
+
+class DatasetStream
+{
+public:
+    using BatchCallback = std::function<void(std::span<const Sample *const>)>;
+
+private:
+    // 一个分片的特征，samples[i].features的容量在第一次填充后不再变化
+    struct Shard
+    {
+        std::vector<Sample> samples;
+        std::vector<const Sample *> order; // 分片内打乱后的样本顺序
+        std::vector<uint32_t> indices;     // 分片中的样本下标，按文件顺序排序
+        size_t count = 0;
+    };
+
+    ShardedDataset dataset;
+    int sequence_length = 0;
+    int num_labels = 0;
+    size_t shard_size;
+    std::vector<uint32_t> train_indices; // 随机顺序，决定每个分片包含哪些样本
+    std::vector<uint32_t> test_indices;
+    Shard shards[2];
+
+public:
+    /*
+    @param window 记录窗口，max_records为0时使用数据集中的最大序列长度
+    @param split_seed 划分训练/测试集的随机种子，为0时每次随机
+    @param shard_size 每个分片的样本数，决定训练时的内存占用
+    */
+    DatasetStream(const std::string &path, const FeatureWindow &window, unsigned split_seed, size_t shard_size,
+                  float test_ratio = 0.2f)
+        : shard_size(std::max<size_t>(shard_size, 1))
+    {
+        dataset.open(path);
+
+        // 只读样本表：确定序列长度、类别数，并按窗口策略过滤样本
+        std::vector<uint32_t> indices;
+        indices.reserve(dataset.num_samples());
+        size_t longest = 0, dropped = 0;
+        for (size_t i = 0; i < dataset.num_samples(); ++i)
+        {
+            DatasetSample record = dataset.sample(i);
+            if (window.max_records > 0 && record.length > static_cast<size_t>(window.max_records) &&
+                window.policy == TruncationPolicy::DROP)
+            {
+                dropped++;
+                continue;
+            }
+            longest = std::max(longest, record.length);
+            num_labels = std::max(num_labels, record.label + 1);
+            indices.push_back(static_cast<uint32_t>(i));
+        }
+        sequence_length = window.max_records > 0 ? window.max_records : static_cast<int>(longest);
+
+        // 随机抽取测试集。训练集不排序，否则按文件顺序切出的分片只含一两个网站，每个batch几乎都是单一类别
+        std::default_random_engine rng(split_seed != 0 ? split_seed : std::random_device{}());
+        std::shuffle(indices.begin(), indices.end(), rng);
+        size_t test_size = static_cast<size_t>(indices.size() * test_ratio);
+        test_indices.assign(indices.end() - test_size, indices.end());
+        train_indices.assign(indices.begin(), indices.end() - test_size);
+        std::sort(test_indices.begin(), test_indices.end());
+
+        std::cout << "[INFO] Streaming dataset: " << dataset.num_samples() << " samples, " << num_labels << " classes";
+        if (dropped > 0)
+            std::cout << ", " << dropped << " dropped by feature window";
+        std::cout << std::endl;
+        std::cout << "[INFO] Train samples: " << train_indices.size() << ", Test samples: " << test_indices.size()
+                  << ", shard size: " << this->shard_size << std::endl;
+    }
+
+    int get_feature_dim() const { return sequence_length * Featurizer::PACKET_FEATURES + Featurizer::STATS_FEATURES; }
+    int get_num_labels() const { return num_labels; }
+    int get_sequence_length() const { return sequence_length; }
+    const std::vector<std::pair<int, std::string>> &get_label_names() const { return dataset.get_labels(); }
+    size_t num_train() const { return train_indices.size(); }
+    size_t num_test() const { return test_indices.size(); }
+
+    /*
+    @brief 遍历一个epoch的训练数据，分片顺序和分片内的样本顺序由rng打乱
+    @param fn 对每个batch调用，batch中的指针只在本次调用期间有效
+    */
+    void for_each_train_batch(size_t batch_size, std::mt19937 &rng, const BatchCallback &fn)
+    {
+        size_t num_shards = (train_indices.size() + shard_size - 1) / shard_size;
+        std::vector<size_t> shard_order(num_shards);
+        for (size_t i = 0; i < num_shards; ++i)
+            shard_order[i] = i;
+        std::shuffle(shard_order.begin(), shard_order.end(), rng);
+
+        auto train_shard = [&](Shard &shard)
+        {
+            std::shuffle(shard.order.begin(), shard.order.begin() + shard.count, rng);
+            for (size_t i = 0; i < shard.count; i += batch_size)
+            {
+                size_t end = std::min(i + batch_size, shard.count);
+                fn(std::span<const Sample *const>(shard.order.data() + i, end - i));
+            }
+        };
+        for_each_shard(train_indices, shard_order, train_shard);
+    }
+
+    // 按分片遍历训练集或测试集(分片内按文件顺序)，每个分片调用一次fn
+    void for_each_sample_shard(bool test, const std::function<void(std::span<const Sample>)> &fn)
+    {
+        const std::vector<uint32_t> &indices = test ? test_indices : train_indices;
+        std::vector<size_t> shard_order((indices.size() + shard_size - 1) / shard_size);
+        for (size_t i = 0; i < shard_order.size(); ++i)
+            shard_order[i] = i;
+        for_each_shard(indices, shard_order, [&](Shard &shard)
+                       { fn(std::span<const Sample>(shard.samples.data(), shard.count)); });
+    }
+
+private:
+    // 双缓冲：处理当前分片的同时由后台线程提取下一个分片
+    void for_each_shard(const std::vector<uint32_t> &indices, const std::vector<size_t> &shard_order,
+                        const std::function<void(Shard &)> &fn)
+    {
+        if (shard_order.empty())
+            return;
+        load_shard(indices, shard_order[0], shards[0]);
+        for (size_t i = 0; i < shard_order.size(); ++i)
+        {
+            Shard &current = shards[i % 2];
+            std::thread prefetch;
+            if (i + 1 < shard_order.size())
+                prefetch = std::thread(&DatasetStream::load_shard, this, std::cref(indices), shard_order[i + 1],
+                                       std::ref(shards[(i + 1) % 2]));
+            try
+            {
+                fn(current);
+            }
+            catch (...)
+            {
+                if (prefetch.joinable())
+                    prefetch.join();
+                throw;
+            }
+            if (prefetch.joinable())
+                prefetch.join();
+        }
+    }
+
+    void load_shard(const std::vector<uint32_t> &indices, size_t shard, Shard &out) const
+    {
+        size_t begin = shard * shard_size;
+        size_t end = std::min(begin + shard_size, indices.size());
+        size_t feature_dim = static_cast<size_t>(get_feature_dim());
+        if (out.samples.size() < end - begin)
+            out.samples.resize(end - begin);
+
+        out.count = end - begin;
+        out.indices.assign(indices.begin() + static_cast<std::ptrdiff_t>(begin), indices.begin() + static_cast<std::ptrdiff_t>(end));
+        std::sort(out.indices.begin(), out.indices.end()); // 分片内按文件顺序读取
+        out.order.resize(out.count);
+        for (size_t i = 0; i < out.count; ++i)
+        {
+            DatasetSample record = dataset.sample(out.indices[i]);
+            Sample &sample = out.samples[i];
+            sample.label = record.label;
+            sample.features.resize(feature_dim);
+            Featurizer::extract_features(record.sizes, record.directions, record.length, sequence_length,
+                                         sample.features.data());
+            out.order[i] = &sample;
+        }
+    }
+};
+
+#endif // _DATASET_STREAM_HPP_
@@ -9,6 +9,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <algorithm>
 
 #include <openssl/ssl.h>
 #include <openssl/err.h>
@@ -57,15 +58,18 @@ public:
     {
         std::cout << "[INFO] All Current Domains (" << domains.size() << "):" << std::endl;
         int cnt = 1;
-        for (const auto &domain : domains)
+        for (const auto &domain : get_domains())
         {
             std::cout << "   No.[" << cnt++ << "] : " << domain << std::endl;
         }
     }
 
+    // 按字典序返回，与unordered_set的遍历顺序无关：标签分配、目录扫描和采集顺序都依赖这一顺序
     std::vector<std::string> get_domains() const
     {
-        return std::vector<std::string>(domains.begin(), domains.end());
+        std::vector<std::string> sorted(domains.begin(), domains.end());
+        std::sort(sorted.begin(), sorted.end());
+        return sorted;
     }
 
     bool is_empty() const
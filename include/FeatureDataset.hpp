@@ -0,0 +1,262 @@
+/*
+FeatureDataset为二进制的列式特征数据集格式，取代tls_features.csv的文本往返。
+训练器和预测器直接mmap该文件使用，不需要任何文本解析。
+
+文件布局(小端，所有段按8字节对齐)：
+    [Header]        固定72字节，见DatasetHeader
+    [Label table]   num_labels个 { uint32 label, uint32 name_len, char name[name_len] }
+    [Sample table]  num_samples个 DatasetSampleEntry { uint32 label, uint32 length, uint64 offset }
+    [Sizes]         num_records个 uint16，包大小
+    [Directions]    num_records个 int8，方向(0:client->server, 1:server->client)
+每个样本的记录为 sizes/directions 数组中 [offset, offset + length) 的部分。
+*/
+#ifndef _FEATURE_DATASET_HPP_
+#define _FEATURE_DATASET_HPP_
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <cstdio>
+
+#include "MappedFile.hpp"
+#include "Logger.hpp"
+
+struct DatasetHeader
+{
+    char magic[8];               // "TLSFEAT"
+    uint32_t version;            // 格式版本
+    uint32_t header_size;        // sizeof(DatasetHeader)
+    uint32_t num_labels;         // 标签表中的条目数
+    uint32_t reserved;
+    uint64_t num_samples;        // 样本数
+    uint64_t num_records;        // 所有样本的记录总数
+    uint64_t label_table_offset; // 各段在文件中的偏移
+    uint64_t sample_table_offset;
+    uint64_t sizes_offset;
+    uint64_t directions_offset;
+};
+static_assert(sizeof(DatasetHeader) == 72, "DatasetHeader layout changed");
+
+struct DatasetSampleEntry
+{
+    uint32_t label;
+    uint32_t length; // 记录数
+    uint64_t offset; // 在sizes/directions中的起始位置
+};
+static_assert(sizeof(DatasetSampleEntry) == 16, "DatasetSampleEntry layout changed");
+
+// 一个样本的只读视图，指针指向文件映射
+struct DatasetSample
+{
+    int label;
+    const uint16_t *sizes;
+    const int8_t *directions;
+    size_t length;
+};
+
+namespace dataset_format
+{
+    static constexpr char MAGIC[8] = {'T', 'L', 'S', 'F', 'E', 'A', 'T', '\0'};
+    static constexpr uint32_t VERSION = 1;
+
+    inline uint64_t align8(uint64_t v) { return (v + 7) & ~static_cast<uint64_t>(7); }
+
+    // 判断文件是否为二进制数据集(只读取魔数)
+    inline bool is_dataset_file(const std::string &path)
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        char magic[8] = {};
+        if (!ifs.read(magic, sizeof(magic)))
+            return false;
+        return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    }
+}
+
+class FeatureDatasetWriter
+{
+private:
+    std::vector<std::pair<uint32_t, std::string>> labels;
+    std::vector<DatasetSampleEntry> samples;
+    std::vector<uint16_t> sizes;
+    std::vector<int8_t> directions;
+
+public:
+    void add_label(int label, const std::string &site_name)
+    {
+        labels.push_back({static_cast<uint32_t>(label), site_name});
+    }
+
+    // 追加一个样本，only_valid为true时跳过大小为0或方向未知的记录(与CSV导出一致)
+    void add_sample(int label, const uint16_t *record_sizes, const int8_t *record_directions, size_t length,
+                    bool only_valid = true)
+    {
+        DatasetSampleEntry entry;
+        entry.label = static_cast<uint32_t>(label);
+        entry.offset = sizes.size();
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (only_valid && (record_sizes[i] == 0 || record_directions[i] < 0))
+                continue;
+            sizes.push_back(record_sizes[i]);
+            directions.push_back(record_directions[i]);
+        }
+        entry.length = static_cast<uint32_t>(sizes.size() - entry.offset);
+        if (entry.length == 0)
+            return; // 空样本不写入
+        samples.push_back(entry);
+    }
+
+    size_t num_samples() const { return samples.size(); }
+    size_t num_records() const { return sizes.size(); }
+
+    // 先写临时文件再rename，读者永远不会看到写了一半的数据集
+    bool write(const std::string &path) const
+    {
+        std::string tmp_path = path + ".tmp";
+        std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open())
+        {
+            LOG_ERROR << "Failed to open dataset file: " << tmp_path;
+            return false;
+        }
+
+        DatasetHeader header{};
+        std::memcpy(header.magic, dataset_format::MAGIC, sizeof(header.magic));
+        header.version = dataset_format::VERSION;
+        header.header_size = sizeof(DatasetHeader);
+        header.num_labels = static_cast<uint32_t>(labels.size());
+        header.num_samples = samples.size();
+        header.num_records = sizes.size();
+
+        uint64_t label_table_size = 0;
+        for (const auto &label : labels)
+            label_table_size += 8 + label.second.size();
+
+        header.label_table_offset = dataset_format::align8(sizeof(DatasetHeader));
+        header.sample_table_offset = dataset_format::align8(header.label_table_offset + label_table_size);
+        header.sizes_offset = dataset_format::align8(header.sample_table_offset + samples.size() * sizeof(DatasetSampleEntry));
+        header.directions_offset = dataset_format::align8(header.sizes_offset + sizes.size() * sizeof(uint16_t));
+
+        uint64_t written = 0;
+        auto write_bytes = [&](const void *data, size_t len)
+        {
+            ofs.write(static_cast<const char *>(data), static_cast<std::streamsize>(len));
+            written += len;
+        };
+        auto pad_to = [&](uint64_t offset)
+        {
+            static const char zeros[8] = {};
+            if (offset > written)
+                write_bytes(zeros, offset - written);
+        };
+
+        write_bytes(&header, sizeof(header));
+        pad_to(header.label_table_offset);
+        for (const auto &label : labels)
+        {
+            uint32_t name_len = static_cast<uint32_t>(label.second.size());
+            write_bytes(&label.first, sizeof(label.first));
+            write_bytes(&name_len, sizeof(name_len));
+            write_bytes(label.second.data(), name_len);
+        }
+        pad_to(header.sample_table_offset);
+        write_bytes(samples.data(), samples.size() * sizeof(DatasetSampleEntry));
+        pad_to(header.sizes_offset);
+        write_bytes(sizes.data(), sizes.size() * sizeof(uint16_t));
+        pad_to(header.directions_offset);
+        write_bytes(directions.data(), directions.size() * sizeof(int8_t));
+
+        ofs.close();
+        if (!ofs)
+        {
+            LOG_ERROR << "Failed to write dataset file: " << tmp_path;
+            return false;
+        }
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+        {
+            LOG_ERROR << "Failed to rename dataset file to: " << path;
+            return false;
+        }
+        return true;
+    }
+};
+
+// 只读的数据集，通过mmap直接访问文件中的各个段
+class FeatureDataset
+{
+private:
+    MappedFile mapped_file;
+    const DatasetHeader *header = nullptr;
+    const DatasetSampleEntry *sample_table = nullptr;
+    const uint16_t *sizes = nullptr;
+    const int8_t *directions = nullptr;
+    std::vector<std::pair<int, std::string>> labels;
+
+public:
+    // 打开并校验数据集，格式错误时抛出异常
+    void open(const std::string &path)
+    {
+        if (!mapped_file.open(path, false)) // 训练时按随机顺序访问样本
+            throw std::runtime_error("Failed to open dataset: " + path);
+
+        std::string_view data = mapped_file.data();
+        if (data.size() < sizeof(DatasetHeader))
+            throw std::runtime_error("Dataset file too small: " + path);
+
+        header = reinterpret_cast<const DatasetHeader *>(data.data());
+        if (std::memcmp(header->magic, dataset_format::MAGIC, sizeof(header->magic)) != 0)
+            throw std::runtime_error("Not a TLS feature dataset: " + path);
+        if (header->version != dataset_format::VERSION || header->header_size != sizeof(DatasetHeader))
+            throw std::runtime_error("Unsupported dataset version " + std::to_string(header->version) + ": " + path);
+
+        uint64_t sizes_end = header->sizes_offset + header->num_records * sizeof(uint16_t);
+        uint64_t directions_end = header->directions_offset + header->num_records * sizeof(int8_t);
+        uint64_t samples_end = header->sample_table_offset + header->num_samples * sizeof(DatasetSampleEntry);
+        if (sizes_end > data.size() || directions_end > data.size() || samples_end > data.size())
+            throw std::runtime_error("Truncated dataset file: " + path);
+
+        sample_table = reinterpret_cast<const DatasetSampleEntry *>(data.data() + header->sample_table_offset);
+        sizes = reinterpret_cast<const uint16_t *>(data.data() + header->sizes_offset);
+        directions = reinterpret_cast<const int8_t *>(data.data() + header->directions_offset);
+
+        // 标签表
+        labels.clear();
+        uint64_t pos = header->label_table_offset;
+        for (uint32_t i = 0; i < header->num_labels; ++i)
+        {
+            if (pos + 8 > data.size())
+                throw std::runtime_error("Corrupted label table: " + path);
+            uint32_t label, name_len;
+            std::memcpy(&label, data.data() + pos, 4);
+            std::memcpy(&name_len, data.data() + pos + 4, 4);
+            pos += 8;
+            if (pos + name_len > data.size())
+                throw std::runtime_error("Corrupted label table: " + path);
+            labels.push_back({static_cast<int>(label), std::string(data.substr(pos, name_len))});
+            pos += name_len;
+        }
+
+        for (uint64_t i = 0; i < header->num_samples; ++i)
+        {
+            if (sample_table[i].offset + sample_table[i].length > header->num_records)
+                throw std::runtime_error("Corrupted sample table: " + path);
+        }
+    }
+
+    size_t num_samples() const { return header ? header->num_samples : 0; }
+    size_t num_records() const { return header ? header->num_records : 0; }
+    const std::vector<std::pair<int, std::string>> &get_labels() const { return labels; }
+
+    DatasetSample sample(size_t index) const
+    {
+        const DatasetSampleEntry &entry = sample_table[index];
+        return DatasetSample{static_cast<int>(entry.label), sizes + entry.offset, directions + entry.offset, entry.length};
+    }
+};
+
+#endif // _FEATURE_DATASET_HPP_
@@ -0,0 +1,191 @@
+/*
+Featurizer把一个会话的TLS记录序列(大小、方向)转换为模型的输入特征。训练(TLSDataProcessor、DatasetStream)、
+批量预测(predictCNN)和在线分类(liveClassify)都只通过这里提取特征，三者的特征逐位一致：
+    - 每条记录2个特征：归一化大小 clamp(log(size + 1) / log(SIZE_LOG_BASE), 0, 1)(查表)和方向(0客户端->服务端，1服务端->客户端)
+    - 序列之后是6个统计特征：平均大小、最大、最小、标准差、出包比例、总包数(log(n + 1) / log(101))
+    - 特征维度为 sequence_length * PACKET_FEATURES + STATS_FEATURES，不足sequence_length的记录补0，超出的记录不参与特征
+
+流式用法(在线分类每条记录到达时更新，判决时不需要重新处理整个序列)：
+    Featurizer featurizer(sequence_length);
+    featurizer.push(size, direction);   // 每条记录
+    featurizer.finalize(out);           // 写出feature_dim()个float
+一次性处理整个序列时使用 Featurizer::extract_features。
+*/
+#ifndef _FEATURIZER_HPP_
+#define _FEATURIZER_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+class Featurizer
+{
+public:
+    static const int PACKET_FEATURES = 2;           // 大小 + 方向
+    static const int STATS_FEATURES = 6;            // 平均大小、最大、最小、标准差、出包比例、总包数
+    static constexpr float SIZE_LOG_BASE = 1501.0f; // 包大小的对数归一化：log(size + 1) / log(SIZE_LOG_BASE)
+
+private:
+    /*
+    统计特征的累加状态，流式和一次性两种接口共用，保证结果相同。
+    和与平方和用双精度累加，单遍求方差不损失精度
+    */
+    struct RunningStats
+    {
+        double sum = 0.0, sum_sq = 0.0;
+        float min_size = 1.0f, max_size = 0.0f;
+        size_t outgoing = 0;
+        size_t count = 0;
+
+        void add(float size, int8_t direction)
+        {
+            sum += size;
+            sum_sq += static_cast<double>(size) * size;
+            min_size = std::min(min_size, size);
+            max_size = std::max(max_size, size);
+            outgoing += direction == 1;
+            count++;
+        }
+
+        // 写出STATS_FEATURES个统计特征，没有记录时全为0
+        void write(float *out) const
+        {
+            if (count == 0)
+            {
+                std::fill(out, out + STATS_FEATURES, 0.0f);
+                return;
+            }
+            double mean = sum / count;
+            out[0] = static_cast<float>(mean);
+            out[1] = max_size;
+            out[2] = min_size;
+            out[3] = static_cast<float>(std::sqrt(std::max(0.0, sum_sq / count - mean * mean)));
+            out[4] = static_cast<float>(outgoing) / static_cast<float>(count);
+            out[5] = std::log(static_cast<float>(count) + 1.0f) / std::log(101.0f);
+        }
+    };
+
+    int sequence_length = 0;
+    std::vector<float> packets; // sequence_length * PACKET_FEATURES，尚未到达的记录为0
+    RunningStats stats;
+    size_t pushed = 0; // 加入的记录总数，包括超出sequence_length、不参与特征的记录
+
+public:
+    Featurizer() = default;
+
+    explicit Featurizer(int sequence_length)
+        : sequence_length(std::max(sequence_length, 0)), packets(static_cast<size_t>(this->sequence_length) * PACKET_FEATURES, 0.0f)
+    {
+    }
+
+    static int feature_dim(int sequence_length) { return sequence_length * PACKET_FEATURES + STATS_FEATURES; }
+
+    // 由模型的输入维度反推序列长度(记录数)
+    static int sequence_length_for(int feature_dim) { return std::max(0, (feature_dim - STATS_FEATURES) / PACKET_FEATURES); }
+
+    int feature_dim() const { return feature_dim(sequence_length); }
+    int get_sequence_length() const { return sequence_length; }
+
+    /*
+    @brief 加入一条记录，立即更新该记录的特征和统计特征
+    @return 记录已超出sequence_length、不参与特征时返回false
+    */
+    bool push(uint16_t size, int8_t direction)
+    {
+        pushed++;
+        if (stats.count >= static_cast<size_t>(sequence_length))
+            return false;
+        float normalized = normalize_size(size);
+        packets[stats.count * PACKET_FEATURES] = normalized;
+        packets[stats.count * PACKET_FEATURES + 1] = static_cast<float>(direction);
+        stats.add(normalized, direction);
+        return true;
+    }
+
+    // 写出feature_dim()个特征
+    void finalize(float *out) const
+    {
+        std::copy(packets.begin(), packets.end(), out);
+        stats.write(out + packets.size());
+    }
+
+    size_t size() const { return stats.count; } // 参与特征的记录数
+    size_t records() const { return pushed; }
+    bool empty() const { return pushed == 0; }
+    bool full() const { return stats.count >= static_cast<size_t>(sequence_length); }
+
+    // 清空已加入的记录，保留缓冲区，用于下一个会话
+    void reset()
+    {
+        std::fill(packets.begin(), packets.begin() + stats.count * PACKET_FEATURES, 0.0f);
+        stats = RunningStats();
+        pushed = 0;
+    }
+
+    // 释放缓冲区(如在线分类判决之后)，之后只能重新赋值使用
+    void release()
+    {
+        std::vector<float>().swap(packets);
+        stats = RunningStats();
+        sequence_length = 0;
+    }
+
+    /*
+    @brief 一次遍历记录序列，写出每条记录的(归一化大小, 方向)和统计特征，所有记录都参与特征
+    @param packet_out 长度为 length * PACKET_FEATURES
+    @param stats_out 长度为 STATS_FEATURES
+    */
+    static void featurize(const uint16_t *sizes, const int8_t *directions, size_t length, float *packet_out, float *stats_out)
+    {
+        RunningStats running;
+        for (size_t i = 0; i < length; ++i)
+        {
+            float normalized = normalize_size(sizes[i]);
+            packet_out[i * PACKET_FEATURES] = normalized;
+            packet_out[i * PACKET_FEATURES + 1] = static_cast<float>(directions[i]);
+            running.add(normalized, directions[i]);
+        }
+        running.write(stats_out);
+    }
+
+    /*
+    @brief 将一条记录序列直接转换为模型输入，结果与逐条push()后finalize()相同
+    @param sequence_length 模型的序列长度，超出部分被截断，不足部分补0
+    @param out 长度为 feature_dim(sequence_length)
+    */
+    static void extract_features(const uint16_t *sizes, const int8_t *directions, size_t length, int sequence_length,
+                                 float *out)
+    {
+        size_t n = std::min(length, static_cast<size_t>(std::max(sequence_length, 0)));
+        featurize(sizes, directions, n, out, out + sequence_length * PACKET_FEATURES);
+        std::fill(out + n * PACKET_FEATURES, out + sequence_length * PACKET_FEATURES, 0.0f);
+    }
+
+    static float normalize_size(uint16_t size) { return size_table()[std::min<uint16_t>(size, SIZE_TABLE_MAX)]; }
+
+private:
+    /*
+    包大小的对数归一化查找表：size >= SIZE_LOG_BASE - 1 时恒为1，所以只需要SIZE_LOG_BASE个表项(约6KB，常驻L1)，
+    更大的size查最后一项
+    */
+    static const uint16_t SIZE_TABLE_MAX = static_cast<uint16_t>(SIZE_LOG_BASE) - 1;
+
+    static const float *size_table()
+    {
+        static const std::vector<float> table = []
+        {
+            std::vector<float> t(SIZE_TABLE_MAX + 1);
+            for (size_t size = 0; size < t.size(); ++size)
+            {
+                float normalized_size = std::log(static_cast<float>(size) + 1.0f) / std::log(SIZE_LOG_BASE);
+                t[size] = std::min(1.0f, std::max(0.0f, normalized_size)); //* 正溢为1，负溢为0
+            }
+            return t;
+        }();
+        return table.data();
+    }
+};
+
+#endif // _FEATURIZER_HPP_
@@ -1,5 +1,5 @@
 // Pcap文件加载器，用于从./data/目录下加载各域名对应的所有pcap文件到一个map中(std::unordered_map<std::string, std::vector<std::string>>)
-// 同时提供单例全局接口
+// 同时提供单例全局接口。目录扫描见DirectoryScanner，每个网站的文件列表按路径排序
 
 #ifndef FILELOADER_HPP
 #define FILELOADER_HPP
@@ -11,11 +11,13 @@
 #include <string>
 #include <sys/stat.h>
 #include <sstream>
-#include <dirent.h>
 #include <algorithm>
+#include <thread>
 
 #include "DomainManager.hpp"
-// #include "Capture.hpp"
+#include "LabelMap.hpp"
+#include "DirectoryScanner.hpp"
+#include "ThreadPool.hpp"
 
 class FileLoader
 {
@@ -45,25 +47,48 @@ public:
         // 为了update，需先清空原有map
         file_map.clear();
 
-        std::cout << "[INFO] Found " << DomainManager::instance()->get_domains().size() << " domains." << std::endl;
-        // 遍历所有域名，提取其对应目录下的所有文件
-        for (const auto &domain : DomainManager::instance()->get_domains())
+        // 多个域名可能对应同一个网站目录，按网站名排序去重
+        std::vector<std::string> domains = DomainManager::instance()->get_domains();
+        std::cout << "[INFO] Found " << domains.size() << " domains." << std::endl;
+        std::vector<std::string> sites;
+        for (const auto &domain : domains)
+            sites.push_back(LabelMap::site_name_from_domain(domain));
+        std::sort(sites.begin(), sites.end());
+        sites.erase(std::unique(sites.begin(), sites.end()), sites.end());
+
+        // 各网站目录并行扫描，扫描结果按网站名顺序输出，与线程调度无关
+        struct SiteScan
         {
-            std::string site_name = extract_site_name_from_url(domain);
-            std::string domain_dir = data_base_dir + "/" + site_name;
-
-            struct stat domain_st;
-            if (stat(domain_dir.c_str(), &domain_st) != 0 || !S_ISDIR(domain_st.st_mode)) // 域名子目录不存在或不是目录
+            bool found = false;
+            std::vector<std::string> files;
+            DirectoryScanner::ScanStats stats;
+        };
+        std::vector<SiteScan> scans(sites.size());
+        WorkStealingPool pool(std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), std::max<size_t>(sites.size(), 1)));
+        pool.parallel_for(sites.size(), [&](size_t i, size_t)
+                          {
+                              std::string domain_dir = data_base_dir + "/" + sites[i];
+                              struct stat domain_st;
+                              if (stat(domain_dir.c_str(), &domain_st) != 0 || !S_ISDIR(domain_st.st_mode))
+                                  return;
+                              scans[i].found = DirectoryScanner::scan_pcaps(domain_dir, scans[i].files, scans[i].stats); });
+
+        for (size_t i = 0; i < sites.size(); ++i)
+        {
+            SiteScan &scan = scans[i];
+            if (!scan.found)
             {
-                std::cerr << "[WARN] Directory for domain " << domain << " not found or is not a directory." << std::endl;
-                file_map[site_name] = std::vector<std::string>(); // 填入一个空向量
+                std::cerr << "[WARN] Directory for site " << sites[i] << " not found or is not a directory." << std::endl;
+                file_map[sites[i]] = std::vector<std::string>(); // 填入一个空向量
                 continue;
             }
-
-            std::cout << "[INFO] Loading pcap files for domain " << domain << " from " << domain_dir << std::endl;
-            std::vector<std::string> domain_pcap_vector = load_pcaps_from_domain_dir(domain_dir);
-            file_map[site_name] = domain_pcap_vector;
-            std::cout << "[INFO] Loaded " << domain_pcap_vector.size() << " pcap files for domain " << domain << std::endl;
+            std::cout << "[INFO] Loaded " << scan.files.size() << " pcap files for site " << sites[i] << " from "
+                      << data_base_dir << "/" << sites[i];
+            if (scan.stats.wrong_extension + scan.stats.wrong_magic > 0)
+                std::cout << " (skipped " << scan.stats.wrong_extension << " non-pcap and " << scan.stats.wrong_magic
+                          << " invalid files)";
+            std::cout << std::endl;
+            file_map[sites[i]] = std::move(scan.files);
         }
 
         return true;
@@ -82,52 +107,7 @@ public:
     }
 
     // Getter方法
-    auto get_file_map() const { return file_map; }
-
-private:
-    static std::string extract_site_name_from_url(const std::string &url) // 和Capture中的函数重复，可优化。
-    {
-        // www.baidu.com -> baidu
-        std::vector<std::string> parts;
-        std::string part;
-        std::istringstream iss(url);
-        std::string site_name;
-
-        while (std::getline(iss, part, '.'))
-        {
-            parts.emplace_back(part);
-        }
-        if (parts.size() >= 2)
-            return parts[parts.size() - 2];
-        else
-        {
-            std::cerr << "[WARN] Invalid URL format:" << url << std::endl;
-            return url;
-        }
-    }
-
-    std::vector<std::string> load_pcaps_from_domain_dir(const std::string &domain_dir) // 从域名子目录中加载所有pcap文件
-    {
-        std::vector<std::string> pcap_vector;
-
-        DIR *dir = opendir(domain_dir.c_str());
-        if (!dir)
-        {
-            std::cerr << "[ERROR] Failed to open directory: " << domain_dir << "when loading pcap files." << std::endl;
-            return pcap_vector;
-        }
-
-        struct dirent *entry;
-        while ((entry = readdir(dir)) != NULL)
-        {
-            std::string file_name = entry->d_name;
-            if (file_name.find(".pcap") && file_name.size() > 5)
-                pcap_vector.emplace_back(domain_dir + "/" + file_name);
-        }
-        closedir(dir);
-        std::sort(pcap_vector.begin(), pcap_vector.end()); // 升序排序
-        return pcap_vector;
-    }
+    const std::unordered_map<std::string, std::vector<std::string>> &get_file_map() const { return file_map; }
 
 private:
     static std::unique_ptr<FileLoader> file_loader;
@@ -0,0 +1,282 @@
+/*
+FixedMLP是SimpleCNN在编译期确定网络形状的推理版本，用于部署冻结的模型：
+    - InputDim/Hidden/Classes都是常量，权重保存在std::array中，编译器按已知的尺寸展开和向量化
+    - fc1的权重转置存储为[InputDim x Hidden]，每个输入乘一行Hidden个权重累加到隐藏层，
+      Hidden=16时整个隐藏层正好放在一个(AVX-512)或两个(AVX2)寄存器中，没有水平求和；
+      输入按4个一组展开到4组独立的累加器，隐藏FMA的延迟。x86上与MatrixKernels一样按CPU选择AVX-512/AVX2实现
+    - fc2和softmax按Classes x Hidden完全展开
+由已加载的SimpleCNN构造，形状不一致时抛出异常；训练仍然使用运行时维度的SimpleCNN。
+构建时用CMake的TLS_FIXED_MODEL(从模型文件头读取形状)或TLS_FIXED_SHAPE指定liveClassify特化的形状。
+*/
+#ifndef _FIXED_MLP_HPP_
+#define _FIXED_MLP_HPP_
+
+#include <array>
+#include <span>
+#include <cmath>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+
+#include "SimpleCNN.hpp"
+
+template <int InputDim, int Hidden, int Classes>
+class FixedMLP
+{
+    static_assert(InputDim > 0 && Hidden > 0 && Classes > 0, "FixedMLP dimensions must be positive");
+
+public:
+    static constexpr int INPUT_DIM = InputDim;
+    static constexpr int HIDDEN = Hidden;
+    static constexpr int CLASSES = Classes;
+
+    // 单样本推理的工作区，每个线程各用一份
+    struct InferenceWorkspace
+    {
+        alignas(64) std::array<float, Classes> probabilities{};
+    };
+
+private:
+    alignas(64) std::array<float, InputDim * Hidden> fc1_weights; // 转置：第i行为输入i到各隐藏单元的权重
+    alignas(64) std::array<float, Hidden> fc1_biases;
+    alignas(64) std::array<float, Classes * Hidden> fc2_weights; // [Classes x Hidden]
+    std::array<float, Classes> fc2_biases;
+    ModelMetadata metadata;
+
+    // fc1 + relu的实现，构造时按kernels::current_isa()选择
+    using HiddenFn = void (*)(const float *weights, const float *biases, const float *input, float *hidden);
+    HiddenFn hidden_layer = hidden_scalar;
+
+    // 编译期展开：依次以 0..N-1 的整数常量调用f
+    template <int N, typename F>
+    static inline void unroll(F &&f)
+    {
+        [&]<int... I>(std::integer_sequence<int, I...>)
+        { (f(std::integral_constant<int, I>{}), ...); }(std::make_integer_sequence<int, N>{});
+    }
+
+    static void hidden_scalar(const float *weights, const float *biases, const float *input, float *hidden)
+    {
+        std::array<float, Hidden> acc;
+        for (int h = 0; h < Hidden; ++h)
+            acc[h] = biases[h];
+        for (int i = 0; i < InputDim; ++i)
+        {
+            const float x = input[i];
+            const float *w = weights + i * Hidden;
+            for (int h = 0; h < Hidden; ++h)
+                acc[h] += x * w[h];
+        }
+        for (int h = 0; h < Hidden; ++h)
+            hidden[h] = std::max(0.0f, acc[h]);
+    }
+
+#if defined(TLS_KERNELS_X86)
+    // 每16(8)个隐藏单元一个寄存器，输入4个一组交给4组累加器，最后相加。只在Hidden为寄存器宽度的整数倍时使用
+    __attribute__((target("avx512f"))) static void hidden_avx512(const float *weights, const float *biases, const float *input, float *hidden)
+    {
+        constexpr int V = Hidden / 16;
+        __m512 acc[4][V];
+        for (int v = 0; v < V; ++v)
+        {
+            acc[0][v] = _mm512_loadu_ps(biases + 16 * v);
+            acc[1][v] = acc[2][v] = acc[3][v] = _mm512_setzero_ps();
+        }
+        constexpr int UNROLLED = InputDim / 4 * 4;
+        for (int i = 0; i < UNROLLED; i += 4)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                __m512 x = _mm512_set1_ps(input[i + k]);
+                const float *w = weights + (i + k) * Hidden;
+                for (int v = 0; v < V; ++v)
+                    acc[k][v] = _mm512_fmadd_ps(x, _mm512_loadu_ps(w + 16 * v), acc[k][v]);
+            }
+        }
+        for (int i = UNROLLED; i < InputDim; ++i)
+        {
+            __m512 x = _mm512_set1_ps(input[i]);
+            for (int v = 0; v < V; ++v)
+                acc[0][v] = _mm512_fmadd_ps(x, _mm512_loadu_ps(weights + i * Hidden + 16 * v), acc[0][v]);
+        }
+        for (int v = 0; v < V; ++v)
+        {
+            __m512 sum = _mm512_add_ps(_mm512_add_ps(acc[0][v], acc[1][v]), _mm512_add_ps(acc[2][v], acc[3][v]));
+            // maskz形式：GCC 12的_mm512_max_ps以undefined为直通操作数，-Wall下误报未初始化
+            _mm512_storeu_ps(hidden + 16 * v, _mm512_maskz_max_ps(0xFFFF, sum, _mm512_setzero_ps()));
+        }
+    }
+
+    __attribute__((target("avx2,fma"))) static void hidden_avx2(const float *weights, const float *biases, const float *input, float *hidden)
+    {
+        constexpr int V = Hidden / 8;
+        __m256 acc[4][V];
+        for (int v = 0; v < V; ++v)
+        {
+            acc[0][v] = _mm256_loadu_ps(biases + 8 * v);
+            acc[1][v] = acc[2][v] = acc[3][v] = _mm256_setzero_ps();
+        }
+        constexpr int UNROLLED = InputDim / 4 * 4;
+        for (int i = 0; i < UNROLLED; i += 4)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                __m256 x = _mm256_set1_ps(input[i + k]);
+                const float *w = weights + (i + k) * Hidden;
+                for (int v = 0; v < V; ++v)
+                    acc[k][v] = _mm256_fmadd_ps(x, _mm256_loadu_ps(w + 8 * v), acc[k][v]);
+            }
+        }
+        for (int i = UNROLLED; i < InputDim; ++i)
+        {
+            __m256 x = _mm256_set1_ps(input[i]);
+            for (int v = 0; v < V; ++v)
+                acc[0][v] = _mm256_fmadd_ps(x, _mm256_loadu_ps(weights + i * Hidden + 8 * v), acc[0][v]);
+        }
+        for (int v = 0; v < V; ++v)
+        {
+            __m256 sum = _mm256_add_ps(_mm256_add_ps(acc[0][v], acc[1][v]), _mm256_add_ps(acc[2][v], acc[3][v]));
+            _mm256_storeu_ps(hidden + 8 * v, _mm256_max_ps(sum, _mm256_setzero_ps()));
+        }
+    }
+#endif
+
+public:
+    explicit FixedMLP(const SimpleCNN &model) : metadata(model.get_metadata())
+    {
+        if (!matches(model))
+        {
+            throw std::runtime_error("Model shape " + std::to_string(model.get_input_dim()) + "x" +
+                                     std::to_string(model.get_hidden_layer().get_output_size()) + "x" +
+                                     std::to_string(model.get_num_labels()) + " does not match FixedMLP<" + shape() + ">");
+        }
+
+        const FCLayer &fc1 = model.get_hidden_layer();
+        for (int h = 0; h < Hidden; ++h)
+        {
+            const float *row = fc1.get_weights().row(h);
+            for (int i = 0; i < InputDim; ++i)
+                fc1_weights[i * Hidden + h] = row[i];
+            fc1_biases[h] = fc1.get_biases()[h];
+        }
+
+        const FCLayer &fc2 = model.get_output_layer();
+        for (int c = 0; c < Classes; ++c)
+        {
+            const float *row = fc2.get_weights().row(c);
+            for (int h = 0; h < Hidden; ++h)
+                fc2_weights[c * Hidden + h] = row[h];
+            fc2_biases[c] = fc2.get_biases()[c];
+        }
+
+#if defined(TLS_KERNELS_X86)
+        if constexpr (Hidden % 16 == 0)
+        {
+            if (kernels::current_isa() == kernels::Isa::AVX512)
+                hidden_layer = hidden_avx512;
+        }
+        if constexpr (Hidden % 8 == 0)
+        {
+            if (kernels::current_isa() == kernels::Isa::AVX2)
+                hidden_layer = hidden_avx2;
+        }
+#endif
+    }
+
+    // 模型的形状是否与模板参数一致
+    static bool matches(const SimpleCNN &model)
+    {
+        return model.get_input_dim() == InputDim && model.get_num_labels() == Classes &&
+               model.get_hidden_layer().get_output_size() == Hidden;
+    }
+
+    static std::string shape()
+    {
+        return std::to_string(InputDim) + "x" + std::to_string(Hidden) + "x" + std::to_string(Classes);
+    }
+
+    InferenceWorkspace make_workspace() const { return InferenceWorkspace{}; }
+
+    /*
+    @brief 前向传播，与SimpleCNN::forward的计算相同(累加顺序不同，结果有浮点舍入误差)
+    @return 各类别的概率，指向ws内部，下一次使用ws前有效
+    */
+    std::span<const float> forward(std::span<const float> input, InferenceWorkspace &ws) const
+    {
+        if (static_cast<int>(input.size()) != InputDim)
+        {
+            throw std::runtime_error("Invalid input dimension: " + std::to_string(input.size()));
+        }
+        // NaN和Inf的指数位全为1；按位或归约没有提前退出的分支，可以向量化
+        uint32_t non_finite = 0;
+        for (float val : input)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &val, sizeof(bits));
+            non_finite |= (bits & 0x7f800000u) == 0x7f800000u;
+        }
+        if (non_finite)
+        {
+            throw std::runtime_error("Invalid input detected");
+        }
+        forward(input.data(), ws.probabilities.data());
+        return ws.probabilities;
+    }
+
+    // 不做输入检查的版本，input为InputDim个float
+    void forward(const float *__restrict input, float *__restrict probabilities) const
+    {
+        // 第一层：hidden = relu(W1 * input + b1)
+        alignas(64) std::array<float, Hidden> hidden;
+        hidden_layer(fc1_weights.data(), fc1_biases.data(), input, hidden.data());
+
+        // 输出层：logits = W2 * hidden + b2，完全展开
+        std::array<float, Classes> logits;
+        unroll<Classes>([&](auto c)
+                        {
+            float sum = fc2_biases[c];
+            unroll<Hidden>([&](auto h)
+                           { sum += fc2_weights[c * Hidden + h] * hidden[h]; });
+            logits[c] = sum; });
+
+        // softmax，与Activation::softmax的数值处理一致
+        float max_val = logits[0];
+        unroll<Classes>([&](auto c)
+                        { max_val = std::max(max_val, logits[c]); });
+        float sum = 0.0f;
+        unroll<Classes>([&](auto c)
+                        {
+            probabilities[c] = std::exp(std::min(logits[c] - max_val, 80.0f));
+            sum += probabilities[c]; });
+        const float inv_sum = 1.0f / std::max(sum, 1e-7f);
+        unroll<Classes>([&](auto c)
+                        { probabilities[c] *= inv_sum; });
+    }
+
+    // 当前使用的fc1实现
+    const char *isa_name() const
+    {
+#if defined(TLS_KERNELS_X86)
+        if constexpr (Hidden % 16 == 0)
+        {
+            if (hidden_layer == hidden_avx512)
+                return kernels::isa_name(kernels::Isa::AVX512);
+        }
+        if constexpr (Hidden % 8 == 0)
+        {
+            if (hidden_layer == hidden_avx2)
+                return kernels::isa_name(kernels::Isa::AVX2);
+        }
+#endif
+        return kernels::isa_name(kernels::Isa::SCALAR);
+    }
+
+    const ModelMetadata &get_metadata() const { return metadata; }
+    int get_input_dim() const { return InputDim; }
+    int get_num_labels() const { return Classes; }
+};
+
+#endif // _FIXED_MLP_HPP_
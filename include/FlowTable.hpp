@@ -0,0 +1,307 @@
+/*
+FlowTable是在线跟踪用的流表：以TCP连接(5元组)为key的开放寻址哈希表。
+每个桶正好占一个缓存行，存放8个槽位的哈希标签和节点下标，一次查找通常只访问一个缓存行，
+标签不匹配的槽位不需要去读节点里的key。流本身放在连续的节点数组中，删除后的节点通过空闲链表复用。
+
+表本身不加锁：每个抓包线程拥有自己的FlowTable(RSS式分片，见shard_of和PacketRing::join_fanout)，
+同一个连接的两个方向总是落到同一个分片，因此插入和删除都只有一个写者。
+*/
+#ifndef _FLOW_TABLE_HPP_
+#define _FLOW_TABLE_HPP_
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+
+#include "PcapReader.hpp"
+
+// 规范化的连接标识：(地址, 端口)较小的一端为a，两个方向的数据包得到同一个key
+struct FlowKey
+{
+    uint8_t addr_a[16];
+    uint8_t addr_b[16];
+    uint16_t port_a;
+    uint16_t port_b;
+    uint8_t ip_version;
+    uint8_t reserved[3];
+
+    bool operator==(const FlowKey &other) const
+    {
+        return std::memcmp(this, &other, sizeof(FlowKey)) == 0;
+    }
+
+    // from_a返回数据包是否由a端发出
+    static FlowKey from_packet(const TCPPacket &tcp, bool &from_a)
+    {
+        FlowKey key;
+        std::memset(&key, 0, sizeof(key));
+        int cmp = std::memcmp(tcp.src_addr, tcp.dst_addr, sizeof(tcp.src_addr));
+        from_a = cmp < 0 || (cmp == 0 && tcp.src_port <= tcp.dst_port);
+        std::memcpy(key.addr_a, from_a ? tcp.src_addr : tcp.dst_addr, sizeof(key.addr_a));
+        std::memcpy(key.addr_b, from_a ? tcp.dst_addr : tcp.src_addr, sizeof(key.addr_b));
+        key.port_a = from_a ? tcp.src_port : tcp.dst_port;
+        key.port_b = from_a ? tcp.dst_port : tcp.src_port;
+        key.ip_version = static_cast<uint8_t>(tcp.ip_version);
+        return key;
+    }
+
+    // key是规范化的，所以哈希值与方向无关
+    uint64_t hash() const
+    {
+        static_assert(sizeof(FlowKey) == 40, "FlowKey must be 5 words");
+        uint64_t words[5];
+        std::memcpy(words, this, sizeof(words));
+        uint64_t h = 0x9e3779b97f4a7c15ULL;
+        for (uint64_t w : words)
+        {
+            h ^= w;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 32;
+        }
+        return h;
+    }
+};
+
+template <typename Value>
+class FlowTable
+{
+public:
+    static constexpr size_t SLOTS_PER_BUCKET = 8;
+
+    // 按哈希值把连接分给num_shards个线程
+    static size_t shard_of(uint64_t hash, size_t num_shards)
+    {
+        return static_cast<size_t>((hash >> 32) * num_shards >> 32);
+    }
+
+private:
+    static constexpr uint32_t EMPTY = 0xffffffffu;
+    static constexpr uint32_t TOMBSTONE = 0xfffffffeu;
+
+    struct alignas(64) Bucket
+    {
+        uint32_t tags[SLOTS_PER_BUCKET];  // 哈希值的高32位
+        uint32_t nodes[SLOTS_PER_BUCKET]; // 节点下标，EMPTY或TOMBSTONE表示空槽
+    };
+    static_assert(sizeof(Bucket) == 64, "Bucket must fill one cache line");
+
+    struct Node
+    {
+        FlowKey key;
+        Value value;
+        uint32_t next_free = EMPTY;
+        bool in_use = false;
+    };
+
+    std::vector<Bucket> buckets;
+    std::vector<Node> nodes;
+    uint32_t free_head = EMPTY;
+    size_t bucket_mask = 0;
+    size_t live = 0;       // 有效的流
+    size_t tombstones = 0; // 删除后留下的墓碑槽
+
+public:
+    // @param expected_flows 预计的并发流数，表在达到7/8负载时自动扩容
+    explicit FlowTable(size_t expected_flows = 1024)
+    {
+        size_t num_buckets = 1;
+        while (num_buckets * SLOTS_PER_BUCKET * 7 / 8 < expected_flows)
+            num_buckets <<= 1;
+        reset_buckets(num_buckets);
+        nodes.reserve(expected_flows);
+    }
+
+    size_t size() const { return live; }
+    bool empty() const { return live == 0; }
+    size_t capacity() const { return buckets.size() * SLOTS_PER_BUCKET; }
+
+    Value *find(const FlowKey &key) { return find(key, key.hash()); }
+
+    Value *find(const FlowKey &key, uint64_t hash)
+    {
+        size_t bucket, slot;
+        return locate(key, hash, bucket, slot) ? &nodes[buckets[bucket].nodes[slot]].value : nullptr;
+    }
+
+    /*
+    @brief 查找key，不存在时插入默认构造的Value
+    @return (值的指针, 是否为新插入)。插入可能使节点数组扩容，之前取得的指针随之失效
+    */
+    std::pair<Value *, bool> insert(const FlowKey &key) { return insert(key, key.hash()); }
+
+    std::pair<Value *, bool> insert(const FlowKey &key, uint64_t hash)
+    {
+        size_t bucket, slot;
+        if (locate(key, hash, bucket, slot))
+            return {&nodes[buckets[bucket].nodes[slot]].value, false};
+
+        if ((live + tombstones + 1) * 8 > capacity() * 7)
+        {
+            // 墓碑较多时原地重建，否则扩容一倍
+            rehash(live * 2 >= capacity() * 7 / 8 ? buckets.size() * 2 : buckets.size());
+            locate(key, hash, bucket, slot);
+        }
+
+        uint32_t index = allocate_node();
+        nodes[index].key = key;
+        if (buckets[bucket].nodes[slot] == TOMBSTONE)
+            tombstones--;
+        buckets[bucket].tags[slot] = tag_of(hash);
+        buckets[bucket].nodes[slot] = index;
+        live++;
+        return {&nodes[index].value, true};
+    }
+
+    bool erase(const FlowKey &key) { return erase(key, key.hash()); }
+
+    bool erase(const FlowKey &key, uint64_t hash)
+    {
+        size_t bucket, slot;
+        if (!locate(key, hash, bucket, slot))
+            return false;
+        release_node(buckets[bucket].nodes[slot]);
+        buckets[bucket].nodes[slot] = TOMBSTONE;
+        tombstones++;
+        live--;
+        return true;
+    }
+
+    // 遍历所有流：visit(const FlowKey &, Value &)
+    template <typename Visitor>
+    void for_each(Visitor &&visit)
+    {
+        for (Node &node : nodes)
+        {
+            if (node.in_use)
+                visit(node.key, node.value);
+        }
+    }
+
+    // 删除pred(const FlowKey &, Value &)返回true的流，返回删除的个数
+    template <typename Predicate>
+    size_t erase_if(Predicate &&pred)
+    {
+        size_t erased = 0;
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            if (nodes[i].in_use && pred(nodes[i].key, nodes[i].value))
+            {
+                FlowKey key = nodes[i].key;
+                erase(key);
+                erased++;
+            }
+        }
+        return erased;
+    }
+
+    void clear()
+    {
+        nodes.clear();
+        free_head = EMPTY;
+        live = 0;
+        reset_buckets(buckets.size());
+    }
+
+private:
+    static uint32_t tag_of(uint64_t hash) { return static_cast<uint32_t>(hash >> 32); }
+
+    void reset_buckets(size_t num_buckets)
+    {
+        Bucket empty_bucket;
+        std::memset(empty_bucket.tags, 0, sizeof(empty_bucket.tags));
+        std::fill(std::begin(empty_bucket.nodes), std::end(empty_bucket.nodes), EMPTY);
+        buckets.assign(num_buckets, empty_bucket);
+        bucket_mask = num_buckets - 1;
+        tombstones = 0;
+    }
+
+    /*
+    线性探测：从hash对应的桶开始逐桶查找，遇到EMPTY槽说明key不存在。
+    找到时bucket/slot指向key所在的槽；找不到时指向第一个可用于插入的槽(墓碑或空槽)
+    */
+    bool locate(const FlowKey &key, uint64_t hash, size_t &bucket, size_t &slot) const
+    {
+        uint32_t tag = tag_of(hash);
+        size_t b = static_cast<size_t>(hash) & bucket_mask;
+        bool have_free = false;
+        for (size_t probes = 0; probes <= bucket_mask; ++probes, b = (b + 1) & bucket_mask)
+        {
+            const Bucket &current = buckets[b];
+            for (size_t s = 0; s < SLOTS_PER_BUCKET; ++s)
+            {
+                uint32_t index = current.nodes[s];
+                if (index == EMPTY)
+                {
+                    if (!have_free)
+                    {
+                        bucket = b;
+                        slot = s;
+                    }
+                    return false;
+                }
+                if (index == TOMBSTONE)
+                {
+                    if (!have_free)
+                    {
+                        bucket = b;
+                        slot = s;
+                        have_free = true;
+                    }
+                    continue;
+                }
+                if (current.tags[s] == tag && nodes[index].key == key)
+                {
+                    bucket = b;
+                    slot = s;
+                    return true;
+                }
+            }
+        }
+        return false; // 表满时insert会先扩容，这里只可能在全是墓碑时到达
+    }
+
+    void rehash(size_t num_buckets)
+    {
+        reset_buckets(num_buckets);
+        for (uint32_t i = 0; i < nodes.size(); ++i)
+        {
+            if (!nodes[i].in_use)
+                continue;
+            uint64_t hash = nodes[i].key.hash();
+            size_t bucket, slot;
+            locate(nodes[i].key, hash, bucket, slot);
+            buckets[bucket].tags[slot] = tag_of(hash);
+            buckets[bucket].nodes[slot] = i;
+        }
+    }
+
+    uint32_t allocate_node()
+    {
+        uint32_t index;
+        if (free_head != EMPTY)
+        {
+            index = free_head;
+            free_head = nodes[index].next_free;
+        }
+        else
+        {
+            index = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+        nodes[index].in_use = true;
+        return index;
+    }
+
+    void release_node(uint32_t index)
+    {
+        nodes[index].value = Value();
+        nodes[index].in_use = false;
+        nodes[index].next_free = free_head;
+        free_head = index;
+    }
+};
+
+#endif // _FLOW_TABLE_HPP_
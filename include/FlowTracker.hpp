@@ -0,0 +1,182 @@
+/*
+FlowTracker用于在线分类：按TCP连接(5元组)跟踪流，每条TLS记录到达时立即交给该流的Featurizer增量更新特征，
+记录数达到N时立即回调，回调中直接取出模型输入，不经过pcap文件，也不需要重新处理整个记录序列。
+方向规则与离线解析一致：发出ClientHello的一端为客户端，收到ServerHello的一端为客户端，方向确定之前的记录被丢弃。
+方向和TLS记录状态都按流保存在FlowTable的节点中，每个数据包只做一次哈希查找。
+一个FlowTracker只被一个抓包线程使用，多线程时每个线程一个实例，由PACKET_FANOUT按流哈希分流。
+*/
+#ifndef _FLOW_TRACKER_HPP_
+#define _FLOW_TRACKER_HPP_
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <functional>
+#include <algorithm>
+
+#include "PcapReader.hpp"
+#include "TLSStreamDecoder.hpp"
+#include "FlowTable.hpp"
+#include "Featurizer.hpp"
+
+// 一个TCP连接的跟踪状态
+struct Flow
+{
+    FlowKey key;
+    uint64_t first_seen_us = 0;  // 第一个数据包的抓包时间
+    uint64_t last_seen_us = 0;   // 最近一个数据包的抓包时间
+    uint64_t last_record_us = 0; // 最近一条TLS记录的抓包时间
+    int8_t client = -1;          // 0: a端为客户端，1: b端为客户端，-1: 尚未确定
+    bool classified = false;     // 已经回调过，之后的记录不再保存
+    Featurizer features;         // 方向确定之后的TLS记录的特征，records()为记录数
+    TLSStreamDecoder::StreamState streams[2]; // a->b 和 b->a 两个方向上的TLS记录状态
+
+    // 客户端的地址和端口
+    const uint8_t *client_addr() const { return client == 1 ? key.addr_b : key.addr_a; }
+    const uint8_t *server_addr() const { return client == 1 ? key.addr_a : key.addr_b; }
+    uint16_t client_port() const { return client == 1 ? key.port_b : key.port_a; }
+    uint16_t server_port() const { return client == 1 ? key.port_a : key.port_b; }
+};
+
+class FlowTracker
+{
+public:
+    struct Stats
+    {
+        uint64_t packets = 0;
+        uint64_t tls_records = 0;
+        uint64_t flows_created = 0;
+        uint64_t flows_ready = 0;   // 记录数达到N后回调的流
+        uint64_t flows_partial = 0; // 结束或超时时记录数不足N、按已有记录回调的流
+        uint64_t flows_evicted = 0;
+    };
+
+    // complete为false表示流在记录数达到N之前就结束了
+    using FlowCallback = std::function<void(const Flow &flow, bool complete)>;
+
+private:
+    size_t target_records;
+    int sequence_length;
+    uint64_t idle_timeout_us;
+    uint16_t port_filter;
+
+    FlowTable<Flow> flows;
+    TCPPacket tcp;
+    Stats counters;
+
+public:
+    /*
+    @param target_records 每个流收集的记录数N，达到后立即回调
+    @param sequence_length 特征的序列长度(模型的序列长度)，超出的记录只计数，不参与特征
+    @param idle_timeout_us 超过该时间没有数据包的流被淘汰
+    @param port_filter 只跟踪一端为该端口的连接，0表示不过滤
+    @param expected_flows 预计的并发流数，用于预分配流表
+    */
+    FlowTracker(size_t target_records, int sequence_length, uint64_t idle_timeout_us, uint16_t port_filter = 443,
+                size_t expected_flows = 4096)
+        : target_records(target_records), sequence_length(sequence_length), idle_timeout_us(idle_timeout_us),
+          port_filter(port_filter), flows(expected_flows)
+    {
+    }
+
+    void process(const RawPacket &raw, const FlowCallback &on_flow)
+    {
+        if (!PacketDecoder::decode_tcp(raw, tcp))
+            return;
+        if (port_filter != 0 && tcp.src_port != port_filter && tcp.dst_port != port_filter)
+            return;
+        counters.packets++;
+
+        bool from_a;
+        FlowKey key = FlowKey::from_packet(tcp, from_a);
+        uint64_t hash = key.hash();
+        Flow *slot = flows.find(key, hash);
+        bool created = !slot;
+        if (created)
+        {
+            // 连接关闭后的FIN/ACK等空包不再新建流，带载荷的包仍可建流(抓包开始前已存在的连接)
+            if (!(tcp.flags & 0x02) && tcp.payload_len == 0)
+                return;
+            slot = flows.insert(key, hash).first;
+        }
+        Flow &flow = *slot;
+        if (created)
+        {
+            flow.key = key;
+            flow.first_seen_us = raw.timestamp_us;
+            flow.features = Featurizer(sequence_length);
+            counters.flows_created++;
+        }
+        flow.last_seen_us = raw.timestamp_us;
+
+        // 已分类的流不再解析TLS
+        TLSPacketInfo info = flow.classified ? TLSPacketInfo() : TLSStreamDecoder::process(tcp, flow.streams[from_a ? 0 : 1]);
+        if (info.is_tls)
+        {
+            counters.tls_records++;
+            if (info.tls_handshake_type == 1) // ClientHello由客户端发出
+                flow.client = from_a ? 0 : 1;
+            else if (info.tls_handshake_type == 2) // ServerHello由服务端发出
+                flow.client = from_a ? 1 : 0;
+
+            if (flow.client >= 0)
+            {
+                bool from_client = (flow.client == 0) == from_a;
+                flow.features.push(static_cast<uint16_t>(std::min<uint32_t>(raw.origlen, 65535)), from_client ? 0 : 1);
+                flow.last_record_us = raw.timestamp_us;
+
+                if (flow.features.records() >= target_records)
+                {
+                    counters.flows_ready++;
+                    flow.classified = true;
+                    on_flow(flow, true);
+                    // 分类完成后不再需要记录，流本身保留到连接结束，避免被重复分类
+                    flow.features.release();
+                }
+            }
+        }
+
+        if (tcp.flags & 0x05) // FIN或RST
+        {
+            finish(flow, on_flow);
+            flows.erase(key, hash);
+        }
+    }
+
+    // 淘汰空闲的流，now_us与抓包时间戳使用同一时钟
+    void expire(uint64_t now_us, const FlowCallback &on_flow)
+    {
+        flows.erase_if([&](const FlowKey &, Flow &flow)
+                       {
+                           if (now_us <= flow.last_seen_us + idle_timeout_us)
+                               return false;
+                           finish(flow, on_flow);
+                           return true; });
+    }
+
+    // 结束所有流(退出前调用)
+    void flush(const FlowCallback &on_flow)
+    {
+        flows.for_each([&](const FlowKey &, Flow &flow)
+                       { finish(flow, on_flow); });
+        flows.clear();
+    }
+
+    size_t active_flows() const { return flows.size(); }
+    const Stats &stats() const { return counters; }
+
+private:
+    // 流结束前的回调，之后由调用者从流表中删除
+    void finish(const Flow &flow, const FlowCallback &on_flow)
+    {
+        if (!flow.classified && !flow.features.empty())
+        {
+            counters.flows_partial++;
+            on_flow(flow, false);
+        }
+        counters.flows_evicted++;
+    }
+};
+
+#endif // _FLOW_TRACKER_HPP_
@@ -0,0 +1,451 @@
+/*
+HttpsCollector为基于epoll的并发流量生成器，取代逐个域名、逐次串行的 HttpsClient + sleep 循环：
+    - 所有会话共用一个SSL_CTX，OpenSSL只初始化一次(客户端默认不缓存会话，每次仍是完整握手，流量特征不变)
+    - 每个域名只解析一次DNS，结果缓存后所有会话共用
+    - 所有socket为非阻塞，connect、TLS握手、发送请求、接收响应都由同一个epoll循环驱动，
+      多个域名的多个会话同时进行，总时间取决于最慢的会话而不是所有会话之和
+    - 每个会话的五元组和起止时间写入SessionLog，供事后从同一个抓包文件中拆分出各个会话
+*/
+#ifndef _HTTPS_COLLECTOR_HPP_
+#define _HTTPS_COLLECTOR_HPP_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#include "SessionLog.hpp"
+#include "Logger.hpp"
+
+struct CollectorOptions
+{
+    int samples_per_domain = 50;    // 每个域名需要成功的会话数
+    int max_concurrency = 32;       // 同时进行的会话总数
+    int per_domain_concurrency = 4; // 每个域名同时进行的会话数，避免同一站点短时间内收到过多连接
+    int timeout_ms = 15000;         // 单个会话的超时时间
+    int max_attempts_factor = 2;    // 每个域名最多尝试 samples_per_domain * max_attempts_factor 次
+    int port = 443;
+};
+
+// 域名 -> IPv4地址 的缓存，每个域名只解析一次
+class DnsCache
+{
+private:
+    std::unordered_map<std::string, in_addr> cache;
+
+public:
+    bool resolve(const std::string &hostname, in_addr &addr)
+    {
+        auto it = cache.find(hostname);
+        if (it != cache.end())
+        {
+            addr = it->second;
+            return true;
+        }
+
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *result = nullptr;
+        int err = getaddrinfo(hostname.c_str(), nullptr, &hints, &result);
+        if (err != 0 || !result)
+        {
+            LOG_ERROR << "Failed to resolve hostname: " << hostname << " (" << gai_strerror(err) << ")";
+            return false;
+        }
+        addr = reinterpret_cast<sockaddr_in *>(result->ai_addr)->sin_addr;
+        freeaddrinfo(result);
+        cache[hostname] = addr;
+        return true;
+    }
+};
+
+class HttpsCollector
+{
+private:
+    enum class State
+    {
+        CONNECTING,
+        HANDSHAKE,
+        WRITING,
+        READING,
+        DONE
+    };
+
+    // 一个进行中的会话
+    struct Session
+    {
+        size_t domain_index = 0;
+        int fd = -1;
+        SSL *ssl = nullptr;
+        State state = State::CONNECTING;
+        uint64_t deadline_us = 0;
+        uint32_t events = 0; // 当前在epoll中关注的事件
+        SessionRecord record;
+    };
+
+    // 每个域名的进度
+    struct DomainProgress
+    {
+        std::string domain;
+        std::string request;
+        sockaddr_in addr{};
+        bool resolved = false;
+        int active = 0;
+        int succeeded = 0;
+        int attempts = 0;
+    };
+
+    CollectorOptions options;
+    SSL_CTX *ssl_ctx = nullptr;
+    int epoll_fd = -1;
+    DnsCache dns;
+    std::vector<DomainProgress> domains;
+    std::vector<std::unique_ptr<Session>> sessions;
+    std::vector<SessionRecord> log;
+    size_t next_domain = 0; // 轮流为各个域名发起会话
+
+public:
+    explicit HttpsCollector(const CollectorOptions &options = CollectorOptions())
+        : options(options)
+    {
+        OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS | OPENSSL_INIT_LOAD_CRYPTO_STRINGS, nullptr);
+        ssl_ctx = SSL_CTX_new(TLS_client_method());
+        if (!ssl_ctx)
+        {
+            ERR_print_errors_fp(stderr);
+            throw std::runtime_error("[ERROR] Failed to create SSL context!");
+        }
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0)
+        {
+            SSL_CTX_free(ssl_ctx);
+            throw std::runtime_error("[ERROR] Failed to create epoll instance: " + std::string(strerror(errno)));
+        }
+    }
+
+    ~HttpsCollector()
+    {
+        for (auto &session : sessions)
+            close_session(*session);
+        if (epoll_fd >= 0)
+            close(epoll_fd);
+        if (ssl_ctx)
+            SSL_CTX_free(ssl_ctx);
+    }
+
+    HttpsCollector(const HttpsCollector &) = delete;
+    HttpsCollector &operator=(const HttpsCollector &) = delete;
+
+    /*
+    @brief 对每个域名完成samples_per_domain次成功的HTTPS请求(或用完尝试次数)后返回
+    @return 所有会话(包括失败的)的记录
+    */
+    const std::vector<SessionRecord> &run(const std::vector<std::string> &domain_list)
+    {
+        domains.clear();
+        for (const std::string &domain : domain_list)
+        {
+            DomainProgress progress;
+            progress.domain = domain;
+            progress.request = "GET / HTTP/1.1\r\n"
+                               "Host: " +
+                               domain + "\r\n"
+                                        "Connection: close\r\n"
+                                        "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36\r\n"
+                                        "\r\n";
+            in_addr ip;
+            if (dns.resolve(domain, ip))
+            {
+                progress.addr.sin_family = AF_INET;
+                progress.addr.sin_port = htons(static_cast<uint16_t>(options.port));
+                progress.addr.sin_addr = ip;
+                progress.resolved = true;
+            }
+            domains.push_back(progress);
+        }
+
+        LOG_INFO << "Collecting " << options.samples_per_domain << " sessions for each of " << domains.size()
+                 << " domains, up to " << options.max_concurrency << " concurrent";
+
+        epoll_event events[64];
+        while (true)
+        {
+            launch_sessions();
+            if (sessions.empty())
+                break;
+
+            int n = epoll_wait(epoll_fd, events, 64, 100);
+            if (n < 0 && errno != EINTR)
+            {
+                LOG_ERROR << "epoll_wait failed: " << strerror(errno);
+                break;
+            }
+            for (int i = 0; i < n; ++i)
+                advance(*static_cast<Session *>(events[i].data.ptr));
+
+            uint64_t now = realtime_us();
+            for (auto &session : sessions)
+            {
+                if (session->state != State::DONE && now > session->deadline_us)
+                {
+                    LOG_WARN << "Session to " << domains[session->domain_index].domain << " timed out";
+                    finish(*session, false);
+                }
+            }
+            reap_sessions();
+        }
+
+        for (const DomainProgress &progress : domains)
+        {
+            LOG_INFO << progress.domain << ": " << progress.succeeded << "/" << options.samples_per_domain
+                     << " sessions (" << progress.attempts << " attempts)";
+        }
+        Logger::instance()->flush(); // 采集日志先于调用方随后的直接输出
+        return log;
+    }
+
+    const std::vector<SessionRecord> &get_log() const { return log; }
+
+private:
+    static uint64_t realtime_us()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts); // 与抓包时间戳使用同一时钟
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000;
+    }
+
+    bool wants_more(const DomainProgress &progress) const
+    {
+        return progress.resolved && progress.succeeded + progress.active < options.samples_per_domain &&
+               progress.attempts < options.samples_per_domain * options.max_attempts_factor &&
+               progress.active < options.per_domain_concurrency;
+    }
+
+    // 在并发上限内轮流为各个域名发起新会话
+    void launch_sessions()
+    {
+        size_t idle_rounds = 0;
+        while (static_cast<int>(sessions.size()) < options.max_concurrency && idle_rounds < domains.size())
+        {
+            DomainProgress &progress = domains[next_domain];
+            size_t index = next_domain;
+            next_domain = (next_domain + 1) % domains.size();
+            if (!wants_more(progress))
+            {
+                idle_rounds++;
+                continue;
+            }
+            idle_rounds = 0;
+            start_session(index);
+        }
+    }
+
+    void start_session(size_t domain_index)
+    {
+        DomainProgress &progress = domains[domain_index];
+        progress.attempts++;
+
+        auto session = std::make_unique<Session>();
+        session->domain_index = domain_index;
+        session->record.domain = progress.domain;
+        session->record.server_addr = inet_ntoa(progress.addr.sin_addr);
+        session->record.server_port = static_cast<uint16_t>(options.port);
+        session->record.start_us = realtime_us();
+        session->deadline_us = session->record.start_us + static_cast<uint64_t>(options.timeout_ms) * 1000;
+
+        session->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (session->fd < 0)
+        {
+            LOG_ERROR << "Failed to create socket: " << strerror(errno);
+            log.push_back(session->record);
+            return;
+        }
+        if (connect(session->fd, reinterpret_cast<const sockaddr *>(&progress.addr), sizeof(progress.addr)) < 0 &&
+            errno != EINPROGRESS)
+        {
+            LOG_ERROR << "Failed to connect to " << progress.domain << ": " << strerror(errno);
+            close(session->fd);
+            log.push_back(session->record);
+            return;
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLOUT;
+        ev.data.ptr = session.get();
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, session->fd, &ev);
+        session->events = EPOLLOUT;
+        progress.active++;
+        sessions.push_back(std::move(session));
+    }
+
+    void watch(Session &session, uint32_t events)
+    {
+        if (session.events == events)
+            return;
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.ptr = &session;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, session.fd, &ev);
+        session.events = events;
+    }
+
+    // SSL调用返回WANT_READ/WANT_WRITE时等待相应事件，返回false表示出错
+    bool wait_for_ssl(Session &session, int ret)
+    {
+        int err = SSL_get_error(session.ssl, ret);
+        if (err == SSL_ERROR_WANT_READ)
+            watch(session, EPOLLIN);
+        else if (err == SSL_ERROR_WANT_WRITE)
+            watch(session, EPOLLOUT);
+        else
+            return false;
+        return true;
+    }
+
+    // 根据会话状态推进：connect完成 -> 握手 -> 发送请求 -> 接收响应直到对端关闭
+    void advance(Session &session)
+    {
+        DomainProgress &progress = domains[session.domain_index];
+
+        if (session.state == State::CONNECTING)
+        {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            getsockopt(session.fd, SOL_SOCKET, SO_ERROR, &error, &len);
+            if (error != 0)
+            {
+                LOG_ERROR << "Failed to connect to " << progress.domain << ": " << strerror(error);
+                finish(session, false);
+                return;
+            }
+
+            sockaddr_in local{};
+            socklen_t local_len = sizeof(local);
+            getsockname(session.fd, reinterpret_cast<sockaddr *>(&local), &local_len);
+            session.record.client_addr = inet_ntoa(local.sin_addr);
+            session.record.client_port = ntohs(local.sin_port);
+
+            session.ssl = SSL_new(ssl_ctx);
+            if (!session.ssl)
+            {
+                ERR_print_errors_fp(stderr);
+                finish(session, false);
+                return;
+            }
+            SSL_set_fd(session.ssl, session.fd);
+            SSL_set_tlsext_host_name(session.ssl, progress.domain.c_str()); // 设置SNI
+            session.state = State::HANDSHAKE;
+        }
+
+        if (session.state == State::HANDSHAKE)
+        {
+            int ret = SSL_connect(session.ssl);
+            if (ret <= 0)
+            {
+                if (!wait_for_ssl(session, ret))
+                {
+                    LOG_ERROR << "TLS handshake with " << progress.domain << " failed";
+                    ERR_clear_error();
+                    finish(session, false);
+                }
+                return;
+            }
+            session.state = State::WRITING;
+        }
+
+        if (session.state == State::WRITING)
+        {
+            // 未设置SSL_MODE_ENABLE_PARTIAL_WRITE，请求要么全部写入，要么返回WANT_*后用相同参数重试
+            int ret = SSL_write(session.ssl, progress.request.data(), static_cast<int>(progress.request.size()));
+            if (ret <= 0)
+            {
+                if (!wait_for_ssl(session, ret))
+                {
+                    LOG_ERROR << "Failed to send HTTP request to " << progress.domain;
+                    ERR_clear_error();
+                    finish(session, false);
+                }
+                return;
+            }
+            session.state = State::READING;
+            watch(session, EPOLLIN);
+        }
+
+        if (session.state == State::READING)
+        {
+            char buffer[16384];
+            while (true)
+            {
+                int ret = SSL_read(session.ssl, buffer, sizeof(buffer));
+                if (ret > 0)
+                {
+                    session.record.bytes += static_cast<size_t>(ret);
+                    continue;
+                }
+                int err = SSL_get_error(session.ssl, ret);
+                if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+                {
+                    watch(session, err == SSL_ERROR_WANT_READ ? EPOLLIN : EPOLLOUT);
+                    return;
+                }
+                // Connection: close，对端关闭连接(close_notify或直接EOF)即响应结束
+                ERR_clear_error();
+                finish(session, session.record.bytes > 0);
+                return;
+            }
+        }
+    }
+
+    void finish(Session &session, bool ok)
+    {
+        DomainProgress &progress = domains[session.domain_index];
+        session.record.ok = ok;
+        session.record.end_us = realtime_us();
+        session.state = State::DONE;
+        progress.active--;
+        if (ok)
+            progress.succeeded++;
+        log.push_back(session.record);
+        close_session(session);
+    }
+
+    void close_session(Session &session)
+    {
+        if (session.ssl)
+        {
+            SSL_shutdown(session.ssl); // 非阻塞，只尝试发送close_notify
+            SSL_free(session.ssl);
+            session.ssl = nullptr;
+        }
+        if (session.fd >= 0)
+        {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, session.fd, nullptr);
+            close(session.fd);
+            session.fd = -1;
+        }
+    }
+
+    void reap_sessions()
+    {
+        sessions.erase(std::remove_if(sessions.begin(), sessions.end(), [](const std::unique_ptr<Session> &session)
+                                      { return session->state == State::DONE; }),
+                       sessions.end());
+    }
+};
+
+#endif // _HTTPS_COLLECTOR_HPP_
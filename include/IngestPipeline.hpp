@@ -0,0 +1,481 @@
+/*
+IngestPipeline为非交互的流水线数据生成模式，采集、解析、特征整理和写入四个阶段由有界队列连接并同时运行：
+    采集(1个线程)    分轮次采集，每轮一个采集目录(抓包环 + 会话日志)，完成一轮立即交给解析；
+                     开始采集前先把已有的pcap文件和采集目录作为任务送入队列
+    解析(N个线程)    每个任务解析为一个私有的TLSTraceStore：pcap文件未变化时直接复用解析缓存，否则用Parser::parse_file
+                     按Parser的解析后端(原生/--tshark/--verify)解析；采集目录用SessionDemux(总是使用原生解码器)
+    整理(M个线程)    按网站名称查找标签，过滤无效记录，打包为样本
+    写入(1个线程)    按任务编号重新排序后追加到FeatureDatasetWriter，结束时写出数据集和标签映射
+队列满时上游阻塞，内存占用与队列容量成正比；总耗时趋近于最慢的阶段而不是三个阶段之和。
+任务编号按 站点 -> 文件名 -> 采集目录 的顺序分配，输出数据集与串行模式完全相同(与线程调度无关)。
+*/
+#ifndef _INGEST_PIPELINE_HPP_
+#define _INGEST_PIPELINE_HPP_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <exception>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "BoundedQueue.hpp"
+#include "Capture.hpp"
+#include "HttpsCollector.hpp"
+#include "SessionLog.hpp"
+#include "SessionDemux.hpp"
+#include "Parser.hpp"
+#include "FileLoader.hpp"
+#include "TraceCache.hpp"
+#include "TLSRecordToCsv.hpp"
+#include "FeatureDataset.hpp"
+#include "ShardedDataset.hpp"
+#include "Metrics.hpp"
+#include "Logger.hpp"
+
+struct PipelineOptions
+{
+    bool collect = true;  // 是否采集新数据，为false时只处理已有的pcap文件和采集目录
+    int rounds = 5;       // 采集轮数，每轮每个域名采集 samples_per_domain / rounds 个会话
+    CollectorOptions collector;
+    size_t ring_file_mb = 100;
+    size_t ring_files = 10;
+    std::string data_dir = "../data";
+    std::string capture_root = "../capture";
+    std::string cache_path;       // 解析结果缓存(只读)，为空时不使用
+    size_t parse_threads = 0;     // 0表示使用全部硬件线程
+    size_t featurize_threads = 1;
+    size_t queue_capacity = 4;    // 每个队列最多缓存的任务数
+};
+
+class IngestPipeline
+{
+private:
+    // 一个解析任务：一个pcap文件或一个采集目录
+    struct IngestJob
+    {
+        size_t sequence = 0;
+        std::string site_name; // 采集目录中的标签来自会话日志，此处为空
+        std::string path;
+        bool capture = false;
+    };
+
+    struct TraceBatch
+    {
+        size_t sequence = 0;
+        std::unique_ptr<TLSTraceStore> store;
+    };
+
+    // 整理后的样本，records按样本顺序连续存放
+    struct SampleBatch
+    {
+        size_t sequence = 0;
+        std::vector<int> labels;
+        std::vector<uint64_t> keys; // 样本键(网站名/文件名)的哈希，写分片数据集时决定样本所在的分片
+        std::vector<uint32_t> lengths;
+        std::vector<uint16_t> sizes;
+        std::vector<int8_t> directions;
+    };
+
+    // 各阶段的累计耗时，用于判断瓶颈
+    struct StageTimes
+    {
+        double collect = 0.0;
+        double parse = 0.0;
+        double featurize = 0.0;
+        double write = 0.0;
+    };
+
+    // 每个任务在各阶段的耗时和各队列的长度，运行过程中可通过MetricsExporter观察
+    struct StageMetrics
+    {
+        Histogram &collect;
+        Histogram &parse;
+        Histogram &featurize;
+        Histogram &write;
+        Gauge &job_queue;
+        Gauge &trace_queue;
+        Gauge &sample_queue;
+        Counter &samples;
+    };
+
+    PipelineOptions options;
+    Parser &parser;
+    TLSRecordToCsv &converter;
+    TraceCache cache;
+    bool use_cache = false;
+
+    BoundedQueue<IngestJob> job_queue;
+    BoundedQueue<TraceBatch> trace_queue;
+    BoundedQueue<SampleBatch> sample_queue;
+
+    std::mutex stats_mutex;
+    StageTimes times;
+    StageMetrics metrics;
+    std::exception_ptr first_exception;
+
+public:
+    /*
+    @param parser 流式解析pcap文件(parse_corpus为false)，parse_file可被多个线程同时调用
+    @param converter 提供站点标签映射和数据集输出路径
+    */
+    IngestPipeline(const PipelineOptions &options, Parser &parser, TLSRecordToCsv &converter)
+        : options(options), parser(parser), converter(converter),
+          job_queue(options.queue_capacity), trace_queue(options.queue_capacity), sample_queue(options.queue_capacity),
+          metrics(make_metrics())
+    {
+        parser.set_verbose(false);
+        if (!options.cache_path.empty() && cache.load(options.cache_path, parser.get_record_budget()))
+        {
+            use_cache = true;
+            LOG_INFO << "Loaded " << cache.size() << " cached pcap files from " << options.cache_path;
+        }
+    }
+
+    /*
+    @brief 运行整个流水线直到所有任务写入数据集
+    @return 写入的样本数
+    */
+    size_t run()
+    {
+        auto start = std::chrono::steady_clock::now();
+        size_t parse_threads = options.parse_threads > 0 ? options.parse_threads : std::max(1u, std::thread::hardware_concurrency());
+        size_t featurize_threads = std::max<size_t>(options.featurize_threads, 1);
+        LOG_INFO << "Pipeline: " << parse_threads << " parse threads, " << featurize_threads
+                 << " featurize threads, queue capacity " << options.queue_capacity;
+
+        FeatureDatasetWriter writer;
+        ShardedDatasetWriter sharded_writer(converter.get_num_shards());
+        std::thread source(&IngestPipeline::guarded, this, [this]
+                           { produce_jobs(); });
+        std::vector<std::thread> parsers, featurizers;
+        for (size_t i = 0; i < parse_threads; ++i)
+            parsers.emplace_back(&IngestPipeline::guarded, this, [this]
+                                 { parse_jobs(); });
+        for (size_t i = 0; i < featurize_threads; ++i)
+            featurizers.emplace_back(&IngestPipeline::guarded, this, [this]
+                                     { featurize_batches(); });
+        std::thread sink(&IngestPipeline::guarded, this, [this, &writer, &sharded_writer]
+                         { write_batches(writer, sharded_writer); });
+
+        // 上游全部结束后关闭下游队列，下游取完剩余任务后退出
+        source.join();
+        job_queue.close();
+        for (auto &t : parsers)
+            t.join();
+        trace_queue.close();
+        for (auto &t : featurizers)
+            t.join();
+        sample_queue.close();
+        sink.join();
+
+        Logger::instance()->flush();
+        if (first_exception)
+            std::rethrow_exception(first_exception);
+        bool sharded = converter.get_num_shards() > 0;
+        if (sharded ? !converter.write_dataset(sharded_writer) : !converter.write_dataset(writer))
+            return 0;
+        size_t num_samples = sharded ? sharded_writer.num_samples() : writer.num_samples();
+
+        double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        LOG_INFO << "Pipeline completed in " << total << "s, " << num_samples << " samples written to "
+                 << converter.get_dataset_path();
+        LOG_INFO << "Stage busy time: collect " << times.collect << "s, parse " << times.parse << "s (over "
+                 << parse_threads << " threads), featurize " << times.featurize << "s, write " << times.write << "s";
+        Logger::instance()->flush();
+        return num_samples;
+    }
+
+    /*
+    @brief 进行一次采集：启动一个tcpdump写入capture_dir下的抓包环，并发完成所有域名的会话后写入会话日志
+    @return 成功完成的会话数，tcpdump无法启动时返回0
+    */
+    static size_t collect_capture(const std::string &capture_dir, const std::vector<std::string> &domains,
+                                  const CollectorOptions &collector_options, size_t ring_file_mb, size_t ring_files)
+    {
+        size_t last_slash = capture_dir.find_last_of('/');
+        if (last_slash != std::string::npos)
+            mkdir(capture_dir.substr(0, last_slash).c_str(), 0755);
+
+        Capture capture("any", "tcp port " + std::to_string(collector_options.port));
+        std::cout << "[INFO] Starting capture packets ..." << std::endl;
+        if (!capture.start_file(capture_dir + "/" + SessionDemux::RING_PREFIX, ring_file_mb, ring_files))
+            return 0;
+        sleep(1); // 等待tcpdump开始抓包
+
+        std::vector<SessionRecord> sessions;
+        try
+        {
+            HttpsCollector collector(collector_options);
+            sessions = collector.run(domains);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "[ERROR] EXCEPTION:" << e.what() << std::endl;
+        }
+        sleep(1); // 等待最后的FIN/RST被抓到
+
+        std::cout << "[INFO] Stopping packet capture ..." << std::endl;
+        capture.stop();
+
+        SessionLog::write(capture_dir + "/" + SessionDemux::SESSION_LOG, sessions);
+        return static_cast<size_t>(std::count_if(sessions.begin(), sessions.end(), [](const SessionRecord &r)
+                                                 { return r.ok; }));
+    }
+
+private:
+    static StageMetrics make_metrics()
+    {
+        MetricsRegistry *r = MetricsRegistry::instance();
+        const char *stage_help = "Time spent on one job in each pipeline stage";
+        const char *queue_help = "Items waiting in each pipeline queue";
+        return StageMetrics{
+            r->histogram("tls_pipeline_stage_seconds", stage_help, "stage=\"collect\""),
+            r->histogram("tls_pipeline_stage_seconds", stage_help, "stage=\"parse\""),
+            r->histogram("tls_pipeline_stage_seconds", stage_help, "stage=\"featurize\""),
+            r->histogram("tls_pipeline_stage_seconds", stage_help, "stage=\"write\""),
+            r->gauge("tls_pipeline_queue_depth", queue_help, "queue=\"jobs\""),
+            r->gauge("tls_pipeline_queue_depth", queue_help, "queue=\"traces\""),
+            r->gauge("tls_pipeline_queue_depth", queue_help, "queue=\"samples\""),
+            r->counter("tls_pipeline_samples_total", "Samples appended to the dataset")};
+    }
+
+    static double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // 线程入口：记录第一个异常并关闭所有队列，使其他阶段尽快退出
+    void guarded(const std::function<void()> &stage)
+    {
+        try
+        {
+            stage();
+        }
+        catch (...)
+        {
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                if (!first_exception)
+                    first_exception = std::current_exception();
+            }
+            job_queue.close();
+            trace_queue.close();
+            sample_queue.close();
+        }
+    }
+
+    // 采集阶段：先送入已有数据，再分轮采集新数据
+    void produce_jobs()
+    {
+        size_t sequence = 0;
+
+        // 已有的pcap文件，按 站点 -> 文件名 排序
+        FileLoader::instance()->start(options.data_dir);
+        const auto &file_map = FileLoader::instance()->get_file_map();
+        std::vector<std::string> sites;
+        for (const auto &site : file_map)
+            sites.push_back(site.first);
+        std::sort(sites.begin(), sites.end());
+        for (const std::string &site : sites)
+        {
+            for (const std::string &file : file_map.at(site))
+            {
+                if (!job_queue.push({sequence++, site, file, false}))
+                    return;
+            }
+        }
+
+        // 已有的采集目录
+        for (const std::string &capture_dir : SessionDemux::list_capture_dirs(options.capture_root))
+        {
+            if (!job_queue.push({sequence++, "", capture_dir, true}))
+                return;
+        }
+
+        if (!options.collect)
+            return;
+
+        int rounds = std::max(1, options.rounds);
+        const std::vector<std::string> &domains = DomainManager::instance()->get_domains();
+        for (int round = 0; round < rounds; ++round)
+        {
+            // 会话数平均分配到各轮，余数分给前几轮
+            CollectorOptions round_options = options.collector;
+            round_options.samples_per_domain = options.collector.samples_per_domain / rounds +
+                                               (round < options.collector.samples_per_domain % rounds ? 1 : 0);
+            if (round_options.samples_per_domain == 0)
+                continue;
+
+            LOG_INFO << "Capture round " << round + 1 << "/" << rounds;
+            auto start = std::chrono::steady_clock::now();
+            std::string timestamp = std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+            std::string capture_dir = options.capture_root + "/" + timestamp;
+            size_t ok = collect_capture(capture_dir, domains, round_options, options.ring_file_mb, options.ring_files);
+            double elapsed = seconds_since(start);
+            metrics.collect.observe_seconds(elapsed);
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                times.collect += elapsed;
+            }
+            if (ok == 0)
+            {
+                LOG_ERROR << "Capture round " << round + 1 << " collected no sessions, stopping collection";
+                return;
+            }
+            if (!job_queue.push({sequence++, "", capture_dir, true}))
+                return;
+        }
+    }
+
+    // 解析阶段
+    void parse_jobs()
+    {
+        IngestJob job;
+        double busy = 0.0;
+        while (job_queue.pop(job))
+        {
+            metrics.job_queue.set(static_cast<int64_t>(job_queue.size()));
+            auto start = std::chrono::steady_clock::now();
+            TraceBatch batch;
+            batch.sequence = job.sequence;
+            batch.store = std::make_unique<TLSTraceStore>();
+            if (job.capture)
+                SessionDemux::demux_capture(job.path, *batch.store, parser.get_record_budget());
+            else
+                parse_pcap(job, *batch.store);
+            double elapsed = seconds_since(start);
+            metrics.parse.observe_seconds(elapsed);
+            busy += elapsed;
+            if (!trace_queue.push(std::move(batch)))
+                break;
+        }
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        times.parse += busy;
+    }
+
+    void parse_pcap(const IngestJob &job, TLSTraceStore &store) const
+    {
+        FileStamp stamp;
+        if (use_cache && FileStamp::of(job.path, stamp))
+        {
+            const TraceCache::Entry *entry = cache.find(job.path);
+            if (entry && entry->stamp == stamp)
+            {
+                if (cache.get_store().trace(entry->trace_index).length > 0)
+                    store.append_trace(cache.get_store(), entry->trace_index);
+                return;
+            }
+        }
+
+        std::string_view filename(job.path);
+        filename.remove_prefix(filename.find_last_of('/') + 1);
+        store.begin_trace(job.site_name, filename);
+        parser.parse_file(job.path, [&store](const TLSRecord &tls_record)
+                          { store.push_record(tls_record.frame_length, tls_record.tls_handshake_type,
+                                              tls_record.tls_direction, tls_record.ip_src, tls_record.ip_dst); });
+        store.end_trace();
+    }
+
+    // 整理阶段：查找标签，只保留大小非0且方向已知的记录(与generate_dataset一致)
+    void featurize_batches()
+    {
+        TraceBatch batch;
+        double busy = 0.0;
+        while (trace_queue.pop(batch))
+        {
+            metrics.trace_queue.set(static_cast<int64_t>(trace_queue.size()));
+            auto start = std::chrono::steady_clock::now();
+            SampleBatch samples;
+            samples.sequence = batch.sequence;
+            const TLSTraceStore &store = *batch.store;
+            samples.sizes.reserve(store.num_records());
+            samples.directions.reserve(store.num_records());
+
+            std::vector<int> site_labels(store.get_sites().size());
+            for (size_t site_id = 0; site_id < site_labels.size(); ++site_id)
+            {
+                const std::string &site_name = store.get_sites().get(static_cast<uint32_t>(site_id));
+                site_labels[site_id] = converter.label_of(site_name);
+                if (site_labels[site_id] < 0)
+                    LOG_WARN << "Site not found in labels: " << site_name;
+            }
+
+            for (size_t i = 0; i < store.num_traces(); ++i)
+            {
+                TraceView trace = store.trace(i);
+                int label = site_labels[trace.info->site_id];
+                if (label < 0)
+                    continue;
+                size_t begin = samples.sizes.size();
+                for (size_t r = 0; r < trace.length; ++r)
+                {
+                    if (trace.sizes[r] == 0 || trace.directions[r] < 0)
+                        continue;
+                    samples.sizes.push_back(trace.sizes[r]);
+                    samples.directions.push_back(trace.directions[r]);
+                }
+                if (samples.sizes.size() == begin)
+                    continue;
+                samples.labels.push_back(label);
+                samples.keys.push_back(shard_format::key_hash(store.site_name(*trace.info), store.file_name(*trace.info)));
+                samples.lengths.push_back(static_cast<uint32_t>(samples.sizes.size() - begin));
+            }
+            double elapsed = seconds_since(start);
+            metrics.featurize.observe_seconds(elapsed);
+            busy += elapsed;
+            if (!sample_queue.push(std::move(samples)))
+                break;
+        }
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        times.featurize += busy;
+    }
+
+    // 写入阶段：乱序到达的批次暂存，按编号连续追加；转换器设置了分片数时写入sharded_writer
+    void write_batches(FeatureDatasetWriter &writer, ShardedDatasetWriter &sharded_writer)
+    {
+        bool sharded = converter.get_num_shards() > 0;
+        std::map<size_t, SampleBatch> pending;
+        size_t next_sequence = 0;
+        SampleBatch batch;
+        double busy = 0.0;
+        while (sample_queue.pop(batch))
+        {
+            metrics.sample_queue.set(static_cast<int64_t>(sample_queue.size()));
+            auto start = std::chrono::steady_clock::now();
+            size_t sequence = batch.sequence;
+            pending.emplace(sequence, std::move(batch));
+            for (auto it = pending.find(next_sequence); it != pending.end(); it = pending.find(next_sequence))
+            {
+                const SampleBatch &ready = it->second;
+                size_t offset = 0;
+                for (size_t i = 0; i < ready.labels.size(); ++i)
+                {
+                    if (sharded)
+                        sharded_writer.add_sample(ready.keys[i], ready.labels[i], ready.sizes.data() + offset,
+                                                  ready.directions.data() + offset, ready.lengths[i], false);
+                    else
+                        writer.add_sample(ready.labels[i], ready.sizes.data() + offset, ready.directions.data() + offset,
+                                          ready.lengths[i], false);
+                    offset += ready.lengths[i];
+                }
+                metrics.samples.add(ready.labels.size());
+                pending.erase(it);
+                next_sequence++;
+            }
+            double elapsed = seconds_since(start);
+            metrics.write.observe_seconds(elapsed);
+            busy += elapsed;
+        }
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        times.write += busy;
+    }
+};
+
+#endif // _INGEST_PIPELINE_HPP_
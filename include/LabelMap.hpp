@@ -0,0 +1,104 @@
+/*
+LabelMap读取TLSRecordToCsv生成的site_labels.csv(label,site_name)，提供 标签 <-> 网站名称 的映射，
+供预测和在线分类在不加载训练数据的情况下显示网站名称。
+*/
+#ifndef _LABEL_MAP_HPP_
+#define _LABEL_MAP_HPP_
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdlib>
+
+#include "Logger.hpp"
+
+class LabelMap
+{
+private:
+    std::vector<std::string> names; // 下标为标签，空字符串表示该标签没有名称
+
+public:
+    // 读取标签映射文件，文件不存在时返回false，此时name()退回为"Label_<n>"
+    bool load(const std::string &path)
+    {
+        names.clear();
+        std::ifstream ifs(path);
+        if (!ifs.is_open())
+        {
+            std::cerr << "[WARN] Label map not found: " << path << std::endl;
+            return false;
+        }
+
+        std::string line;
+        std::getline(ifs, line); // 跳过header
+        while (std::getline(ifs, line))
+        {
+            size_t comma = line.find(',');
+            if (comma == std::string::npos)
+                continue;
+            int label = std::atoi(line.substr(0, comma).c_str());
+            if (label >= 0)
+                set(label, line.substr(comma + 1));
+        }
+        return true;
+    }
+
+    // 使用模型文件或数据集中自带的标签表
+    void assign(const std::vector<std::pair<int, std::string>> &labels)
+    {
+        names.clear();
+        for (const auto &pair : labels)
+        {
+            if (pair.first >= 0)
+                set(pair.first, pair.second);
+        }
+    }
+
+    void set(int label, const std::string &site_name)
+    {
+        if (static_cast<size_t>(label) >= names.size())
+            names.resize(label + 1);
+        names[label] = site_name;
+    }
+
+    size_t size() const { return names.size(); }
+
+    std::string name(int label) const
+    {
+        if (label >= 0 && static_cast<size_t>(label) < names.size() && !names[label].empty())
+            return names[label];
+        return "Label_" + std::to_string(label);
+    }
+
+    // 网站名称对应的标签，不存在时返回-1
+    int find(const std::string &site_name) const
+    {
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            if (names[i] == site_name)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    // 由域名得到网站名称(标签和pcap目录名使用的名称)：www.baidu.com -> baidu，即倒数第二段
+    static std::string site_name_from_domain(const std::string &domain)
+    {
+        std::vector<std::string> parts;
+        std::istringstream iss(domain);
+        std::string part;
+        while (std::getline(iss, part, '.'))
+        {
+            parts.emplace_back(part);
+        }
+        if (parts.size() >= 2)
+            return parts[parts.size() - 2];
+
+        LOG_WARN << "Invalid domain format: " << domain;
+        return domain;
+    }
+};
+
+#endif // _LABEL_MAP_HPP_
@@ -0,0 +1,209 @@
+/*
+Logger为分级的缓冲日志：调用方只把格式化好的一行追加到内存缓冲区(短暂加锁，不做任何I/O)，
+后台线程每100ms把缓冲区一次性写到stdout(DEBUG/INFO)或stderr(WARN/ERROR)。
+缓冲区超过上限时丢弃新的日志并计数，不会阻塞热路径；程序退出或调用flush()时写出剩余内容。
+级别低于当前级别的日志在格式化之前就被跳过，默认级别为INFO，可用环境变量TLS_LOG_LEVEL(debug/info/warn/error)修改。
+ERROR日志不在热路径上，且之后往往紧跟调用方的直接输出，因此写入后立即flush。
+
+逐文件、逐会话或逐样本产生的日志(解析、pcap解码、mmap、目录扫描、解析缓存、数据集和分片读写、会话分离、
+HTTPS采集、流水线、预测服务、标签映射)都经过Logger，这些模块的顶层操作(如Parser::parse_all_files、
+DirectoryScanner::scan_pcaps、ShardedDataset::open)返回前调用flush()，
+保证其日志先于调用方随后的直接输出。交互菜单、抓包控制、训练进度和预测结果等每个阶段只输出几行且与
+std::cin的提示交替出现的内容仍直接写std::cout/std::cerr，不经过缓冲。
+
+用法：LOG_INFO << "Parsed " << n << " TLS records from " << path;   输出 [INFO] Parsed ...
+*/
+#ifndef _LOGGER_HPP_
+#define _LOGGER_HPP_
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+
+#include "Metrics.hpp"
+
+enum class LogLevel
+{
+    DEBUG = 0,
+    INFO = 1,
+    WARN = 2,
+    ERROR = 3
+};
+
+class Logger
+{
+private:
+    static const size_t MAX_PENDING = 8 << 20; // 缓冲区上限(字节)
+    static const int FLUSH_INTERVAL_MS = 100;
+
+    std::atomic<int> level{static_cast<int>(LogLevel::INFO)};
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::string pending_out, pending_err; // 待写入stdout/stderr的内容
+    std::mutex io_mutex;                  // 保证后台线程和flush()的写出顺序
+    std::thread flusher;
+    bool stopping = false;
+    uint64_t dropped = 0;
+    Counter &dropped_counter;
+
+    Logger()
+        : dropped_counter(MetricsRegistry::instance()->counter("tls_log_dropped_total", "Log lines dropped because the log buffer was full"))
+    {
+        if (const char *env = std::getenv("TLS_LOG_LEVEL"))
+        {
+            std::string_view name(env);
+            if (name == "debug")
+                set_level(LogLevel::DEBUG);
+            else if (name == "warn")
+                set_level(LogLevel::WARN);
+            else if (name == "error")
+                set_level(LogLevel::ERROR);
+        }
+    }
+
+public:
+    static Logger *instance()
+    {
+        static Logger logger;
+        return &logger;
+    }
+
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    ~Logger()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (flusher.joinable())
+            flusher.join();
+        flush();
+    }
+
+    void set_level(LogLevel l) { level.store(static_cast<int>(l), std::memory_order_relaxed); }
+
+    bool enabled(LogLevel l) const { return static_cast<int>(l) >= level.load(std::memory_order_relaxed); }
+
+    // 追加一行日志(自动加上级别前缀和换行)，缓冲区已满时丢弃
+    void write(LogLevel l, std::string_view message)
+    {
+        write_pending(l >= LogLevel::WARN ? pending_err : pending_out, tag(l), message);
+        if (l == LogLevel::ERROR)
+            flush();
+    }
+
+    // 追加一行程序输出(如分类结果)到stdout，不加级别前缀，不受日志级别影响
+    void print(std::string_view line)
+    {
+        write_pending(pending_out, "", line);
+    }
+
+    // 立即写出缓冲区中的所有日志，用于在直接输出到std::cout之前保持先后顺序
+    void flush()
+    {
+        std::lock_guard<std::mutex> io_lock(io_mutex);
+        std::string out, err;
+        uint64_t lost = 0;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            out.swap(pending_out);
+            err.swap(pending_err);
+            std::swap(lost, dropped);
+        }
+        if (!out.empty())
+            std::cout.write(out.data(), static_cast<std::streamsize>(out.size())).flush();
+        if (!err.empty())
+            std::cerr.write(err.data(), static_cast<std::streamsize>(err.size())).flush();
+        if (lost > 0)
+            std::cerr << "[WARN] Log buffer full, dropped " << lost << " lines" << std::endl;
+    }
+
+private:
+    void write_pending(std::string &pending, const char *prefix, std::string_view line)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (pending_out.size() + pending_err.size() + line.size() > MAX_PENDING)
+        {
+            dropped++;
+            dropped_counter.add();
+            return;
+        }
+        pending.append(prefix).append(line).push_back('\n');
+        if (!flusher.joinable() && !stopping)
+            flusher = std::thread(&Logger::run, this);
+    }
+
+    static const char *tag(LogLevel l)
+    {
+        switch (l)
+        {
+        case LogLevel::DEBUG:
+            return "[DEBUG] ";
+        case LogLevel::INFO:
+            return "[INFO] ";
+        case LogLevel::WARN:
+            return "[WARN] ";
+        default:
+            return "[ERROR] ";
+        }
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (!stopping)
+        {
+            cv.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this]
+                        { return stopping; });
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+};
+
+// 一条日志的格式化缓冲，析构时交给Logger
+class LogMessage
+{
+private:
+    LogLevel level;
+    std::ostringstream oss;
+
+public:
+    explicit LogMessage(LogLevel level) : level(level) {}
+    ~LogMessage() { Logger::instance()->write(level, oss.str()); }
+
+    template <typename T>
+    LogMessage &operator<<(const T &value)
+    {
+        oss << value;
+        return *this;
+    }
+};
+
+// 把LOG_AT的两个分支统一为void，使整个宏是一个表达式：if (verbose) LOG_INFO << ...; 不会产生悬空的else
+struct LogVoidify
+{
+    void operator&(const LogMessage &) const {}
+};
+
+// 级别未启用时既不构造LogMessage，也不求值<<右侧的参数
+#define LOG_AT(level) !Logger::instance()->enabled(level) ? (void)0 : LogVoidify() & LogMessage(level)
+
+#define LOG_DEBUG LOG_AT(LogLevel::DEBUG)
+#define LOG_INFO LOG_AT(LogLevel::INFO)
+#define LOG_WARN LOG_AT(LogLevel::WARN)
+#define LOG_ERROR LOG_AT(LogLevel::ERROR)
+
+#endif // _LOGGER_HPP_
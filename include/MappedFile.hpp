@@ -0,0 +1,117 @@
+/*
+MappedFile以只读方式将整个文件mmap到内存中，供pcap等大文件按顺序原地遍历，避免读入缓冲区的拷贝。
+*/
+#ifndef _MAPPED_FILE_HPP_
+#define _MAPPED_FILE_HPP_
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Logger.hpp"
+
+class MappedFile
+{
+private:
+    void *addr = nullptr;
+    size_t length = 0;
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &other) = delete;
+    MappedFile &operator=(const MappedFile &other) = delete;
+
+    MappedFile(MappedFile &&other) noexcept : addr(other.addr), length(other.length)
+    {
+        other.addr = nullptr;
+        other.length = 0;
+    }
+
+    MappedFile &operator=(MappedFile &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            addr = other.addr;
+            length = other.length;
+            other.addr = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    /*
+    @brief 映射文件
+    @param sequential 是否提示内核按顺序预读(MADV_SEQUENTIAL)
+    */
+    bool open(const std::string &file_path, bool sequential = true)
+    {
+        close();
+
+        int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            LOG_ERROR << "Failed to open file: " << file_path << " - " << strerror(errno);
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            LOG_ERROR << "Failed to stat file: " << file_path << " - " << strerror(errno);
+            ::close(fd);
+            return false;
+        }
+
+        length = static_cast<size_t>(st.st_size);
+        if (length == 0) // 空文件无法mmap，视为长度为0的有效映射
+        {
+            ::close(fd);
+            return true;
+        }
+
+        addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // 映射建立后即可关闭fd
+        if (addr == MAP_FAILED)
+        {
+            LOG_ERROR << "Failed to mmap file: " << file_path << " - " << strerror(errno);
+            addr = nullptr;
+            length = 0;
+            return false;
+        }
+
+        if (sequential)
+            madvise(addr, length, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    void close()
+    {
+        if (addr)
+        {
+            munmap(addr, length);
+            addr = nullptr;
+        }
+        length = 0;
+    }
+
+    std::string_view data() const
+    {
+        return std::string_view(static_cast<const char *>(addr), length);
+    }
+
+    size_t size() const { return length; }
+};
+
+#endif // _MAPPED_FILE_HPP_
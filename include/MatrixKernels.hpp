@@ -0,0 +1,570 @@
+/*
+MatrixKernels提供全连接层使用的矩阵存储和计算内核：
+    AlignedMatrix  行主序、64字节对齐的连续存储，每行的跨度(stride)补齐到16个float(一个AVX-512寄存器/一条缓存行)
+    gemv           y = W * x + b
+    gemm_nt        C = A * W^T + b，A为[batch x cols]，一次处理W的4行，W的行块在缓存中被整个batch复用
+    gemm_tn_acc    dW += G^T * X，批量反向传播中累加权重梯度
+    gemm_nn        dX = G * W，批量反向传播中计算输入梯度
+    axpy           y += a * x，上述两个内核和权重更新的基本操作
+x86上在运行时通过__builtin_cpu_supports选择AVX-512/AVX2/标量实现(函数用target属性单独编译，不需要全局-mavx2)；
+AArch64上使用NEON。
+*/
+#ifndef _MATRIX_KERNELS_HPP_
+#define _MATRIX_KERNELS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TLS_KERNELS_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TLS_KERNELS_NEON 1
+#endif
+
+// 64字节对齐的float缓冲区，新分配的内存全部置零(补齐部分必须为0，内核会按完整跨度读取权重行)
+class AlignedBuffer
+{
+private:
+    static constexpr std::align_val_t ALIGNMENT{64};
+
+    float *ptr = nullptr;
+    size_t count = 0;
+
+public:
+    AlignedBuffer() = default;
+    explicit AlignedBuffer(size_t n) { resize(n); }
+
+    AlignedBuffer(const AlignedBuffer &other)
+    {
+        resize(other.count);
+        if (count > 0)
+            std::memcpy(ptr, other.ptr, count * sizeof(float));
+    }
+
+    AlignedBuffer &operator=(const AlignedBuffer &other)
+    {
+        if (this != &other)
+        {
+            resize(other.count);
+            if (count > 0)
+                std::memcpy(ptr, other.ptr, count * sizeof(float));
+        }
+        return *this;
+    }
+
+    AlignedBuffer(AlignedBuffer &&other) noexcept : ptr(other.ptr), count(other.count)
+    {
+        other.ptr = nullptr;
+        other.count = 0;
+    }
+
+    AlignedBuffer &operator=(AlignedBuffer &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            ptr = other.ptr;
+            count = other.count;
+            other.ptr = nullptr;
+            other.count = 0;
+        }
+        return *this;
+    }
+
+    ~AlignedBuffer() { release(); }
+
+    void resize(size_t n)
+    {
+        if (n == count)
+            return;
+        release();
+        if (n > 0)
+        {
+            ptr = static_cast<float *>(::operator new(n * sizeof(float), ALIGNMENT));
+            std::memset(ptr, 0, n * sizeof(float));
+            count = n;
+        }
+    }
+
+    float *data() { return ptr; }
+    const float *data() const { return ptr; }
+    size_t size() const { return count; }
+    float &operator[](size_t i) { return ptr[i]; }
+    const float &operator[](size_t i) const { return ptr[i]; }
+
+private:
+    void release()
+    {
+        if (ptr)
+            ::operator delete(ptr, ALIGNMENT);
+        ptr = nullptr;
+        count = 0;
+    }
+};
+
+// 行主序矩阵，行跨度补齐到SIMD宽度，每行的起始地址都是64字节对齐的
+class AlignedMatrix
+{
+public:
+    static constexpr size_t STRIDE_ALIGN = 16; // 16个float = 64字节
+
+private:
+    size_t num_rows = 0;
+    size_t num_cols = 0;
+    size_t row_stride = 0;
+    AlignedBuffer buffer;
+
+public:
+    AlignedMatrix() = default;
+    AlignedMatrix(size_t rows, size_t cols) { resize(rows, cols); }
+
+    static size_t padded(size_t cols) { return (cols + STRIDE_ALIGN - 1) / STRIDE_ALIGN * STRIDE_ALIGN; }
+
+    void resize(size_t rows, size_t cols)
+    {
+        num_rows = rows;
+        num_cols = cols;
+        row_stride = padded(cols);
+        buffer.resize(num_rows * row_stride);
+    }
+
+    size_t rows() const { return num_rows; }
+    size_t cols() const { return num_cols; }
+    size_t stride() const { return row_stride; }
+
+    float *data() { return buffer.data(); }
+    const float *data() const { return buffer.data(); }
+    float *row(size_t r) { return buffer.data() + r * row_stride; }
+    const float *row(size_t r) const { return buffer.data() + r * row_stride; }
+    float &at(size_t r, size_t c) { return buffer[r * row_stride + c]; }
+    float at(size_t r, size_t c) const { return buffer[r * row_stride + c]; }
+};
+
+namespace kernels
+{
+    enum class Isa
+    {
+        SCALAR,
+        AVX2,
+        AVX512,
+        NEON
+    };
+
+    inline const char *isa_name(Isa isa)
+    {
+        switch (isa)
+        {
+        case Isa::AVX2:
+            return "AVX2";
+        case Isa::AVX512:
+            return "AVX-512";
+        case Isa::NEON:
+            return "NEON";
+        default:
+            return "scalar";
+        }
+    }
+
+    // 4行点积：out[r] = dot(w + r * stride, x, n)，x被4行共享，每次加载只读一次
+    using Dot4Fn = void (*)(const float *w, size_t stride, const float *x, size_t n, float *out);
+    using DotFn = float (*)(const float *w, const float *x, size_t n);
+    using AxpyFn = void (*)(float a, const float *x, float *y, size_t n);
+
+    // ---------------- 标量实现(可被编译器自动向量化) ----------------
+
+    inline float dot_scalar(const float *w, const float *x, size_t n)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; ++i)
+            sum += w[i] * x[i];
+        return sum;
+    }
+
+    inline void dot4_scalar(const float *w, size_t stride, const float *x, size_t n, float *out)
+    {
+        float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+        const float *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+        for (size_t i = 0; i < n; ++i)
+        {
+            float xi = x[i];
+            s0 += w0[i] * xi;
+            s1 += w1[i] * xi;
+            s2 += w2[i] * xi;
+            s3 += w3[i] * xi;
+        }
+        out[0] = s0;
+        out[1] = s1;
+        out[2] = s2;
+        out[3] = s3;
+    }
+
+    inline void axpy_scalar(float a, const float *x, float *y, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            y[i] += a * x[i];
+    }
+
+#if defined(TLS_KERNELS_X86)
+    // ---------------- AVX2 + FMA ----------------
+
+    __attribute__((target("avx2,fma"))) inline float hsum256(__m256 v)
+    {
+        __m128 lo = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+        lo = _mm_add_ss(lo, _mm_movehdup_ps(lo));
+        return _mm_cvtss_f32(lo);
+    }
+
+    __attribute__((target("avx2,fma"))) inline float dot_avx2(const float *w, const float *x, size_t n)
+    {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(w + i), _mm256_loadu_ps(x + i), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(w + i + 8), _mm256_loadu_ps(x + i + 8), acc1);
+        }
+        for (; i + 8 <= n; i += 8)
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(w + i), _mm256_loadu_ps(x + i), acc0);
+        float sum = hsum256(_mm256_add_ps(acc0, acc1));
+        for (; i < n; ++i)
+            sum += w[i] * x[i];
+        return sum;
+    }
+
+    __attribute__((target("avx2,fma"))) inline void dot4_avx2(const float *w, size_t stride, const float *x, size_t n, float *out)
+    {
+        const float *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+        __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps(), a2 = _mm256_setzero_ps(), a3 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 xv = _mm256_loadu_ps(x + i);
+            a0 = _mm256_fmadd_ps(_mm256_load_ps(w0 + i), xv, a0);
+            a1 = _mm256_fmadd_ps(_mm256_load_ps(w1 + i), xv, a1);
+            a2 = _mm256_fmadd_ps(_mm256_load_ps(w2 + i), xv, a2);
+            a3 = _mm256_fmadd_ps(_mm256_load_ps(w3 + i), xv, a3);
+        }
+        float s0 = hsum256(a0), s1 = hsum256(a1), s2 = hsum256(a2), s3 = hsum256(a3);
+        for (; i < n; ++i)
+        {
+            s0 += w0[i] * x[i];
+            s1 += w1[i] * x[i];
+            s2 += w2[i] * x[i];
+            s3 += w3[i] * x[i];
+        }
+        out[0] = s0;
+        out[1] = s1;
+        out[2] = s2;
+        out[3] = s3;
+    }
+
+    __attribute__((target("avx2,fma"))) inline void axpy_avx2(float a, const float *x, float *y, size_t n)
+    {
+        __m256 av = _mm256_set1_ps(a);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(y + i, _mm256_fmadd_ps(av, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+        for (; i < n; ++i)
+            y[i] += a * x[i];
+    }
+
+    // ---------------- AVX-512F ----------------
+
+    // 16个float求和。GCC 12的_mm512_reduce_add_ps和_mm512_castps512_ps256以_mm256_undefined_ps()作为直通操作数，
+    // -Wall下会误报'__Y'未初始化；这里用全1掩码的maskz形式取出高低256位(生成的指令相同)，再用hsum256求和
+    __attribute__((target("avx512f"))) inline float hsum512(__m512 v)
+    {
+        __m512d d = _mm512_castps_pd(v);
+        __m256 lo = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, d, 0));
+        __m256 hi = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, d, 1));
+        return hsum256(_mm256_add_ps(lo, hi));
+    }
+
+    __attribute__((target("avx512f"))) inline float dot_avx512(const float *w, const float *x, size_t n)
+    {
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(w + i), _mm512_loadu_ps(x + i), acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(w + i + 16), _mm512_loadu_ps(x + i + 16), acc1);
+        }
+        for (; i + 16 <= n; i += 16)
+            acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(w + i), _mm512_loadu_ps(x + i), acc0);
+        if (i < n) // 尾部用掩码加载，不会越界读取
+        {
+            __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+            acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, w + i), _mm512_maskz_loadu_ps(mask, x + i), acc1);
+        }
+        return hsum512(_mm512_add_ps(acc0, acc1));
+    }
+
+    __attribute__((target("avx512f"))) inline void dot4_avx512(const float *w, size_t stride, const float *x, size_t n, float *out)
+    {
+        const float *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+        __m512 a0 = _mm512_setzero_ps(), a1 = _mm512_setzero_ps(), a2 = _mm512_setzero_ps(), a3 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512 xv = _mm512_loadu_ps(x + i);
+            a0 = _mm512_fmadd_ps(_mm512_load_ps(w0 + i), xv, a0);
+            a1 = _mm512_fmadd_ps(_mm512_load_ps(w1 + i), xv, a1);
+            a2 = _mm512_fmadd_ps(_mm512_load_ps(w2 + i), xv, a2);
+            a3 = _mm512_fmadd_ps(_mm512_load_ps(w3 + i), xv, a3);
+        }
+        if (i < n)
+        {
+            __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+            __m512 xv = _mm512_maskz_loadu_ps(mask, x + i);
+            a0 = _mm512_fmadd_ps(_mm512_maskz_load_ps(mask, w0 + i), xv, a0);
+            a1 = _mm512_fmadd_ps(_mm512_maskz_load_ps(mask, w1 + i), xv, a1);
+            a2 = _mm512_fmadd_ps(_mm512_maskz_load_ps(mask, w2 + i), xv, a2);
+            a3 = _mm512_fmadd_ps(_mm512_maskz_load_ps(mask, w3 + i), xv, a3);
+        }
+        out[0] = hsum512(a0);
+        out[1] = hsum512(a1);
+        out[2] = hsum512(a2);
+        out[3] = hsum512(a3);
+    }
+
+    __attribute__((target("avx512f"))) inline void axpy_avx512(float a, const float *x, float *y, size_t n)
+    {
+        __m512 av = _mm512_set1_ps(a);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+            _mm512_storeu_ps(y + i, _mm512_fmadd_ps(av, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+        if (i < n)
+        {
+            __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+            __m512 yv = _mm512_maskz_loadu_ps(mask, y + i);
+            _mm512_mask_storeu_ps(y + i, mask, _mm512_fmadd_ps(av, _mm512_maskz_loadu_ps(mask, x + i), yv));
+        }
+    }
+#endif
+
+#if defined(TLS_KERNELS_NEON)
+    // ---------------- NEON ----------------
+
+    inline float dot_neon(const float *w, const float *x, size_t n)
+    {
+        float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            acc0 = vfmaq_f32(acc0, vld1q_f32(w + i), vld1q_f32(x + i));
+            acc1 = vfmaq_f32(acc1, vld1q_f32(w + i + 4), vld1q_f32(x + i + 4));
+        }
+        float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+        for (; i < n; ++i)
+            sum += w[i] * x[i];
+        return sum;
+    }
+
+    inline void dot4_neon(const float *w, size_t stride, const float *x, size_t n, float *out)
+    {
+        const float *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+        float32x4_t a0 = vdupq_n_f32(0.0f), a1 = a0, a2 = a0, a3 = a0;
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            float32x4_t xv = vld1q_f32(x + i);
+            a0 = vfmaq_f32(a0, vld1q_f32(w0 + i), xv);
+            a1 = vfmaq_f32(a1, vld1q_f32(w1 + i), xv);
+            a2 = vfmaq_f32(a2, vld1q_f32(w2 + i), xv);
+            a3 = vfmaq_f32(a3, vld1q_f32(w3 + i), xv);
+        }
+        float s0 = vaddvq_f32(a0), s1 = vaddvq_f32(a1), s2 = vaddvq_f32(a2), s3 = vaddvq_f32(a3);
+        for (; i < n; ++i)
+        {
+            s0 += w0[i] * x[i];
+            s1 += w1[i] * x[i];
+            s2 += w2[i] * x[i];
+            s3 += w3[i] * x[i];
+        }
+        out[0] = s0;
+        out[1] = s1;
+        out[2] = s2;
+        out[3] = s3;
+    }
+
+    inline void axpy_neon(float a, const float *x, float *y, size_t n)
+    {
+        float32x4_t av = vdupq_n_f32(a);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            vst1q_f32(y + i, vfmaq_f32(vld1q_f32(y + i), av, vld1q_f32(x + i)));
+        for (; i < n; ++i)
+            y[i] += a * x[i];
+    }
+#endif
+
+    // 当前选用的内核，第一次使用时根据CPU特性初始化
+    struct Dispatch
+    {
+        Isa isa = Isa::SCALAR;
+        DotFn dot = dot_scalar;
+        Dot4Fn dot4 = dot4_scalar;
+        AxpyFn axpy = axpy_scalar;
+    };
+
+    inline Isa best_isa()
+    {
+#if defined(TLS_KERNELS_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return Isa::AVX512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return Isa::AVX2;
+        return Isa::SCALAR;
+#elif defined(TLS_KERNELS_NEON)
+        return Isa::NEON;
+#else
+        return Isa::SCALAR;
+#endif
+    }
+
+    inline Dispatch make_dispatch(Isa isa)
+    {
+        Dispatch d;
+        switch (isa)
+        {
+#if defined(TLS_KERNELS_X86)
+        case Isa::AVX512:
+            d = Dispatch{Isa::AVX512, dot_avx512, dot4_avx512, axpy_avx512};
+            break;
+        case Isa::AVX2:
+            d = Dispatch{Isa::AVX2, dot_avx2, dot4_avx2, axpy_avx2};
+            break;
+#endif
+#if defined(TLS_KERNELS_NEON)
+        case Isa::NEON:
+            d = Dispatch{Isa::NEON, dot_neon, dot4_neon, axpy_neon};
+            break;
+#endif
+        default:
+            break;
+        }
+        return d;
+    }
+
+    inline Dispatch &dispatch()
+    {
+        static Dispatch d = make_dispatch(best_isa());
+        return d;
+    }
+
+    // 强制使用指定的指令集(用于基准测试和对比结果)，CPU不支持时退回标量实现
+    inline void force_isa(Isa isa)
+    {
+        Isa best = best_isa();
+        bool supported = isa == Isa::SCALAR || isa == best || (isa == Isa::AVX2 && best == Isa::AVX512);
+        dispatch() = make_dispatch(supported ? isa : Isa::SCALAR);
+    }
+
+    inline Isa current_isa() { return dispatch().isa; }
+
+    inline float dot(const float *w, const float *x, size_t n) { return dispatch().dot(w, x, n); }
+    inline void axpy(float a, const float *x, float *y, size_t n) { dispatch().axpy(a, x, y, n); }
+
+    // y = W * x + bias(bias可为nullptr)
+    inline void gemv(const AlignedMatrix &w, const float *x, const float *bias, float *y)
+    {
+        const Dispatch &d = dispatch();
+        size_t rows = w.rows(), cols = w.cols(), stride = w.stride();
+        size_t r = 0;
+        for (; r + 4 <= rows; r += 4)
+            d.dot4(w.row(r), stride, x, cols, y + r);
+        for (; r < rows; ++r)
+            y[r] = d.dot(w.row(r), x, cols);
+        if (bias)
+        {
+            for (size_t o = 0; o < rows; ++o)
+                y[o] += bias[o];
+        }
+    }
+
+    /*
+    @brief C = A * W^T + bias
+    @param a    batch行输入，第b行起始于 a + b * a_stride，长度为W.cols()
+    @param c    batch行输出，第b行起始于 c + b * c_stride，长度为W.rows()
+    W按4行一块遍历，每块在缓存中对整个batch复用，相比逐样本gemv大幅减少权重的内存读取
+    */
+    inline void gemm_nt(const float *a, size_t a_stride, size_t batch, const AlignedMatrix &w, const float *bias,
+                        float *c, size_t c_stride)
+    {
+        const Dispatch &d = dispatch();
+        size_t rows = w.rows(), cols = w.cols(), stride = w.stride();
+        size_t r = 0;
+        for (; r + 4 <= rows; r += 4)
+        {
+            for (size_t b = 0; b < batch; ++b)
+                d.dot4(w.row(r), stride, a + b * a_stride, cols, c + b * c_stride + r);
+        }
+        for (; r < rows; ++r)
+        {
+            for (size_t b = 0; b < batch; ++b)
+                c[b * c_stride + r] = d.dot(w.row(r), a + b * a_stride, cols);
+        }
+        if (bias)
+        {
+            for (size_t b = 0; b < batch; ++b)
+            {
+                for (size_t o = 0; o < rows; ++o)
+                    c[b * c_stride + o] += bias[o];
+            }
+        }
+    }
+
+    /*
+    @brief dW += G^T * X
+    @param g  batch行梯度，第b行起始于 g + b * g_stride，长度为dW.rows()
+    @param x  batch行输入，第b行起始于 x + b * x_stride，长度为dW.cols()
+    外层按dW的行遍历，同一行在整个batch上累加时始终留在缓存中
+    */
+    inline void gemm_tn_acc(const float *g, size_t g_stride, const float *x, size_t x_stride, size_t batch,
+                            AlignedMatrix &dw)
+    {
+        const Dispatch &d = dispatch();
+        size_t rows = dw.rows(), cols = dw.cols();
+        for (size_t o = 0; o < rows; ++o)
+        {
+            float *dw_row = dw.row(o);
+            for (size_t b = 0; b < batch; ++b)
+            {
+                float go = g[b * g_stride + o];
+                if (go != 0.0f) // 被跳过的样本和ReLU截断的位置梯度为0
+                    d.axpy(go, x + b * x_stride, dw_row, cols);
+            }
+        }
+    }
+
+    /*
+    @brief dX = G * W
+    @param g   batch行梯度，长度为W.rows()
+    @param dx  batch行输出，长度为W.cols()
+    */
+    inline void gemm_nn(const float *g, size_t g_stride, size_t batch, const AlignedMatrix &w, float *dx, size_t dx_stride)
+    {
+        const Dispatch &d = dispatch();
+        size_t rows = w.rows(), cols = w.cols();
+        for (size_t b = 0; b < batch; ++b)
+        {
+            float *dx_row = dx + b * dx_stride;
+            std::fill(dx_row, dx_row + cols, 0.0f);
+            for (size_t o = 0; o < rows; ++o)
+            {
+                float go = g[b * g_stride + o];
+                if (go != 0.0f)
+                    d.axpy(go, w.row(o), dx_row, cols);
+            }
+        }
+    }
+}
+
+#endif // _MATRIX_KERNELS_HPP_
@@ -0,0 +1,500 @@
+/*
+Metrics为热路径上的轻量指标：计数器、仪表和延迟直方图，以及两种导出方式：
+    - Prometheus文本格式的HTTP端点(GET /metrics，GET /metrics.json 返回JSON)
+    - 定期把JSON快照写入文件(先写临时文件再rename，读取方不会看到写了一半的文件)
+计数器和直方图按线程分片，每个分片独占一个缓存行，更新只是一次relaxed原子加，线程之间不共享缓存行；
+读取(导出)时才把所有分片相加。指标对象由MetricsRegistry持有，地址在进程内不变，
+调用方应在初始化时取一次引用(通常是函数内的static引用)，热路径上不再按名称查找。
+*/
+#ifndef _METRICS_HPP_
+#define _METRICS_HPP_
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 当前线程使用的分片编号，线程第一次更新指标时按轮转分配
+inline size_t metric_shard()
+{
+    static std::atomic<size_t> next_shard{0};
+    thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed);
+    return shard;
+}
+
+// 单调递增的计数器
+class Counter
+{
+public:
+    static const size_t SHARDS = 16;
+
+private:
+    struct alignas(64) Cell
+    {
+        std::atomic<uint64_t> value{0};
+    };
+    Cell cells[SHARDS];
+
+public:
+    void add(uint64_t n = 1)
+    {
+        cells[metric_shard() % SHARDS].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const
+    {
+        uint64_t sum = 0;
+        for (const Cell &cell : cells)
+            sum += cell.value.load(std::memory_order_relaxed);
+        return sum;
+    }
+};
+
+// 可增可减的当前值(队列长度、活跃流数等)，更新频率低，不分片
+class Gauge
+{
+private:
+    std::atomic<int64_t> current{0};
+
+public:
+    void set(int64_t v) { current.store(v, std::memory_order_relaxed); }
+    void add(int64_t n) { current.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return current.load(std::memory_order_relaxed); }
+};
+
+/*
+延迟直方图：第i个桶的上界为2^i微秒(1us ~ 2^25us≈33s)，最后一个桶为+Inf。
+分位数取所在桶的上界，精度为2倍，足以判断延迟的量级和长尾。
+*/
+class Histogram
+{
+public:
+    static const size_t BUCKETS = 27; // 26个有限上界 + Inf
+    static const size_t SHARDS = 8;
+
+    struct Snapshot
+    {
+        uint64_t counts[BUCKETS]{};
+        uint64_t count = 0;
+        double sum = 0.0; // 秒
+
+        // 分位数q(0~1)的估计值(秒)，没有样本时返回0
+        double quantile(double q) const
+        {
+            if (count == 0)
+                return 0.0;
+            uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i + 1 < BUCKETS; ++i)
+            {
+                cumulative += counts[i];
+                if (cumulative >= rank)
+                    return upper_bound(i);
+            }
+            return upper_bound(BUCKETS - 2);
+        }
+    };
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> counts[BUCKETS]{};
+        std::atomic<uint64_t> sum_ns{0};
+    };
+    Shard shards[SHARDS];
+
+public:
+    void observe_ns(uint64_t ns)
+    {
+        uint64_t us = (ns + 999) / 1000;
+        size_t bucket = us <= 1 ? 0 : std::min<size_t>(std::bit_width(us - 1), BUCKETS - 1);
+        Shard &shard = shards[metric_shard() % SHARDS];
+        shard.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+        shard.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void observe(std::chrono::steady_clock::duration elapsed)
+    {
+        observe_ns(static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count())));
+    }
+
+    void observe_seconds(double seconds)
+    {
+        observe_ns(static_cast<uint64_t>(std::max(0.0, seconds) * 1e9));
+    }
+
+    Snapshot snapshot() const
+    {
+        Snapshot s;
+        uint64_t sum_ns = 0;
+        for (const Shard &shard : shards)
+        {
+            for (size_t i = 0; i < BUCKETS; ++i)
+                s.counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+            sum_ns += shard.sum_ns.load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < BUCKETS; ++i)
+            s.count += s.counts[i];
+        s.sum = sum_ns / 1e9;
+        return s;
+    }
+
+    // 第i个桶的上界(秒)
+    static double upper_bound(size_t i) { return static_cast<double>(uint64_t(1) << i) / 1e6; }
+};
+
+// 作用域计时：析构时把经过的时间记入直方图
+class ScopedTimer
+{
+private:
+    Histogram &histogram;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ScopedTimer(Histogram &histogram) : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { histogram.observe(std::chrono::steady_clock::now() - start); }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+};
+
+/*
+全局指标注册表。指标由 名称 + 标签 唯一确定，labels为Prometheus格式的标签列表(如 kind="open")，
+同名指标共享HELP/TYPE说明。重复注册返回同一个对象。
+*/
+class MetricsRegistry
+{
+private:
+    template <typename Metric>
+    struct Family
+    {
+        std::string help;
+        std::map<std::string, std::unique_ptr<Metric>> series; // 标签 -> 指标
+    };
+
+    std::mutex mtx;
+    std::map<std::string, Family<Counter>> counters;
+    std::map<std::string, Family<Gauge>> gauges;
+    std::map<std::string, Family<Histogram>> histograms;
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+    MetricsRegistry() = default;
+
+public:
+    static MetricsRegistry *instance()
+    {
+        static MetricsRegistry registry;
+        return &registry;
+    }
+
+    MetricsRegistry(const MetricsRegistry &) = delete;
+    MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+
+    Counter &counter(const std::string &name, const std::string &help, const std::string &labels = "")
+    {
+        return get(counters, name, help, labels);
+    }
+
+    Gauge &gauge(const std::string &name, const std::string &help, const std::string &labels = "")
+    {
+        return get(gauges, name, help, labels);
+    }
+
+    Histogram &histogram(const std::string &name, const std::string &help, const std::string &labels = "")
+    {
+        return get(histograms, name, help, labels);
+    }
+
+    // Prometheus文本格式(version 0.0.4)
+    std::string to_prometheus()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::ostringstream oss;
+        oss.precision(10);
+        for (const auto &[name, family] : counters)
+        {
+            oss << "# HELP " << name << " " << family.help << "\n# TYPE " << name << " counter\n";
+            for (const auto &[labels, metric] : family.series)
+                oss << name << braced(labels) << " " << metric->value() << "\n";
+        }
+        for (const auto &[name, family] : gauges)
+        {
+            oss << "# HELP " << name << " " << family.help << "\n# TYPE " << name << " gauge\n";
+            for (const auto &[labels, metric] : family.series)
+                oss << name << braced(labels) << " " << metric->value() << "\n";
+        }
+        for (const auto &[name, family] : histograms)
+        {
+            oss << "# HELP " << name << " " << family.help << "\n# TYPE " << name << " histogram\n";
+            for (const auto &[labels, metric] : family.series)
+            {
+                Histogram::Snapshot s = metric->snapshot();
+                std::string prefix = labels.empty() ? "" : labels + ",";
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i + 1 < Histogram::BUCKETS; ++i)
+                {
+                    cumulative += s.counts[i];
+                    oss << name << "_bucket{" << prefix << "le=\"" << Histogram::upper_bound(i) << "\"} " << cumulative << "\n";
+                }
+                oss << name << "_bucket{" << prefix << "le=\"+Inf\"} " << s.count << "\n";
+                oss << name << "_sum" << braced(labels) << " " << s.sum << "\n";
+                oss << name << "_count" << braced(labels) << " " << s.count << "\n";
+            }
+        }
+        return oss.str();
+    }
+
+    // JSON快照：计数器和仪表为数值，直方图给出count/sum和p50/p90/p99(秒)
+    std::string to_json()
+    {
+        double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        long long now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count();
+
+        std::lock_guard<std::mutex> lock(mtx);
+        std::ostringstream oss;
+        oss.precision(10);
+        oss << "{\"timestamp_ms\":" << now_ms << ",\"uptime_seconds\":" << uptime;
+
+        auto write_scalars = [&oss](const char *section, const auto &families)
+        {
+            oss << ",\"" << section << "\":{";
+            bool first = true;
+            for (const auto &[name, family] : families)
+            {
+                for (const auto &[labels, metric] : family.series)
+                {
+                    oss << (first ? "" : ",") << "\"" << json_escape(name + braced(labels)) << "\":" << metric->value();
+                    first = false;
+                }
+            }
+            oss << "}";
+        };
+        write_scalars("counters", counters);
+        write_scalars("gauges", gauges);
+
+        oss << ",\"histograms\":{";
+        bool first = true;
+        for (const auto &[name, family] : histograms)
+        {
+            for (const auto &[labels, metric] : family.series)
+            {
+                Histogram::Snapshot s = metric->snapshot();
+                oss << (first ? "" : ",") << "\"" << json_escape(name + braced(labels)) << "\":{\"count\":" << s.count
+                    << ",\"sum\":" << s.sum << ",\"p50\":" << s.quantile(0.5) << ",\"p90\":" << s.quantile(0.9)
+                    << ",\"p99\":" << s.quantile(0.99) << "}";
+                first = false;
+            }
+        }
+        oss << "}}\n";
+        return oss.str();
+    }
+
+    // 原子地写入JSON快照
+    bool write_json(const std::string &path)
+    {
+        std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream ofs(tmp_path, std::ios::trunc);
+            if (!ofs.is_open())
+                return false;
+            ofs << to_json();
+            if (!ofs)
+                return false;
+        }
+        return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    template <typename Metric>
+    Metric &get(std::map<std::string, Family<Metric>> &families, const std::string &name, const std::string &help,
+                const std::string &labels)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        Family<Metric> &family = families[name];
+        if (family.help.empty())
+            family.help = help;
+        std::unique_ptr<Metric> &metric = family.series[labels];
+        if (!metric)
+            metric = std::make_unique<Metric>();
+        return *metric;
+    }
+
+    static std::string braced(const std::string &labels)
+    {
+        return labels.empty() ? "" : "{" + labels + "}";
+    }
+
+    static std::string json_escape(const std::string &s)
+    {
+        std::string out;
+        out.reserve(s.size());
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out;
+    }
+};
+
+/*
+MetricsExporter在后台线程中导出MetricsRegistry：
+    start_json  每隔interval_ms把JSON快照写入path，停止时再写一次最终结果
+    start_http  在127.0.0.1:port上提供 /metrics(Prometheus) 和 /metrics.json
+析构时停止所有后台线程。
+*/
+class MetricsExporter
+{
+private:
+    std::atomic<bool> stopping{false};
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread json_thread;
+    std::thread http_thread;
+    int listen_fd = -1;
+
+public:
+    MetricsExporter() = default;
+    MetricsExporter(const MetricsExporter &) = delete;
+    MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+    ~MetricsExporter() { stop(); }
+
+    void start_json(const std::string &path, int interval_ms = 1000)
+    {
+        json_thread = std::thread([this, path, interval_ms]
+                                  {
+            std::unique_lock<std::mutex> lock(mtx);
+            while (!stopping)
+            {
+                cv.wait_for(lock, std::chrono::milliseconds(interval_ms), [this] { return stopping.load(); });
+                lock.unlock();
+                if (!MetricsRegistry::instance()->write_json(path))
+                    std::cerr << "[WARN] Failed to write metrics to " << path << std::endl;
+                lock.lock();
+            } });
+        std::cout << "[INFO] Writing metrics to " << path << " every " << interval_ms << "ms" << std::endl;
+    }
+
+    bool start_http(int port)
+    {
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0)
+        {
+            std::cerr << "[ERROR] Failed to create metrics socket: " << strerror(errno) << std::endl;
+            return false;
+        }
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listen_fd, 16) != 0)
+        {
+            std::cerr << "[ERROR] Failed to listen on metrics port " << port << ": " << strerror(errno) << std::endl;
+            close(listen_fd);
+            listen_fd = -1;
+            return false;
+        }
+        http_thread = std::thread(&MetricsExporter::serve, this);
+        std::cout << "[INFO] Serving metrics on http://127.0.0.1:" << port << "/metrics" << std::endl;
+        return true;
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (json_thread.joinable())
+            json_thread.join();
+        if (http_thread.joinable())
+            http_thread.join();
+        if (listen_fd >= 0)
+        {
+            close(listen_fd);
+            listen_fd = -1;
+        }
+    }
+
+private:
+    // 每次只处理一个连接，抓取频率很低，不需要并发
+    void serve()
+    {
+        pollfd pfd{listen_fd, POLLIN, 0};
+        while (!stopping)
+        {
+            if (poll(&pfd, 1, 200) <= 0 || !(pfd.revents & POLLIN))
+                continue;
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0)
+                continue;
+            timeval timeout{1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+            char request[1024];
+            ssize_t n = recv(fd, request, sizeof(request) - 1, 0);
+            if (n > 0)
+            {
+                request[n] = '\0';
+                std::string_view line(request, strcspn(request, "\r\n"));
+                std::string body, content_type = "text/plain; version=0.0.4";
+                const char *status = "200 OK";
+                if (line.starts_with("GET /metrics.json"))
+                {
+                    body = MetricsRegistry::instance()->to_json();
+                    content_type = "application/json";
+                }
+                else if (line.starts_with("GET /metrics") || line.starts_with("GET / "))
+                    body = MetricsRegistry::instance()->to_prometheus();
+                else
+                {
+                    status = "404 Not Found";
+                    body = "not found\n";
+                }
+                std::string response = std::string("HTTP/1.1 ") + status + "\r\nContent-Type: " + content_type +
+                                       "\r\nContent-Length: " + std::to_string(body.size()) +
+                                       "\r\nConnection: close\r\n\r\n" + body;
+                send_all(fd, response);
+            }
+            close(fd);
+        }
+    }
+
+    static void send_all(int fd, const std::string &data)
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                return;
+            sent += static_cast<size_t>(n);
+        }
+    }
+};
+
+#endif // _METRICS_HPP_
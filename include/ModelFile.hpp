@@ -0,0 +1,285 @@
+/*
+ModelFile为自描述的模型文件格式：除权重外还保存预处理参数(序列长度、包大小的归一化方式)和 标签 -> 网站名称 表，
+预测器只需要模型文件本身，不依赖训练数据和site_labels.csv。读取时整个文件mmap，权重按矩阵整块拷贝，不逐个float读取。
+
+文件布局(小端，各段按64字节对齐)：
+    [Header]        固定128字节，见ModelHeader
+    [Label table]   num_label_names个 { uint32 label, uint32 name_len, char name[name_len] }
+    [Layer table]   num_layers个 ModelLayerEntry
+    [Layers]        每层 weights[output_size x stride] 和 biases[output_size]，float，行跨度与AlignedMatrix一致
+checksum为Header之后所有字节的FNV-1a哈希，用于发现截断或损坏的文件。
+
+旧格式(int input_dim, int num_labels, 然后逐层的维度和权重)没有魔数，由SimpleCNN::load_model识别并兼容读取。
+*/
+#ifndef _MODEL_FILE_HPP_
+#define _MODEL_FILE_HPP_
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <cstdio>
+
+#include "MappedFile.hpp"
+#include "MatrixKernels.hpp"
+
+// 模型对输入的预处理约定，必须与训练时一致
+struct ModelMetadata
+{
+    uint32_t sequence_length = 0;  // 每个样本使用的记录数
+    uint32_t packet_features = 2;  // 每条记录的特征数(大小 + 方向)
+    uint32_t stats_features = 6;   // 序列之后的统计特征数
+    float size_log_base = 1501.0f; // 包大小归一化：log(size + 1) / log(size_log_base)
+    std::vector<std::pair<int, std::string>> labels; // 标签 -> 网站名称，可以为空
+};
+
+struct ModelHeader
+{
+    char magic[8];         // "TLSMODEL"
+    uint32_t version;      // 格式版本
+    uint32_t header_size;  // sizeof(ModelHeader)
+    uint32_t input_dim;
+    uint32_t num_labels;
+    uint32_t sequence_length;
+    uint32_t packet_features;
+    uint32_t stats_features;
+    float size_log_base;
+    uint32_t num_layers;
+    uint32_t num_label_names;
+    uint64_t label_table_offset;
+    uint64_t layer_table_offset;
+    uint64_t file_size;
+    uint64_t checksum;
+    uint8_t reserved[48];
+};
+static_assert(sizeof(ModelHeader) == 128, "ModelHeader layout changed");
+
+struct ModelLayerEntry
+{
+    uint32_t output_size;
+    uint32_t input_size;
+    uint32_t stride; // 权重矩阵的行跨度(float数)
+    uint32_t reserved;
+    uint64_t weights_offset;
+    uint64_t biases_offset;
+};
+static_assert(sizeof(ModelLayerEntry) == 32, "ModelLayerEntry layout changed");
+
+// 一层的只读视图，指针指向文件映射
+struct ModelLayerView
+{
+    int output_size;
+    int input_size;
+    size_t stride;
+    const float *weights;
+    const float *biases;
+};
+
+namespace model_format
+{
+    static constexpr char MAGIC[8] = {'T', 'L', 'S', 'M', 'O', 'D', 'E', 'L'};
+    static constexpr uint32_t VERSION = 1;
+
+    inline uint64_t align64(uint64_t v) { return (v + 63) & ~static_cast<uint64_t>(63); }
+
+    inline uint64_t checksum(const char *data, size_t length)
+    {
+        // FNV-1a
+        uint64_t h = 1469598103934665603ULL;
+        for (size_t i = 0; i < length; ++i)
+        {
+            h ^= static_cast<uint8_t>(data[i]);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    // 判断文件是否为新格式的模型(只读取魔数)
+    inline bool is_model_file(const std::string &path)
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        char magic[8] = {};
+        if (!ifs.read(magic, sizeof(magic)))
+            return false;
+        return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    }
+}
+
+class ModelFileWriter
+{
+private:
+    struct Layer
+    {
+        const AlignedMatrix *weights;
+        const std::vector<float> *biases;
+    };
+
+    uint32_t input_dim;
+    uint32_t num_labels;
+    ModelMetadata metadata;
+    std::vector<Layer> layers;
+
+public:
+    ModelFileWriter(int input_dim, int num_labels, const ModelMetadata &metadata)
+        : input_dim(static_cast<uint32_t>(input_dim)), num_labels(static_cast<uint32_t>(num_labels)), metadata(metadata)
+    {
+    }
+
+    // 层按前向传播的顺序添加，写入前不得修改
+    void add_layer(const AlignedMatrix &weights, const std::vector<float> &biases)
+    {
+        layers.push_back({&weights, &biases});
+    }
+
+    // 先在内存中组装整个文件再计算校验和，写临时文件后rename，读者永远不会看到写了一半的模型
+    void write(const std::string &path) const
+    {
+        ModelHeader header{};
+        std::memcpy(header.magic, model_format::MAGIC, sizeof(header.magic));
+        header.version = model_format::VERSION;
+        header.header_size = sizeof(ModelHeader);
+        header.input_dim = input_dim;
+        header.num_labels = num_labels;
+        header.sequence_length = metadata.sequence_length;
+        header.packet_features = metadata.packet_features;
+        header.stats_features = metadata.stats_features;
+        header.size_log_base = metadata.size_log_base;
+        header.num_layers = static_cast<uint32_t>(layers.size());
+        header.num_label_names = static_cast<uint32_t>(metadata.labels.size());
+
+        uint64_t label_table_size = 0;
+        for (const auto &label : metadata.labels)
+            label_table_size += 8 + label.second.size();
+        header.label_table_offset = model_format::align64(sizeof(ModelHeader));
+        header.layer_table_offset = model_format::align64(header.label_table_offset + label_table_size);
+
+        std::vector<ModelLayerEntry> entries(layers.size());
+        uint64_t offset = model_format::align64(header.layer_table_offset + layers.size() * sizeof(ModelLayerEntry));
+        for (size_t i = 0; i < layers.size(); ++i)
+        {
+            const AlignedMatrix &weights = *layers[i].weights;
+            entries[i].output_size = static_cast<uint32_t>(weights.rows());
+            entries[i].input_size = static_cast<uint32_t>(weights.cols());
+            entries[i].stride = static_cast<uint32_t>(weights.stride());
+            entries[i].weights_offset = offset;
+            offset = model_format::align64(offset + weights.rows() * weights.stride() * sizeof(float));
+            entries[i].biases_offset = offset;
+            offset = model_format::align64(offset + layers[i].biases->size() * sizeof(float));
+        }
+        header.file_size = offset;
+
+        std::vector<char> buffer(offset, 0);
+        for (uint64_t pos = header.label_table_offset; const auto &label : metadata.labels)
+        {
+            uint32_t label_value = static_cast<uint32_t>(label.first);
+            uint32_t name_len = static_cast<uint32_t>(label.second.size());
+            std::memcpy(buffer.data() + pos, &label_value, 4);
+            std::memcpy(buffer.data() + pos + 4, &name_len, 4);
+            std::memcpy(buffer.data() + pos + 8, label.second.data(), name_len);
+            pos += 8 + name_len;
+        }
+        std::memcpy(buffer.data() + header.layer_table_offset, entries.data(), entries.size() * sizeof(ModelLayerEntry));
+        for (size_t i = 0; i < layers.size(); ++i)
+        {
+            const AlignedMatrix &weights = *layers[i].weights;
+            std::memcpy(buffer.data() + entries[i].weights_offset, weights.data(), weights.rows() * weights.stride() * sizeof(float));
+            std::memcpy(buffer.data() + entries[i].biases_offset, layers[i].biases->data(), layers[i].biases->size() * sizeof(float));
+        }
+        header.checksum = model_format::checksum(buffer.data() + sizeof(ModelHeader), buffer.size() - sizeof(ModelHeader));
+        std::memcpy(buffer.data(), &header, sizeof(header));
+
+        std::string tmp_path = path + ".tmp";
+        std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open())
+            throw std::runtime_error("Failed to save model to: " + tmp_path);
+        ofs.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        ofs.close();
+        if (!ofs)
+            throw std::runtime_error("Failed to write model file: " + tmp_path);
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+            throw std::runtime_error("Failed to rename model file to: " + path);
+    }
+};
+
+// 只读的模型文件，通过mmap直接访问各层权重
+class ModelFile
+{
+private:
+    MappedFile mapped_file;
+    const ModelHeader *header = nullptr;
+    std::vector<ModelLayerView> layer_views;
+    ModelMetadata meta;
+
+public:
+    // 打开并校验模型文件，格式错误或校验和不匹配时抛出异常
+    void open(const std::string &path)
+    {
+        if (!mapped_file.open(path, false))
+            throw std::runtime_error("Failed to open model: " + path);
+
+        std::string_view data = mapped_file.data();
+        if (data.size() < sizeof(ModelHeader))
+            throw std::runtime_error("Model file too small: " + path);
+
+        header = reinterpret_cast<const ModelHeader *>(data.data());
+        if (std::memcmp(header->magic, model_format::MAGIC, sizeof(header->magic)) != 0)
+            throw std::runtime_error("Not a TLS model file: " + path);
+        if (header->version != model_format::VERSION || header->header_size != sizeof(ModelHeader))
+            throw std::runtime_error("Unsupported model version " + std::to_string(header->version) + ": " + path);
+        if (header->file_size != data.size())
+            throw std::runtime_error("Truncated model file: " + path);
+        if (model_format::checksum(data.data() + sizeof(ModelHeader), data.size() - sizeof(ModelHeader)) != header->checksum)
+            throw std::runtime_error("Model checksum mismatch: " + path);
+
+        meta = ModelMetadata();
+        meta.sequence_length = header->sequence_length;
+        meta.packet_features = header->packet_features;
+        meta.stats_features = header->stats_features;
+        meta.size_log_base = header->size_log_base;
+
+        // 标签表
+        uint64_t pos = header->label_table_offset;
+        for (uint32_t i = 0; i < header->num_label_names; ++i)
+        {
+            if (pos + 8 > data.size())
+                throw std::runtime_error("Corrupted label table: " + path);
+            uint32_t label, name_len;
+            std::memcpy(&label, data.data() + pos, 4);
+            std::memcpy(&name_len, data.data() + pos + 4, 4);
+            pos += 8;
+            if (pos + name_len > data.size())
+                throw std::runtime_error("Corrupted label table: " + path);
+            meta.labels.push_back({static_cast<int>(label), std::string(data.substr(pos, name_len))});
+            pos += name_len;
+        }
+
+        // 层表
+        if (header->layer_table_offset + header->num_layers * sizeof(ModelLayerEntry) > data.size())
+            throw std::runtime_error("Corrupted layer table: " + path);
+        const ModelLayerEntry *entries = reinterpret_cast<const ModelLayerEntry *>(data.data() + header->layer_table_offset);
+        layer_views.clear();
+        for (uint32_t i = 0; i < header->num_layers; ++i)
+        {
+            const ModelLayerEntry &entry = entries[i];
+            uint64_t weights_end = entry.weights_offset + static_cast<uint64_t>(entry.output_size) * entry.stride * sizeof(float);
+            uint64_t biases_end = entry.biases_offset + static_cast<uint64_t>(entry.output_size) * sizeof(float);
+            if (entry.stride < entry.input_size || weights_end > data.size() || biases_end > data.size())
+                throw std::runtime_error("Corrupted layer table: " + path);
+            layer_views.push_back({static_cast<int>(entry.output_size), static_cast<int>(entry.input_size), entry.stride,
+                                   reinterpret_cast<const float *>(data.data() + entry.weights_offset),
+                                   reinterpret_cast<const float *>(data.data() + entry.biases_offset)});
+        }
+    }
+
+    int input_dim() const { return static_cast<int>(header->input_dim); }
+    int num_labels() const { return static_cast<int>(header->num_labels); }
+    const ModelMetadata &metadata() const { return meta; }
+    size_t num_layers() const { return layer_views.size(); }
+    const ModelLayerView &layer(size_t index) const { return layer_views.at(index); }
+};
+
+#endif // _MODEL_FILE_HPP_
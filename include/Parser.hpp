@@ -20,48 +20,129 @@ tls.handshake.type:(用于判断数据包方向)
 #include <sstream>
 #include <vector>
 #include <unordered_map>
+#include <mutex>
 #include <unistd.h>
 #include <array>
 #include <chrono>
 #include <thread>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <sys/wait.h>
 
 #include "FileLoader.hpp"
 #include "DomainManager.hpp"
-
+#include "PcapReader.hpp"
+#include "TLSStreamDecoder.hpp"
+#include "ThreadPool.hpp"
+#include "TLSTraceStore.hpp"
+#include "TraceCache.hpp"
+#include "SessionDemux.hpp"
+#include "Metrics.hpp"
+#include "Logger.hpp"
+
+// 解析过程中的一条TLS记录。ip_src/ip_dst指向解析器内部的缓冲区，只在回调期间有效；
+// 需要长期保存的字段由TLSTraceStore按列存储，站点名和IP地址在store中只驻留一份。
 struct TLSRecord
 {
-    std::string site_name;
-    std::string ip_src;
-    std::string ip_dst;
-    int tls_record_type = -1;
+    std::string_view ip_src;
+    std::string_view ip_dst;
     int frame_length = -1;
     int tls_handshake_type = -1;
     int tls_direction = -1;
 };
 
+// 每解析出一条TLS记录回调一次，记录对象在回调返回后即被复用，需要保留时应自行拷贝
+using TLSRecordVisitor = std::function<void(const TLSRecord &)>;
+
+// 解析后端：NATIVE为内置的pcap/TLS解码器；TSHARK为原有的tshark子进程方式；
+// VERIFY同时运行两者并比较结果，用于校验原生解码器。
+enum class ParseBackend
+{
+    NATIVE,
+    TSHARK,
+    VERIFY
+};
+
 class Parser
 {
 private:
-    std::string server_ip;
-    std::string client_ip;
-
-    std::vector<TLSRecord> single_pcap_tls_records; // 一个pcap文件中的所有TLS特征，整体作为一个样本。
-
-    std::unordered_map<std::string, std::unordered_map<std::string, std::vector<TLSRecord>>> tls_records_map; // 所有域名下所有pcap文件中的所有TLS特征。作为一个全局映射。
-    // all_domain -> baidu -> 50*xxx.pcap -> 8*TLS
-    // 一个哈希表中储存多个子哈希表，一个子哈希表代表一个域名下所有的pcap文件，子哈希表的key为pcap文件名，value为该pcap文件中的所有TLS特征。
+    // 一个pcap文件内的会话端点，由ClientHello/ServerHello确定。每个文件独立一份，保证parse_file可重入
+    struct DirectionState
+    {
+        std::string server_ip;
+        std::string client_ip;
+    };
+
+    ParseBackend backend;
+    bool tshark_available = false;
+    size_t num_threads;
+    std::string cache_path; // 解析结果缓存文件，为空时不使用缓存
+    bool verbose = true;    // 是否输出每个文件的解析日志
+    size_t record_budget;   // 每个文件最多解析的有效记录数(方向已知)，达到后不再读取文件的其余部分；0表示不限制
+
+    TLSTraceStore trace_store; // 所有域名下所有pcap文件中的所有TLS特征，一个pcap文件对应一个trace。
+    // trace的顺序固定为 站点 -> 文件名，与多线程解析的调度无关。
+
+    // 解析相关的指标，所有Parser实例共享
+    struct ParseMetrics
+    {
+        Counter &files;
+        Counter &packets;
+        Counter &records;
+        Counter &bytes_mapped;
+        Counter &open_errors;
+        Counter &unsupported_linktype;
+        Counter &direction_conflict;
+        Counter &direction_unknown;
+        Counter &native_fallback;
+        Counter &budget_stops;
+        Histogram &file_seconds;
+    };
+
+    static ParseMetrics &metrics()
+    {
+        static ParseMetrics m = []
+        {
+            MetricsRegistry *r = MetricsRegistry::instance();
+            auto error = [r](const char *kind) -> Counter &
+            { return r->counter("tls_parser_errors_total", "Parse errors by kind", std::string("kind=\"") + kind + "\""); };
+            return ParseMetrics{
+                r->counter("tls_parser_files_total", "Pcap files parsed"),
+                r->counter("tls_parser_packets_total", "Packets read by the native decoder"),
+                r->counter("tls_parser_records_total", "TLS records extracted"),
+                r->counter("tls_parser_bytes_mapped_total", "Bytes of pcap files mapped by the native decoder"),
+                error("open"),
+                error("unsupported_linktype"),
+                error("direction_conflict"),
+                error("direction_unknown"),
+                error("native_fallback"),
+                r->counter("tls_parser_budget_stops_total", "Files whose parse stopped early at the record budget"),
+                r->histogram("tls_parser_file_seconds", "Time to parse one pcap file")};
+        }();
+        return m;
+    }
 
 public:
-    Parser()
+    /*
+    @param parse_corpus 为false时不解析整个语料库，仅通过parse_file()流式使用，记录不会驻留在内存中
+    @param num_threads 解析语料库使用的线程数，0表示使用全部硬件线程
+    @param cache_path 解析结果缓存文件，未变化的pcap文件直接复用上次的结果；为空时每次都重新解析
+    @param record_budget 每个pcap文件(采集目录中为每个会话)最多解析的有效记录数，见set_record_budget
+    */
+    Parser(ParseBackend backend = ParseBackend::NATIVE, bool parse_corpus = true, size_t num_threads = 0,
+           const std::string &cache_path = "", size_t record_budget = 0)
+        : backend(backend), num_threads(num_threads), cache_path(cache_path), record_budget(record_budget)
     {
-        if (!is_tshark_available())
+        tshark_available = is_tshark_available();
+        if (backend != ParseBackend::NATIVE && !tshark_available)
         {
-            std::cerr << "[ERROR] tshark is not available! Try to install it first." << std::endl;
+            LOG_ERROR << "tshark is not available! Try to install it first.";
             exit(1);
         }
-        parse_all_files();
+        if (parse_corpus)
+            parse_all_files();
     }
 
 private:
@@ -75,55 +156,134 @@ private:
         pclose(fp);
         return found;
     }
-    // static std::string extract_site_name_from_url(const std::string &url)
-    // {
-    //     // www.baidu.com -> baidu
-    //     std::vector<std::string> parts;
-    //     std::string part;
-    //     std::istringstream iss(url);
-    //     std::string site_name;
-    //     while (std::getline(iss, part, '.'))
-    //     {
-    //         parts.emplace_back(part);
-    //     }
-    //     if (parts.size() >= 2)
-    //         return parts[parts.size() - 2];
-    //     else
-    //     {
-    //         std::cerr << "[WARN] Invalid URL format:" << url << std::endl;
-    //         return url;
-    //     }
-    // }
-
-    static std::string extract_site_name_from_path(const std::string &file_path)
-    {
-        // path/to/data/baidu/timestamp<int>.pcap -> baidu
-        size_t last_slash = file_path.find_last_of('/');
-        size_t second_last_slash = file_path.find_last_of('/', last_slash - 1);
 
-        if (second_last_slash != std::string::npos && last_slash != std::string::npos)
+    /*
+    @brief 根据握手包的类型确定该pcap文件中所有数据包的client_ip和server_ip，从而确定数据包的方向
+    @return 成功确定方向时返回true；方向冲突时返回false，该记录应被丢弃
+    */
+    static bool assign_direction(DirectionState &state, TLSRecord &tls_record)
+    {
+        if (tls_record.tls_handshake_type == 1)
         {
-            return file_path.substr(second_last_slash + 1, last_slash - second_last_slash - 1);
+            tls_record.tls_direction = 0; // client->server
+            state.client_ip.assign(tls_record.ip_src);
+            state.server_ip.assign(tls_record.ip_dst);
         }
-
-        std::cerr << "[WARN] Cannot extract site name from path: " << file_path << std::endl;
-        return "unknown";
+        else if (tls_record.tls_handshake_type == 2)
+        {
+            tls_record.tls_direction = 1; // server->client
+            state.client_ip.assign(tls_record.ip_dst);
+            state.server_ip.assign(tls_record.ip_src);
+        }
+        else if (!state.client_ip.empty() || !state.server_ip.empty())
+        {
+            auto tls_direction_temp1 = (state.client_ip == tls_record.ip_src) ? 0 : 1;
+            auto tls_direction_temp2 = (state.server_ip == tls_record.ip_src) ? 1 : 0;
+            if (tls_direction_temp1 == tls_direction_temp2)
+            {
+                tls_record.tls_direction = tls_direction_temp1;
+            }
+            else
+            {
+                metrics().direction_conflict.add();
+                LOG_DEBUG << "Failed to determine tls_direction for tls_record: " << tls_record.ip_src << "->" << tls_record.ip_dst;
+                return false;
+            }
+        }
+        else
+        {
+            // 握手之前的记录无法确定方向，每条都输出会刷屏，只计数
+            metrics().direction_unknown.add();
+            LOG_DEBUG << "Failed to determine tls_direction for tls_record: " << tls_record.ip_src << "->" << tls_record.ip_dst;
+        }
+        return true;
     }
 
-    void parse_single_file(const std::string &file_path)
+    // 使用内置解码器解析pcap/pcapng文件，无法识别文件时返回false
+    template <typename Visitor>
+    bool parse_with_native(const std::string &file_path, Visitor &&visit) const
     {
-        if (file_path.empty() || access(file_path.c_str(), R_OK) != 0)
+        PcapReader reader;
+        if (!reader.open(file_path))
+            return false;
+        metrics().bytes_mapped.add(reader.size());
+
+        DirectionState direction_state;
+
+        TLSStreamDecoder tls_decoder;
+        RawPacket raw;
+        TCPPacket tcp;
+        size_t packet_count = 0;
+        size_t unsupported_packets = 0;
+        size_t record_count = 0;
+        size_t valid_records = 0; // 方向已知的记录，计入record_budget
+
+        // 记录对象在整个文件中复用，地址没有变化时不重新格式化IP字符串
+        TLSRecord tls_record;
+        std::string ip_src, ip_dst;
+        uint8_t last_src[16]{}, last_dst[16]{};
+        int last_version = 0;
+
+        while (reader.next(raw))
         {
-            std::cerr << "[ERROR] Cannot access pcap file: " << file_path << std::endl;
-            return;
+            packet_count++;
+            if (!PacketDecoder::decode_tcp(raw, tcp))
+            {
+                if (!PacketDecoder::is_supported_linktype(raw.linktype))
+                    unsupported_packets++;
+                continue;
+            }
+
+            TLSPacketInfo info = tls_decoder.process(tcp);
+            if (!info.is_tls)
+                continue;
+
+            if (tcp.ip_version != last_version ||
+                std::memcmp(tcp.src_addr, last_src, sizeof(last_src)) != 0 ||
+                std::memcmp(tcp.dst_addr, last_dst, sizeof(last_dst)) != 0)
+            {
+                ip_src = PacketDecoder::addr_to_string(tcp.ip_version, tcp.src_addr);
+                ip_dst = PacketDecoder::addr_to_string(tcp.ip_version, tcp.dst_addr);
+                tls_record.ip_src = ip_src;
+                tls_record.ip_dst = ip_dst;
+                std::memcpy(last_src, tcp.src_addr, sizeof(last_src));
+                std::memcpy(last_dst, tcp.dst_addr, sizeof(last_dst));
+                last_version = tcp.ip_version;
+            }
+            tls_record.frame_length = static_cast<int>(raw.origlen);
+            tls_record.tls_handshake_type = info.tls_handshake_type;
+            tls_record.tls_direction = -1;
+
+            if (!assign_direction(direction_state, tls_record))
+                continue;
+            visit(tls_record);
+            record_count++;
+
+            // 特征只使用前K条记录，其余的包不再解码，也不再从mmap中读入
+            valid_records += tls_record.tls_direction >= 0;
+            if (record_budget > 0 && valid_records >= record_budget)
+            {
+                metrics().budget_stops.add();
+                break;
+            }
         }
 
-        std::cout << "[INFO] Parsing TLSRecord from file: " << file_path << std::endl;
+        // 计数器在文件结束时一次性累加，逐包循环中不访问共享的缓存行
+        metrics().packets.add(packet_count);
+        if (unsupported_packets > 0)
+            metrics().unsupported_linktype.add(unsupported_packets);
+
+        // 整个文件都是不支持的链路类型，交给tshark处理
+        if (record_count == 0 && unsupported_packets > 0)
+            return false;
+        return true;
+    }
 
-        // 清空上一次解析的结果
-        single_pcap_tls_records.clear();
-        server_ip.clear();
-        client_ip.clear();
+    // 使用tshark子进程解析pcap文件
+    template <typename Visitor>
+    void parse_with_tshark(const std::string &file_path, Visitor &&visit) const
+    {
+        DirectionState direction_state;
 
         std::stringstream tshark_cmd;
         tshark_cmd << "tshark -r \"" << file_path << "\""
@@ -145,14 +305,12 @@ private:
         FILE *fp = popen(tshark_cmd.str().c_str(), "r");
         if (!fp)
         {
-            std::cerr << "[ERROR] Failed to run tshark command: " << strerror(errno) << std::endl;
+            LOG_ERROR << "Failed to run tshark command: " << strerror(errno);
             return;
         }
 
         std::array<char, 4096> buf;
-        size_t record_count = 0;
-        // std::string site_name = extract_site_name_from_url(file_path); //! BUG
-        std::string site_name = extract_site_name_from_path(file_path);
+        size_t valid_records = 0;
 
         while (fgets(buf.data(), buf.size(), fp) != nullptr) // 逐行读取输出
         {
@@ -183,9 +341,10 @@ private:
                 tokens.push_back(token);
             }
             // std::cout << "[DEBUG] tokens: " << tokens.size() << std::endl;
+            if (tokens.size() < 4)
+                continue;
 
             TLSRecord tls_record;
-            tls_record.site_name = site_name;
             tls_record.ip_src = tokens[1];
             tls_record.ip_dst = tokens[2];
 
@@ -200,89 +359,299 @@ private:
             }
             catch (const std::exception &e)
             {
-                std::cerr << "[WARN] Failed to parse numeric fields: " << e.what() << " in line: " << line << std::endl;
+                LOG_WARN << "Failed to parse numeric fields: " << e.what() << " in line: " << line;
                 continue;
             }
 
             // DEBUG (token4可能越界)
             // std::cout << "[DEBUG]" << tokens[0] << " " << tokens[1] << " " << tokens[2] << " " << tokens[3] << " " << tokens[4] << " " << std::endl;
 
-            // 根据握手包的类型确定该pcap文件中所有数据包的client_ip和server_ip，从而确定所有数据包的方向
-            if (tls_record.tls_handshake_type == 1)
-            {
-                tls_record.tls_direction = 0; // client->server
-                client_ip = tls_record.ip_src;
-                server_ip = tls_record.ip_dst;
-            }
-            else if (tls_record.tls_handshake_type == 2)
-            {
-                tls_record.tls_direction = 1; // server->client
-                client_ip = tls_record.ip_dst;
-                server_ip = tls_record.ip_src;
-            }
-            else if (!client_ip.empty() || !server_ip.empty())
-            {
-                auto tls_direction_temp1 = (client_ip == tls_record.ip_src) ? 0 : 1;
-                auto tls_direction_temp2 = (server_ip == tls_record.ip_src) ? 1 : 0;
-                if (tls_direction_temp1 == tls_direction_temp2)
-                {
-                    tls_record.tls_direction = tls_direction_temp1;
-                }
-                else
-                {
-                    std::cerr << "[WARN] Failed to determine tls_direction for tls_record: " << tls_record.ip_src << "->" << tls_record.ip_dst << std::endl;
-                    continue;
-                }
-            }
-            else
-            {
-                std::cerr << "[WARN] Failed to determine tls_direction for tls_record: " << tls_record.ip_src << "->" << tls_record.ip_dst << std::endl;
-            }
-
-            single_pcap_tls_records.push_back(tls_record);
-            record_count++;
+            if (!assign_direction(direction_state, tls_record))
+                continue;
+            visit(tls_record);
+            valid_records += tls_record.tls_direction >= 0;
+            if (record_budget > 0 && valid_records >= record_budget)
+                break;
         }
 
+        // 提前停止读取时tshark会因SIGPIPE退出，不是错误
+        bool stopped_early = record_budget > 0 && valid_records >= record_budget;
+        if (stopped_early)
+            metrics().budget_stops.add();
         int status = pclose(fp);
-        if (status != 0)
+        if (status != 0 && !stopped_early)
         {
             if (WIFEXITED(status))
             {
-                std::cerr << "[WARN] tshark command exited with status: " << WEXITSTATUS(status) << std::endl;
+                LOG_WARN << "tshark command exited with status: " << WEXITSTATUS(status);
             }
             else if (WIFSIGNALED(status))
             {
-                std::cerr << "[WARN] tshark command killed by signal: " << WTERMSIG(status) << std::endl;
+                LOG_WARN << "tshark command killed by signal: " << WTERMSIG(status);
             }
             else
             {
-                std::cerr << "[WARN] tshark command terminated abnormally" << std::endl;
+                LOG_WARN << "tshark command terminated abnormally";
             }
         }
+    }
 
-        std::cout << "[INFO] Parsed " << record_count << " TLS records from " << file_path << std::endl;
+    // VERIFY模式下暂存的记录，自行持有IP字符串
+    struct OwnedRecord
+    {
+        std::string ip_src;
+        std::string ip_dst;
+        TLSRecord record;
+    };
+
+    // 比较原生解码器与tshark的解析结果，只比较下游使用的字段
+    static void verify_records(const std::string &file_path,
+                               const std::vector<OwnedRecord> &native_records,
+                               const std::vector<OwnedRecord> &tshark_records)
+    {
+        size_t mismatches = 0;
+        size_t common = std::min(native_records.size(), tshark_records.size());
+        for (size_t i = 0; i < common; ++i)
+        {
+            const TLSRecord &a = native_records[i].record;
+            const TLSRecord &b = tshark_records[i].record;
+            if (a.frame_length != b.frame_length || a.tls_handshake_type != b.tls_handshake_type ||
+                a.tls_direction != b.tls_direction)
+            {
+                if (mismatches == 0)
+                {
+                    LOG_WARN << "First mismatch at record " << i << ": native(" << a.frame_length << ","
+                             << a.tls_handshake_type << "," << a.tls_direction << ") vs tshark(" << b.frame_length
+                             << "," << b.tls_handshake_type << "," << b.tls_direction << ")";
+                }
+                mismatches++;
+            }
+        }
 
-        // 存储到全局映射中
-        if (!single_pcap_tls_records.empty() && !site_name.empty())
+        if (mismatches == 0 && native_records.size() == tshark_records.size())
+        {
+            LOG_INFO << "Verification passed: " << file_path;
+        }
+        else
         {
-            std::string filename = file_path.substr(file_path.find_last_of('/') + 1);
-            tls_records_map[site_name][filename] = single_pcap_tls_records;
+            LOG_WARN << "Verification failed: " << file_path << " native=" << native_records.size()
+                     << " tshark=" << tshark_records.size() << " mismatches=" << mismatches;
         }
     }
 
+    // 并行解析所有pcap文件。每个工作线程把结果写入自己的缓冲区，全部完成后按 站点 -> 文件名 的顺序合并
     void parse_all_files()
     {
-        for (auto &domain : FileLoader::instance()->get_file_map())
+        const auto &file_map = FileLoader::instance()->get_file_map();
+
+        std::vector<std::string> sites;
+        for (const auto &domain : file_map)
+            sites.push_back(domain.first);
+        std::sort(sites.begin(), sites.end());
+
+        struct ParseTask
+        {
+            const std::string *site_name;
+            const std::string *file_path;
+        };
+        std::vector<ParseTask> tasks;
+        for (const auto &site : sites)
+        {
+            for (const auto &file : file_map.at(site)) // 文件列表已由FileLoader排序
+                tasks.push_back({&site, &file});
+        }
+
+        // 只有内置解码器的结果会被缓存，tshark和校验模式总是重新解析
+        TraceCache cache;
+        bool use_cache = !cache_path.empty() && backend == ParseBackend::NATIVE;
+        if (use_cache && cache.load(cache_path, record_budget))
+            LOG_INFO << "Loaded " << cache.size() << " cached pcap files from " << cache_path;
+
+        // 每个任务的结果：来自缓存中的trace，或来自某个工作线程私有store中的trace
+        struct TaskOutcome
+        {
+            FileStamp stamp;
+            uint64_t content_hash = 0;
+            bool cached = false;
+            size_t worker = 0;
+            size_t trace_index = 0;
+        };
+        std::vector<TaskOutcome> outcomes(tasks.size());
+
+        WorkStealingPool pool(std::min(num_threads > 0 ? num_threads : std::thread::hardware_concurrency(),
+                                       std::max<size_t>(1, tasks.size())));
+        std::vector<TLSTraceStore> worker_stores(pool.size());
+
+        LOG_INFO << "Parsing " << tasks.size() << " pcap files with " << pool.size() << " threads";
+
+        pool.parallel_for(tasks.size(), [&](size_t task_index, size_t worker)
+                          {
+                              const ParseTask &task = tasks[task_index];
+                              TaskOutcome &outcome = outcomes[task_index];
+
+                              if (use_cache && FileStamp::of(*task.file_path, outcome.stamp))
+                              {
+                                  // 大小和修改时间未变化时直接命中；否则比较内容哈希
+                                  const TraceCache::Entry *entry = cache.find(*task.file_path);
+                                  if (entry && entry->stamp == outcome.stamp)
+                                  {
+                                      outcome.content_hash = entry->content_hash;
+                                      outcome.cached = true;
+                                  }
+                                  else
+                                  {
+                                      outcome.content_hash = TraceCache::hash_file(*task.file_path);
+                                      outcome.cached = entry && entry->content_hash == outcome.content_hash;
+                                  }
+                                  if (outcome.cached)
+                                  {
+                                      outcome.trace_index = entry->trace_index;
+                                      return;
+                                  }
+                              }
+
+                              TLSTraceStore &store = worker_stores[worker];
+                              std::string_view filename(*task.file_path);
+                              filename.remove_prefix(filename.find_last_of('/') + 1);
+
+                              outcome.worker = worker;
+                              outcome.trace_index = store.num_traces();
+                              store.begin_trace(*task.site_name, filename);
+                              parse_file(*task.file_path, [&store](const TLSRecord &tls_record)
+                                         { store.push_record(tls_record.frame_length, tls_record.tls_handshake_type,
+                                                             tls_record.tls_direction, tls_record.ip_src, tls_record.ip_dst); });
+                              store.end_trace(true); // 空文件也保留trace，以便写入缓存
+                          });
+
+        // 按任务顺序合并，空文件的trace被丢弃
+        size_t total_records = 0, cache_hits = 0;
+        for (const auto &store : worker_stores)
+            total_records += store.num_records();
+        trace_store.reserve_records(total_records + cache.get_store().num_records());
+
+        TraceCache updated_cache(record_budget); // 只包含本次语料库中的文件，已删除的文件随之从缓存中移除
+        for (size_t i = 0; i < tasks.size(); ++i)
+        {
+            const TaskOutcome &outcome = outcomes[i];
+            const TLSTraceStore &source = outcome.cached ? cache.get_store() : worker_stores[outcome.worker];
+            if (outcome.cached)
+                cache_hits++;
+            if (source.trace(outcome.trace_index).length > 0)
+                trace_store.append_trace(source, outcome.trace_index);
+            if (use_cache)
+                updated_cache.add(*tasks[i].file_path, outcome.stamp, outcome.content_hash, source, outcome.trace_index);
+        }
+
+        if (use_cache)
+        {
+            LOG_INFO << "Reused " << cache_hits << " cached pcap files, parsed "
+                     << tasks.size() - cache_hits << " new or changed files";
+            updated_cache.save(cache_path);
+        }
+
+        Logger::instance()->flush(); // 逐文件的日志先于汇总输出
+        LOG_INFO << "Stored " << trace_store.num_records() << " TLS records from "
+                 << trace_store.num_traces() << " pcap files";
+        Logger::instance()->flush();
+    }
+
+public:
+    /*
+    @brief 流式解析单个pcap文件，每条TLS记录通过visit回调交给调用者，Parser本身不保留任何记录
+    @return 解析出的TLS记录数
+    */
+    size_t parse_file(const std::string &file_path, const TLSRecordVisitor &visit) const
+    {
+        ParseMetrics &m = metrics();
+        if (file_path.empty() || access(file_path.c_str(), R_OK) != 0)
+        {
+            m.open_errors.add();
+            LOG_ERROR << "Cannot access pcap file: " << file_path;
+            return 0;
+        }
+
+        ScopedTimer timer(m.file_seconds);
+        if (verbose)
+            LOG_INFO << "Parsing TLSRecord from file: " << file_path;
+
+        size_t record_count = 0;
+        auto counting_visit = [&](const TLSRecord &tls_record)
         {
-            for (auto &file : domain.second)
+            record_count++;
+            visit(tls_record);
+        };
+
+        if (backend == ParseBackend::TSHARK)
+        {
+            parse_with_tshark(file_path, counting_visit);
+        }
+        else if (backend == ParseBackend::VERIFY)
+        {
+            std::vector<OwnedRecord> native_records, tshark_records;
+            auto keep = [](std::vector<OwnedRecord> &records)
+            {
+                return [&records](const TLSRecord &r)
+                { records.push_back({std::string(r.ip_src), std::string(r.ip_dst), r}); };
+            };
+            parse_with_native(file_path, keep(native_records));
+            parse_with_tshark(file_path, keep(tshark_records));
+            verify_records(file_path, native_records, tshark_records);
+            for (auto &owned : native_records)
+            {
+                owned.record.ip_src = owned.ip_src;
+                owned.record.ip_dst = owned.ip_dst;
+                counting_visit(owned.record);
+            }
+        }
+        else if (!parse_with_native(file_path, counting_visit))
+        {
+            // 原生解码器无法识别该文件(格式或链路类型不支持)时回退到tshark，此时尚未回调任何记录
+            m.native_fallback.add();
+            if (tshark_available)
             {
-                parse_single_file(file);
+                LOG_WARN << "Native parser failed, falling back to tshark: " << file_path;
+                parse_with_tshark(file_path, counting_visit);
             }
         }
+
+        m.files.add();
+        m.records.add(record_count);
+        if (verbose)
+            LOG_INFO << "Parsed " << record_count << " TLS records from " << file_path;
+        return record_count;
     }
 
-public:
-    const auto &get_tls_records_map() const { return tls_records_map; }
+    /*
+    @brief 把capture_root下所有采集目录(抓包环 + 会话日志)中的会话追加到trace_store，
+           与按文件解析的trace一起用于生成数据集
+    @return 追加的trace数
+    */
+    size_t parse_captures(const std::string &capture_root = "../capture")
+    {
+        std::vector<std::string> capture_dirs = SessionDemux::list_capture_dirs(capture_root);
+        size_t added = 0;
+        for (const std::string &capture_dir : capture_dirs)
+            added += SessionDemux::demux_capture(capture_dir, trace_store, record_budget);
+        if (!capture_dirs.empty())
+        {
+            LOG_INFO << "Added " << added << " sessions from " << capture_dirs.size() << " captures, "
+                     << trace_store.num_traces() << " traces in total";
+        }
+        Logger::instance()->flush();
+        return added;
+    }
+
+    const TLSTraceStore &get_trace_store() const { return trace_store; }
+
+    // 批量预测等场景下关闭逐文件的日志，避免与结果输出混在一起
+    void set_verbose(bool enabled) { verbose = enabled; }
+
+    /*
+    @brief 设置每个文件最多解析的有效记录数。特征窗口为K条记录时，K之后的记录不影响特征，
+           长时间的会话(如视频流)只需解析开头的一小部分。方向未知的记录(握手之前)不计入
+    */
+    void set_record_budget(size_t records) { record_budget = records; }
+    size_t get_record_budget() const { return record_budget; }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,510 @@
+/*
+PcapReader为原生的pcap/pcapng文件读取器，以及最小化的链路层/网络层/传输层解码器。
+支持的链路类型：Ethernet(含VLAN)、Linux SLL(tcpdump -i any)、Linux SLL2、Raw IP、BSD Loopback。
+支持的网络层：IPv4、IPv6(跳过常见扩展头)；传输层仅解析TCP。
+*/
+#ifndef _PCAP_READER_HPP_
+#define _PCAP_READER_HPP_
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <arpa/inet.h>
+
+#include "MappedFile.hpp"
+#include "Logger.hpp"
+
+// pcap中的一个原始数据包，data直接指向文件映射中的数据，仅在PcapReader存活期间有效
+struct RawPacket
+{
+    uint64_t timestamp_us = 0; // 时间戳(微秒)
+    uint32_t origlen = 0;      // 原始长度，对应tshark的frame.len
+    int linktype = -1;         // 链路层类型
+    std::string_view data;     // 实际捕获的数据
+};
+
+class PcapReader
+{
+private:
+    // 文件格式魔数
+    static const uint32_t PCAP_MAGIC_US = 0xa1b2c3d4;
+    static const uint32_t PCAP_MAGIC_NS = 0xa1b23c4d;
+    static const uint32_t PCAPNG_SHB = 0x0A0D0D0A;
+    static const uint32_t PCAPNG_BYTE_ORDER = 0x1A2B3C4D;
+
+    enum class Format
+    {
+        NONE,
+        PCAP,
+        PCAPNG
+    };
+
+    // pcapng中每个接口各自的链路类型和时间戳精度
+    struct Interface
+    {
+        int linktype = -1;
+        uint64_t ts_units_per_sec = 1000000; // 默认精度为微秒
+    };
+
+    MappedFile mapped_file;
+    std::string_view buffer; // 整个文件的映射
+    size_t offset = 0;
+    Format format = Format::NONE;
+    bool swapped = false; // 文件字节序与主机字节序是否相反
+
+    // pcap
+    int pcap_linktype = -1;
+    bool pcap_nanosecond = false;
+
+    // pcapng
+    std::vector<Interface> interfaces;
+
+public:
+    // 文件开头的4字节是否为pcap(两种字节序，微秒或纳秒精度)或pcapng的魔数
+    static bool is_capture_magic(uint32_t magic)
+    {
+        return magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS || magic == __builtin_bswap32(PCAP_MAGIC_US) ||
+               magic == __builtin_bswap32(PCAP_MAGIC_NS) || magic == PCAPNG_SHB;
+    }
+
+    bool open(const std::string &file_path)
+    {
+        buffer = std::string_view();
+        interfaces.clear();
+        offset = 0;
+        format = Format::NONE;
+
+        if (!mapped_file.open(file_path))
+            return false;
+        buffer = mapped_file.data();
+
+        if (buffer.size() < 4)
+        {
+            LOG_WARN << "File too small to be a pcap: " << file_path;
+            return false;
+        }
+
+        uint32_t magic = read_u32_raw(0);
+        if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS ||
+            magic == __builtin_bswap32(PCAP_MAGIC_US) || magic == __builtin_bswap32(PCAP_MAGIC_NS))
+        {
+            return open_pcap(magic);
+        }
+        if (magic == PCAPNG_SHB)
+        {
+            format = Format::PCAPNG;
+            return true; // SHB在next()中统一处理
+        }
+
+        LOG_WARN << "Unknown capture file format: " << file_path;
+        return false;
+    }
+
+    // 映射的文件大小(字节)
+    size_t size() const { return buffer.size(); }
+
+    // 读取下一个数据包，读完或遇到损坏数据时返回false
+    bool next(RawPacket &packet)
+    {
+        if (format == Format::PCAP)
+            return next_pcap(packet);
+        if (format == Format::PCAPNG)
+            return next_pcapng(packet);
+        return false;
+    }
+
+private:
+    uint32_t read_u32_raw(size_t pos) const
+    {
+        uint32_t v;
+        std::memcpy(&v, buffer.data() + pos, sizeof(v));
+        return v;
+    }
+
+    uint32_t read_u32(size_t pos) const
+    {
+        uint32_t v = read_u32_raw(pos);
+        return swapped ? __builtin_bswap32(v) : v;
+    }
+
+    uint16_t read_u16(size_t pos) const
+    {
+        uint16_t v;
+        std::memcpy(&v, buffer.data() + pos, sizeof(v));
+        return swapped ? __builtin_bswap16(v) : v;
+    }
+
+    bool open_pcap(uint32_t magic)
+    {
+        if (buffer.size() < 24)
+            return false;
+        swapped = (magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS);
+        uint32_t host_magic = swapped ? __builtin_bswap32(magic) : magic;
+        pcap_nanosecond = (host_magic == PCAP_MAGIC_NS);
+        pcap_linktype = static_cast<int>(read_u32(20) & 0x0FFFFFFF); // 高位为FCS等附加信息
+        offset = 24;
+        format = Format::PCAP;
+        return true;
+    }
+
+    bool next_pcap(RawPacket &packet)
+    {
+        if (offset + 16 > buffer.size())
+            return false;
+
+        uint32_t ts_sec = read_u32(offset);
+        uint32_t ts_frac = read_u32(offset + 4);
+        uint32_t caplen = read_u32(offset + 8);
+        uint32_t origlen = read_u32(offset + 12);
+        offset += 16;
+
+        if (offset + caplen > buffer.size())
+        {
+            LOG_WARN << "Truncated packet record in pcap file.";
+            return false;
+        }
+
+        packet.timestamp_us = static_cast<uint64_t>(ts_sec) * 1000000 + (pcap_nanosecond ? ts_frac / 1000 : ts_frac);
+        packet.origlen = origlen;
+        packet.linktype = pcap_linktype;
+        packet.data = buffer.substr(offset, caplen);
+        offset += caplen;
+        return true;
+    }
+
+    bool next_pcapng(RawPacket &packet)
+    {
+        while (offset + 12 <= buffer.size())
+        {
+            uint32_t block_type = read_u32_raw(offset);
+
+            if (block_type == PCAPNG_SHB) // Section Header Block，每个section可以有不同的字节序
+            {
+                uint32_t byte_order = read_u32_raw(offset + 8);
+                if (byte_order == PCAPNG_BYTE_ORDER)
+                    swapped = false;
+                else if (byte_order == __builtin_bswap32(PCAPNG_BYTE_ORDER))
+                    swapped = true;
+                else
+                {
+                    LOG_WARN << "Invalid pcapng byte-order magic.";
+                    return false;
+                }
+                interfaces.clear(); // 接口ID在新section中重新编号
+            }
+            else
+            {
+                block_type = read_u32(offset);
+            }
+
+            uint32_t block_len = read_u32(offset + 4);
+            if (block_len < 12 || block_len % 4 != 0 || offset + block_len > buffer.size())
+            {
+                LOG_WARN << "Corrupted pcapng block.";
+                return false;
+            }
+
+            size_t body = offset + 8;
+            size_t body_len = block_len - 12;
+            offset += block_len;
+
+            switch (block_type)
+            {
+            case 1: // Interface Description Block
+                if (body_len >= 8)
+                    interfaces.push_back(parse_interface(body, body_len));
+                break;
+            case 6: // Enhanced Packet Block
+            {
+                if (body_len < 20)
+                    break;
+                uint32_t if_id = read_u32(body);
+                uint64_t ts = (static_cast<uint64_t>(read_u32(body + 4)) << 32) | read_u32(body + 8);
+                uint32_t caplen = read_u32(body + 12);
+                uint32_t origlen = read_u32(body + 16);
+                if (if_id >= interfaces.size() || 20 + static_cast<size_t>(caplen) > body_len)
+                    break;
+
+                const Interface &itf = interfaces[if_id];
+                packet.timestamp_us = scale_timestamp(ts, itf.ts_units_per_sec);
+                packet.origlen = origlen;
+                packet.linktype = itf.linktype;
+                packet.data = buffer.substr(body + 20, caplen);
+                return true;
+            }
+            case 3: // Simple Packet Block，只能属于第一个接口
+            {
+                if (body_len < 4 || interfaces.empty())
+                    break;
+                uint32_t origlen = read_u32(body);
+                packet.timestamp_us = 0;
+                packet.origlen = origlen;
+                packet.linktype = interfaces[0].linktype;
+                packet.data = buffer.substr(body + 4, std::min<size_t>(origlen, body_len - 4));
+                return true;
+            }
+            default: // 其他块(统计信息、名称解析等)直接跳过
+                break;
+            }
+        }
+        return false;
+    }
+
+    Interface parse_interface(size_t body, size_t body_len) const
+    {
+        Interface itf;
+        itf.linktype = read_u16(body);
+
+        // 解析选项，只关心if_tsresol(9)
+        size_t pos = body + 8;
+        size_t end = body + body_len;
+        while (pos + 4 <= end)
+        {
+            uint16_t code = read_u16(pos);
+            uint16_t len = read_u16(pos + 2);
+            pos += 4;
+            if (code == 0 || pos + len > end)
+                break;
+            if (code == 9 && len >= 1)
+            {
+                uint8_t resol = static_cast<uint8_t>(buffer[pos]);
+                uint64_t units = 1;
+                if (resol & 0x80)
+                {
+                    for (int i = 0; i < (resol & 0x7F) && i < 63; ++i)
+                        units *= 2;
+                }
+                else
+                {
+                    for (int i = 0; i < resol && i < 19; ++i)
+                        units *= 10;
+                }
+                itf.ts_units_per_sec = units;
+            }
+            pos += (len + 3) & ~3u; // 选项按4字节对齐
+        }
+        return itf;
+    }
+
+    static uint64_t scale_timestamp(uint64_t ts, uint64_t units_per_sec)
+    {
+        if (units_per_sec == 1000000)
+            return ts;
+        return ts / units_per_sec * 1000000 + (ts % units_per_sec) * 1000000 / units_per_sec;
+    }
+};
+
+// 解码后的TCP数据包
+struct TCPPacket
+{
+    int ip_version = 0;     // 4或6
+    uint8_t src_addr[16]{}; // IPv4只使用前4字节
+    uint8_t dst_addr[16]{};
+    uint16_t src_port = 0;
+    uint16_t dst_port = 0;
+    uint32_t seq = 0;
+    uint8_t flags = 0;
+    const uint8_t *payload = nullptr;
+    uint32_t payload_len = 0;
+};
+
+class PacketDecoder
+{
+public:
+    // 链路层类型常量(参考 https://www.tcpdump.org/linktypes.html)
+    static const int LINKTYPE_NULL = 0;
+    static const int LINKTYPE_ETHERNET = 1;
+    static const int LINKTYPE_RAW = 101;
+    static const int LINKTYPE_LINUX_SLL = 113;
+    static const int LINKTYPE_LINUX_SLL2 = 276;
+    static const int LINKTYPE_IPV4 = 228;
+    static const int LINKTYPE_IPV6 = 229;
+
+    static bool is_supported_linktype(int linktype)
+    {
+        switch (linktype)
+        {
+        case LINKTYPE_NULL:
+        case LINKTYPE_ETHERNET:
+        case LINKTYPE_RAW:
+        case 12:
+        case 14:
+        case LINKTYPE_LINUX_SLL:
+        case LINKTYPE_LINUX_SLL2:
+        case LINKTYPE_IPV4:
+        case LINKTYPE_IPV6:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // 将原始数据包解码为TCP数据包，非TCP/无法解析时返回false
+    static bool decode_tcp(const RawPacket &raw, TCPPacket &tcp)
+    {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(raw.data.data());
+        size_t len = raw.data.size();
+        uint16_t ether_type = 0;
+
+        switch (raw.linktype)
+        {
+        case LINKTYPE_ETHERNET:
+        {
+            if (len < 14)
+                return false;
+            ether_type = be16(p + 12);
+            size_t hdr = 14;
+            while ((ether_type == 0x8100 || ether_type == 0x88a8) && len >= hdr + 4) // VLAN / QinQ
+            {
+                ether_type = be16(p + hdr + 2);
+                hdr += 4;
+            }
+            p += hdr;
+            len -= hdr;
+            break;
+        }
+        case LINKTYPE_LINUX_SLL:
+            if (len < 16)
+                return false;
+            ether_type = be16(p + 14);
+            p += 16;
+            len -= 16;
+            break;
+        case LINKTYPE_LINUX_SLL2:
+            if (len < 20)
+                return false;
+            ether_type = be16(p);
+            p += 20;
+            len -= 20;
+            break;
+        case LINKTYPE_NULL:
+        {
+            if (len < 4)
+                return false;
+            uint32_t family;
+            std::memcpy(&family, p, 4); // 主机字节序
+            if (family > 0xFFFF)
+                family = __builtin_bswap32(family);
+            if (family == 2)
+                ether_type = 0x0800;
+            else if (family == 24 || family == 28 || family == 30)
+                ether_type = 0x86DD;
+            else
+                return false;
+            p += 4;
+            len -= 4;
+            break;
+        }
+        case LINKTYPE_RAW:
+        case 12: // 部分系统上的DLT_RAW
+        case 14:
+        case LINKTYPE_IPV4:
+        case LINKTYPE_IPV6:
+            if (len < 1)
+                return false;
+            ether_type = ((p[0] >> 4) == 6) ? 0x86DD : 0x0800;
+            break;
+        default:
+            return false;
+        }
+
+        if (ether_type == 0x0800)
+            return decode_ipv4(p, len, tcp);
+        if (ether_type == 0x86DD)
+            return decode_ipv6(p, len, tcp);
+        return false;
+    }
+
+    // 把地址格式化为字符串，与tshark的ip.src/ip.dst输出一致
+    static std::string addr_to_string(int ip_version, const uint8_t *addr)
+    {
+        char buf[INET6_ADDRSTRLEN];
+        if (!inet_ntop(ip_version == 6 ? AF_INET6 : AF_INET, addr, buf, sizeof(buf)))
+            return "";
+        return std::string(buf);
+    }
+
+private:
+    static uint16_t be16(const uint8_t *p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+    static uint32_t be32(const uint8_t *p)
+    {
+        return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+               (static_cast<uint32_t>(p[2]) << 8) | p[3];
+    }
+
+    static bool decode_ipv4(const uint8_t *p, size_t len, TCPPacket &tcp)
+    {
+        if (len < 20 || (p[0] >> 4) != 4)
+            return false;
+        size_t ihl = (p[0] & 0x0F) * 4;
+        size_t total_len = be16(p + 2);
+        if (ihl < 20 || len < ihl)
+            return false;
+        if ((be16(p + 6) & 0x1FFF) != 0) // 非首个分片
+            return false;
+        if (p[9] != 6) // 非TCP
+            return false;
+
+        // total_len为0时(TSO)按捕获长度处理，否则去掉以太网填充
+        if (total_len >= ihl && total_len < len)
+            len = total_len;
+
+        tcp.ip_version = 4;
+        // TCPPacket在整个文件中复用，先清零以免残留上一个IPv6包的地址字节(流键比较全部16字节)
+        std::memset(tcp.src_addr, 0, sizeof(tcp.src_addr));
+        std::memset(tcp.dst_addr, 0, sizeof(tcp.dst_addr));
+        std::memcpy(tcp.src_addr, p + 12, 4);
+        std::memcpy(tcp.dst_addr, p + 16, 4);
+        return decode_tcp_header(p + ihl, len - ihl, tcp);
+    }
+
+    static bool decode_ipv6(const uint8_t *p, size_t len, TCPPacket &tcp)
+    {
+        if (len < 40 || (p[0] >> 4) != 6)
+            return false;
+        size_t payload_len = be16(p + 4);
+        uint8_t next_header = p[6];
+        if (payload_len > 0 && 40 + payload_len < len)
+            len = 40 + payload_len;
+
+        size_t pos = 40;
+        // 跳过扩展头：Hop-by-Hop(0)、Routing(43)、Destination Options(60)、AH(51)
+        while (next_header == 0 || next_header == 43 || next_header == 60 || next_header == 51)
+        {
+            if (pos + 8 > len)
+                return false;
+            size_t ext_len = (next_header == 51) ? (p[pos + 1] + 2) * 4 : (p[pos + 1] + 1) * 8;
+            next_header = p[pos];
+            pos += ext_len;
+        }
+        if (next_header != 6 || pos > len) // 分片(44)等情况不处理
+            return false;
+
+        tcp.ip_version = 6;
+        std::memcpy(tcp.src_addr, p + 8, 16);
+        std::memcpy(tcp.dst_addr, p + 24, 16);
+        return decode_tcp_header(p + pos, len - pos, tcp);
+    }
+
+    static bool decode_tcp_header(const uint8_t *p, size_t len, TCPPacket &tcp)
+    {
+        if (len < 20)
+            return false;
+        size_t data_offset = (p[12] >> 4) * 4;
+        if (data_offset < 20 || data_offset > len)
+            return false;
+
+        tcp.src_port = be16(p);
+        tcp.dst_port = be16(p + 2);
+        tcp.seq = be32(p + 4);
+        tcp.flags = p[13];
+        tcp.payload = p + data_offset;
+        tcp.payload_len = static_cast<uint32_t>(len - data_offset);
+        return true;
+    }
+};
+
+#endif // _PCAP_READER_HPP_
@@ -0,0 +1,203 @@
+/*
+PredictionClient是PredictionServer的同步客户端：一个连接，每次发送一个请求并等待应答。
+需要更高吞吐时可以开多个连接，服务端会把同时到达的请求合并成一个batch。
+*/
+#ifndef _PREDICTION_CLIENT_HPP_
+#define _PREDICTION_CLIENT_HPP_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <span>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "PredictionServer.hpp"
+
+class PredictionClient
+{
+public:
+    struct Result
+    {
+        prediction_protocol::Status status = prediction_protocol::Status::OK;
+        int label = -1;
+        std::vector<float> probabilities;
+    };
+
+    struct ModelInfo
+    {
+        int input_dim = 0;
+        int sequence_length = 0;
+        std::vector<std::string> labels; // 下标为标签，没有名称的标签为空字符串
+    };
+
+private:
+    int fd = -1;
+    uint32_t next_id = 1;
+    std::vector<uint8_t> request;
+    std::vector<uint8_t> payload;
+
+public:
+    PredictionClient() = default;
+    PredictionClient(const PredictionClient &) = delete;
+    PredictionClient &operator=(const PredictionClient &) = delete;
+
+    ~PredictionClient() { disconnect(); }
+
+    bool connect(const std::string &socket_path)
+    {
+        disconnect();
+        sockaddr_un addr{};
+        if (socket_path.size() >= sizeof(addr.sun_path))
+        {
+            std::cerr << "[ERROR] Socket path too long: " << socket_path << std::endl;
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            std::cerr << "[ERROR] Failed to connect to prediction server " << socket_path << ": " << strerror(errno) << std::endl;
+            disconnect();
+            return false;
+        }
+        return true;
+    }
+
+    void disconnect()
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    bool is_connected() const { return fd >= 0; }
+
+    // 发送已提取的特征向量，返回false表示连接出错；服务端拒绝的请求返回true，result.status不为OK
+    bool predict(std::span<const float> features, Result &result)
+    {
+        begin_request(prediction_protocol::RequestType::FEATURES, static_cast<uint32_t>(features.size()));
+        append(features.data(), features.size_bytes());
+        return exchange(result);
+    }
+
+    // 发送原始记录序列，由服务端提取特征
+    bool predict_records(const uint16_t *sizes, const int8_t *directions, size_t length, Result &result)
+    {
+        begin_request(prediction_protocol::RequestType::RECORDS, static_cast<uint32_t>(length));
+        append(sizes, length * sizeof(uint16_t));
+        append(directions, length * sizeof(int8_t));
+        return exchange(result);
+    }
+
+    bool info(ModelInfo &model_info)
+    {
+        begin_request(prediction_protocol::RequestType::INFO, 0);
+        prediction_protocol::ResponseHeader header;
+        if (!send_request() || !receive(header) || header.status != static_cast<uint16_t>(prediction_protocol::Status::OK) ||
+            payload.size() < 2 * sizeof(uint32_t))
+            return false;
+
+        uint32_t dims[2];
+        std::memcpy(dims, payload.data(), sizeof(dims));
+        model_info.input_dim = static_cast<int>(dims[0]);
+        model_info.sequence_length = static_cast<int>(dims[1]);
+        model_info.labels.assign(1, "");
+        for (size_t i = sizeof(dims); i < payload.size(); ++i)
+        {
+            if (payload[i] == '\n')
+                model_info.labels.emplace_back();
+            else
+                model_info.labels.back().push_back(static_cast<char>(payload[i]));
+        }
+        model_info.labels.resize(header.num_labels);
+        return true;
+    }
+
+private:
+    void begin_request(prediction_protocol::RequestType type, uint32_t count)
+    {
+        prediction_protocol::RequestHeader header{prediction_protocol::MAGIC, static_cast<uint16_t>(type), 0, next_id++, count};
+        request.clear();
+        append(&header, sizeof(header));
+    }
+
+    void append(const void *data, size_t bytes)
+    {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        request.insert(request.end(), p, p + bytes);
+    }
+
+    bool exchange(Result &result)
+    {
+        prediction_protocol::ResponseHeader header;
+        if (!send_request() || !receive(header))
+            return false;
+        result.status = static_cast<prediction_protocol::Status>(header.status);
+        result.label = header.label;
+        result.probabilities.resize(payload.size() / sizeof(float));
+        std::memcpy(result.probabilities.data(), payload.data(), result.probabilities.size() * sizeof(float));
+        return true;
+    }
+
+    bool send_request()
+    {
+        const uint8_t *data = request.data();
+        size_t left = request.size();
+        while (left > 0)
+        {
+            ssize_t n = send(fd, data, left, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return fail(strerror(errno));
+            data += n;
+            left -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool receive(prediction_protocol::ResponseHeader &header)
+    {
+        if (!read_exact(&header, sizeof(header)))
+            return false;
+        if (header.magic != prediction_protocol::MAGIC)
+            return fail("invalid response");
+        payload.resize(header.payload_bytes);
+        return read_exact(payload.data(), payload.size());
+    }
+
+    bool read_exact(void *buffer, size_t bytes)
+    {
+        uint8_t *p = static_cast<uint8_t *>(buffer);
+        while (bytes > 0)
+        {
+            ssize_t n = recv(fd, p, bytes, 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n == 0)
+                return fail("connection closed by server");
+            if (n < 0)
+                return fail(strerror(errno));
+            p += n;
+            bytes -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool fail(const char *reason)
+    {
+        std::cerr << "[ERROR] Prediction server: " << reason << std::endl;
+        disconnect();
+        return false;
+    }
+};
+
+#endif // _PREDICTION_CLIENT_HPP_
@@ -0,0 +1,548 @@
+/*
+PredictionServer是常驻的预测服务：模型只加载一次，通过Unix域套接字接收特征向量或原始记录序列，返回标签和各类别概率，
+省去每次预测启动进程、加载模型的开销。
+    - 一个线程用epoll处理所有连接，每个连接上可以连续发送多个请求，应答带回请求的id
+    - 微批处理：读完当前已到达的请求后，最多再等待batch_budget_us收集更多请求，然后做一次批量前向传播(gemm)；
+      batch达到max_batch时立即处理。batch_budget_us为0时不等待，只合并同时到达的请求
+    - 记录序列由Featurizer提取特征，与训练、predictCNN和liveClassify一致
+协议见prediction_protocol，客户端见PredictionClient.hpp。
+*/
+#ifndef _PREDICTION_SERVER_HPP_
+#define _PREDICTION_SERVER_HPP_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "SimpleCNN.hpp"
+#include "Featurizer.hpp"
+#include "Metrics.hpp"
+#include "Logger.hpp"
+
+/*
+请求和应答都是固定长度的头部加载荷，整数和float均为小端(与主机字节序相同)。
+请求载荷：FEATURES为count个float；RECORDS为count个uint16记录大小，之后是count个int8方向；INFO没有载荷。
+应答载荷：预测成功时为num_labels个float概率；INFO为uint32 input_dim、uint32 sequence_length，
+          之后是以'\n'分隔的网站名称(第i个为标签i)。出错时没有载荷
+*/
+namespace prediction_protocol
+{
+    static constexpr uint32_t MAGIC = 0x50534c54;  // "TLSP"
+    static constexpr uint32_t MAX_COUNT = 1 << 16; // 单个请求最多的特征数或记录数
+
+    enum class RequestType : uint16_t
+    {
+        FEATURES = 1, // 已提取的特征向量，长度必须等于模型的输入维度
+        RECORDS = 2,  // 原始记录序列，由服务端提取特征
+        INFO = 3      // 查询模型的维度和标签表
+    };
+
+    enum class Status : uint16_t
+    {
+        OK = 0,
+        BAD_REQUEST = 1,  // 格式错误或维度不匹配
+        INVALID_INPUT = 2 // 特征中有NaN或Inf
+    };
+
+    struct RequestHeader
+    {
+        uint32_t magic;
+        uint16_t type;
+        uint16_t reserved;
+        uint32_t id; // 客户端指定，应答原样带回
+        uint32_t count;
+    };
+
+    struct ResponseHeader
+    {
+        uint32_t magic;
+        uint16_t status;
+        uint16_t num_labels;
+        uint32_t id;
+        int32_t label; // 概率最大的标签，出错时为-1
+        uint32_t payload_bytes;
+    };
+
+    static_assert(sizeof(RequestHeader) == 16 && sizeof(ResponseHeader) == 20, "protocol headers must be packed");
+
+    // 请求载荷的字节数，类型未知时返回0
+    inline size_t payload_size(const RequestHeader &header)
+    {
+        switch (static_cast<RequestType>(header.type))
+        {
+        case RequestType::FEATURES:
+            return header.count * sizeof(float);
+        case RequestType::RECORDS:
+            return header.count * (sizeof(uint16_t) + sizeof(int8_t));
+        default:
+            return 0;
+        }
+    }
+}
+
+struct PredictionServerOptions
+{
+    std::string socket_path = "/tmp/tls_predict.sock";
+    size_t max_batch = 64;          // 一次前向传播的最大样本数
+    uint32_t batch_budget_us = 0; // 第一个请求到达后最多再等待的时间。0时只合并同时到达的请求，延迟最低；
+                                  // 客户端很多、推理成为瓶颈时加大，用延迟换更大的batch
+};
+
+// 预测服务的指标，所有PredictionServer实例共用
+struct ServerMetrics
+{
+    Counter &requests;
+    Counter &rejected;
+    Counter &batches;
+    Gauge &connections;
+    Histogram &latency;
+    Histogram &batch_time;
+
+    static ServerMetrics &get()
+    {
+        static ServerMetrics metrics = []
+        {
+            MetricsRegistry *r = MetricsRegistry::instance();
+            return ServerMetrics{
+                r->counter("tls_server_requests_total", "Prediction requests answered"),
+                r->counter("tls_server_rejected_total", "Malformed or invalid prediction requests"),
+                r->counter("tls_server_batches_total", "Batched forward passes"),
+                r->gauge("tls_server_connections", "Open client connections"),
+                r->histogram("tls_server_request_seconds", "Time from a request being read to its reply being queued"),
+                r->histogram("tls_server_batch_seconds", "Time of one batched forward pass")};
+        }();
+        return metrics;
+    }
+};
+
+class PredictionServer
+{
+public:
+    struct Stats
+    {
+        uint64_t requests = 0;
+        uint64_t rejected = 0;
+        uint64_t batches = 0;
+        uint64_t connections = 0;
+    };
+
+private:
+    static const int IDLE_POLL_MS = 200; // 没有请求时检查退出标志的间隔
+    static const size_t READ_CHUNK = 64 * 1024;
+
+    struct Connection
+    {
+        int fd = -1;
+        std::vector<uint8_t> in;  // 已读入、尚未处理的字节
+        std::vector<uint8_t> out; // 尚未写出的应答
+        size_t pending = 0;       // 已进入batch、尚未应答的请求数
+        bool closed = false;      // 对端关闭或出错，不再读取；pending为0且应答写完后释放
+        uint32_t events = EPOLLIN; // 当前在epoll中注册的事件
+    };
+
+    struct PendingRequest
+    {
+        Connection *conn;
+        uint32_t id;
+        std::chrono::steady_clock::time_point arrival;
+    };
+
+    const SimpleCNN &model;
+    PredictionServerOptions options;
+    int sequence_length;
+    std::vector<uint8_t> info_payload;
+    std::vector<uint8_t> read_buffer;
+
+    int listen_fd = -1;
+    int epoll_fd = -1;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+
+    AlignedMatrix inputs; // [max_batch x input_dim]，第i行为batch中第i个请求的特征
+    std::vector<PendingRequest> batch;
+    SimpleCNN::BatchWorkspace ws;
+    std::vector<uint16_t> record_sizes; // RECORDS请求的载荷可能未对齐，先复制出来
+    std::vector<int8_t> record_directions;
+    std::vector<Connection *> touched; // 本次flush中有应答的连接
+
+    Stats counters;
+    ServerMetrics &metrics;
+
+public:
+    PredictionServer(const SimpleCNN &model, const PredictionServerOptions &options)
+        : model(model), options(options), sequence_length(static_cast<int>(model.get_metadata().sequence_length)),
+          metrics(ServerMetrics::get())
+    {
+        this->options.max_batch = std::max<size_t>(this->options.max_batch, 1);
+        inputs.resize(this->options.max_batch, model.get_input_dim());
+        batch.reserve(this->options.max_batch);
+        read_buffer.resize(READ_CHUNK);
+
+        uint32_t dims[2] = {static_cast<uint32_t>(model.get_input_dim()), static_cast<uint32_t>(sequence_length)};
+        info_payload.assign(reinterpret_cast<const uint8_t *>(dims), reinterpret_cast<const uint8_t *>(dims) + sizeof(dims));
+        std::vector<std::string> names(model.get_num_labels());
+        for (const auto &[label, name] : model.get_metadata().labels)
+        {
+            if (label >= 0 && label < model.get_num_labels())
+                names[label] = name;
+        }
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            if (i > 0)
+                info_payload.push_back('\n');
+            info_payload.insert(info_payload.end(), names[i].begin(), names[i].end());
+        }
+    }
+
+    PredictionServer(const PredictionServer &) = delete;
+    PredictionServer &operator=(const PredictionServer &) = delete;
+
+    ~PredictionServer() { shutdown(); }
+
+    // 在socket_path上监听，已存在的套接字文件(上次未正常退出)会被删除
+    bool start()
+    {
+        sockaddr_un addr{};
+        if (options.socket_path.size() >= sizeof(addr.sun_path))
+        {
+            LOG_ERROR << "Socket path too long: " << options.socket_path;
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, options.socket_path.c_str(), options.socket_path.size() + 1);
+        unlink(options.socket_path.c_str());
+
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+            listen(listen_fd, 128) != 0)
+        {
+            LOG_ERROR << "Failed to listen on " << options.socket_path << ": " << strerror(errno);
+            shutdown();
+            return false;
+        }
+
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = listen_fd;
+        if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) != 0)
+        {
+            LOG_ERROR << "Failed to set up epoll: " << strerror(errno);
+            shutdown();
+            return false;
+        }
+        LOG_INFO << "Serving predictions on " << options.socket_path << ", max batch " << options.max_batch
+                 << ", batch budget " << options.batch_budget_us << "us";
+        return true;
+    }
+
+    // 处理请求直到running变为false，退出前应答batch中剩余的请求
+    void run(const std::atomic<bool> &running)
+    {
+        epoll_event events[64];
+        auto budget = std::chrono::microseconds(options.batch_budget_us);
+        while (running)
+        {
+            // 等待新数据：batch为空时无限等待(定期检查退出标志)，否则最多等到batch的截止时间
+            timespec timeout{0, IDLE_POLL_MS * 1000000L};
+            if (!batch.empty())
+            {
+                auto remaining = batch.front().arrival + budget - std::chrono::steady_clock::now();
+                long ns = std::max<long>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count());
+                timeout = {ns / 1000000000L, ns % 1000000000L};
+            }
+            pollfd pfd{epoll_fd, POLLIN, 0};
+            ppoll(&pfd, 1, &timeout, nullptr);
+
+            // 不阻塞地处理所有已就绪的连接
+            int n;
+            while ((n = epoll_wait(epoll_fd, events, 64, 0)) > 0)
+            {
+                for (int i = 0; i < n; ++i)
+                    handle_event(events[i]);
+                if (n < 64)
+                    break;
+            }
+
+            if (!batch.empty() && std::chrono::steady_clock::now() >= batch.front().arrival + budget)
+                flush();
+            release_closed();
+        }
+        flush();
+        release_closed();
+    }
+
+    // 关闭所有连接和监听套接字，删除套接字文件
+    void shutdown()
+    {
+        for (auto &[fd, conn] : connections)
+            close(fd);
+        connections.clear();
+        metrics.connections.set(0);
+        if (epoll_fd >= 0)
+        {
+            close(epoll_fd);
+            epoll_fd = -1;
+        }
+        if (listen_fd >= 0)
+        {
+            close(listen_fd);
+            listen_fd = -1;
+            unlink(options.socket_path.c_str());
+        }
+    }
+
+    const Stats &stats() const { return counters; }
+
+private:
+    void handle_event(const epoll_event &event)
+    {
+        if (event.data.fd == listen_fd)
+        {
+            accept_connections();
+            return;
+        }
+        auto it = connections.find(event.data.fd);
+        if (it == connections.end())
+            return;
+        Connection &conn = *it->second;
+        if (event.events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+            send_pending(conn);
+        if (event.events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            read_requests(conn);
+    }
+
+    void accept_connections()
+    {
+        int fd;
+        while ((fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+        {
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+            {
+                close(fd);
+                continue;
+            }
+            auto conn = std::make_unique<Connection>();
+            conn->fd = fd;
+            connections.emplace(fd, std::move(conn));
+            counters.connections++;
+            metrics.connections.set(static_cast<int64_t>(connections.size()));
+        }
+    }
+
+    void read_requests(Connection &conn)
+    {
+        if (conn.closed)
+            return;
+        while (true)
+        {
+            ssize_t n = recv(conn.fd, read_buffer.data(), read_buffer.size(), 0);
+            if (n > 0)
+            {
+                conn.in.insert(conn.in.end(), read_buffer.data(), read_buffer.data() + n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                conn.closed = true;
+            break;
+        }
+        parse_requests(conn);
+    }
+
+    // 处理conn.in中所有完整的请求，不完整的留到下次
+    void parse_requests(Connection &conn)
+    {
+        using namespace prediction_protocol;
+        size_t offset = 0;
+        while (conn.in.size() - offset >= sizeof(RequestHeader))
+        {
+            RequestHeader header;
+            std::memcpy(&header, conn.in.data() + offset, sizeof(header));
+            size_t payload = payload_size(header);
+            bool known_type = header.type >= static_cast<uint16_t>(RequestType::FEATURES) &&
+                              header.type <= static_cast<uint16_t>(RequestType::INFO);
+            if (header.magic != MAGIC || !known_type || header.count > MAX_COUNT)
+            {
+                // 无法找到下一个请求的边界，应答后关闭连接
+                reject(conn, header.id, Status::BAD_REQUEST);
+                conn.closed = true;
+                offset = conn.in.size();
+                break;
+            }
+            if (conn.in.size() - offset < sizeof(RequestHeader) + payload)
+                break;
+            handle_request(conn, header, conn.in.data() + offset + sizeof(RequestHeader));
+            offset += sizeof(RequestHeader) + payload;
+        }
+        conn.in.erase(conn.in.begin(), conn.in.begin() + offset);
+        send_pending(conn);
+    }
+
+    void handle_request(Connection &conn, const prediction_protocol::RequestHeader &header, const uint8_t *payload)
+    {
+        using namespace prediction_protocol;
+        auto arrival = std::chrono::steady_clock::now();
+        float *row = inputs.row(batch.size());
+        switch (static_cast<RequestType>(header.type))
+        {
+        case RequestType::INFO:
+            write_response(conn, Status::OK, header.id, -1, info_payload.data(), info_payload.size());
+            return;
+
+        case RequestType::FEATURES:
+        {
+            if (static_cast<int>(header.count) != model.get_input_dim())
+            {
+                reject(conn, header.id, Status::BAD_REQUEST);
+                return;
+            }
+            std::memcpy(row, payload, header.count * sizeof(float));
+            bool finite = std::all_of(row, row + header.count, [](float v)
+                                      { return std::isfinite(v); });
+            if (!finite)
+            {
+                reject(conn, header.id, Status::INVALID_INPUT);
+                return;
+            }
+            break;
+        }
+
+        case RequestType::RECORDS:
+            record_sizes.resize(header.count);
+            record_directions.resize(header.count);
+            std::memcpy(record_sizes.data(), payload, header.count * sizeof(uint16_t));
+            std::memcpy(record_directions.data(), payload + header.count * sizeof(uint16_t), header.count);
+            Featurizer::extract_features(record_sizes.data(), record_directions.data(), header.count, sequence_length, row);
+            break;
+        }
+
+        batch.push_back({&conn, header.id, arrival});
+        conn.pending++;
+        if (batch.size() >= options.max_batch)
+            flush();
+    }
+
+    // 对batch中的所有请求做一次前向传播并写入应答
+    void flush()
+    {
+        if (batch.empty())
+            return;
+        auto start = std::chrono::steady_clock::now();
+        const AlignedMatrix &probabilities = model.forward_batch(inputs, batch.size(), ws);
+        auto done = std::chrono::steady_clock::now();
+        metrics.batch_time.observe(done - start);
+
+        int num_labels = model.get_num_labels();
+        touched.clear();
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            const float *row = probabilities.row(i);
+            int label = static_cast<int>(std::max_element(row, row + num_labels) - row);
+            PendingRequest &request = batch[i];
+            write_response(*request.conn, prediction_protocol::Status::OK, request.id, label,
+                           reinterpret_cast<const uint8_t *>(row), num_labels * sizeof(float));
+            request.conn->pending--;
+            metrics.latency.observe(done - request.arrival);
+            if (std::find(touched.begin(), touched.end(), request.conn) == touched.end())
+                touched.push_back(request.conn);
+        }
+        counters.requests += batch.size();
+        counters.batches++;
+        metrics.requests.add(batch.size());
+        metrics.batches.add();
+        batch.clear();
+
+        for (Connection *conn : touched)
+            send_pending(*conn);
+    }
+
+    void reject(Connection &conn, uint32_t id, prediction_protocol::Status status)
+    {
+        counters.rejected++;
+        metrics.rejected.add();
+        write_response(conn, status, id, -1, nullptr, 0);
+    }
+
+    void write_response(Connection &conn, prediction_protocol::Status status, uint32_t id, int label,
+                        const uint8_t *payload, size_t payload_bytes)
+    {
+        prediction_protocol::ResponseHeader header{prediction_protocol::MAGIC, static_cast<uint16_t>(status),
+                                                   static_cast<uint16_t>(model.get_num_labels()), id, label,
+                                                   static_cast<uint32_t>(payload_bytes)};
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&header);
+        conn.out.insert(conn.out.end(), bytes, bytes + sizeof(header));
+        if (payload_bytes > 0)
+            conn.out.insert(conn.out.end(), payload, payload + payload_bytes);
+    }
+
+    // 写出conn.out，发送缓冲区满时等待EPOLLOUT；已关闭的连接不再等待EPOLLIN
+    void send_pending(Connection &conn)
+    {
+        size_t sent = 0;
+        while (sent < conn.out.size())
+        {
+            ssize_t n = send(conn.fd, conn.out.data() + sent, conn.out.size() - sent, MSG_NOSIGNAL);
+            if (n > 0)
+            {
+                sent += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            conn.closed = true; // 对端已关闭，丢弃剩余应答
+            sent = conn.out.size();
+        }
+        conn.out.erase(conn.out.begin(), conn.out.begin() + sent);
+
+        uint32_t events = (conn.closed ? 0u : uint32_t(EPOLLIN)) | (conn.out.empty() ? 0u : uint32_t(EPOLLOUT));
+        if (events != conn.events)
+        {
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.fd = conn.fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev);
+            conn.events = events;
+        }
+    }
+
+    // 释放已关闭、没有未应答请求且应答已写完的连接
+    void release_closed()
+    {
+        for (auto it = connections.begin(); it != connections.end();)
+        {
+            Connection &conn = *it->second;
+            if (conn.closed && conn.pending == 0 && conn.out.empty())
+            {
+                close(conn.fd);
+                it = connections.erase(it);
+                metrics.connections.set(static_cast<int64_t>(connections.size()));
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+};
+
+#endif // _PREDICTION_SERVER_HPP_
@@ -0,0 +1,111 @@
+/*
+QuantizedCNN是SimpleCNN的训练后int8量化版本，只用于推理。
+由已加载的float模型构造：fc1/fc2的权重按行对称量化为int8(每行一个缩放因子)，偏置保持float；
+每次前向时把该层的输入按向量动态量化为uint8，用整数点积内核(VNNI/AVX2/NEON dotprod)累加后再还原为float。
+权重体积约为float版本的1/4，模型文件格式不变，量化在加载时完成。
+*/
+#ifndef _QUANTIZED_CNN_HPP_
+#define _QUANTIZED_CNN_HPP_
+
+#include <vector>
+#include <span>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "SimpleCNN.hpp"
+#include "QuantizedKernels.hpp"
+
+class QuantizedCNN
+{
+private:
+    // 量化后的全连接层
+    struct QuantizedLayer
+    {
+        QuantizedMatrix weights;
+        std::vector<float> biases;
+
+        void quantize(const FCLayer &layer)
+        {
+            weights.quantize(layer.get_weights());
+            biases = layer.get_biases();
+        }
+    };
+
+    int input_dim;
+    int num_labels;
+    QuantizedLayer fc1;
+    QuantizedLayer fc2;
+    ModelMetadata metadata;
+
+public:
+    // 单样本推理的工作区，每个线程各用一份
+    struct InferenceWorkspace
+    {
+        AlignedBuffer input_q;  // 量化后的输入，按uint8使用
+        AlignedBuffer hidden_q; // 量化后的隐藏层输出
+        std::vector<float> hidden;
+        std::vector<float> probabilities;
+    };
+
+    explicit QuantizedCNN(const SimpleCNN &model)
+        : input_dim(model.get_input_dim()), num_labels(model.get_num_labels()), metadata(model.get_metadata())
+    {
+        fc1.quantize(model.get_hidden_layer());
+        fc2.quantize(model.get_output_layer());
+    }
+
+    InferenceWorkspace make_workspace() const
+    {
+        InferenceWorkspace ws;
+        ws.input_q.resize(QuantizedMatrix::padded(input_dim) / sizeof(float));
+        ws.hidden_q.resize(QuantizedMatrix::padded(fc1.weights.rows()) / sizeof(float));
+        ws.hidden.resize(fc1.weights.rows());
+        ws.probabilities.resize(num_labels);
+        return ws;
+    }
+
+    /*
+    @brief 前向传播，所有中间结果写入ws
+    @return 各类别的概率，指向ws内部，下一次使用ws前有效
+    */
+    std::span<const float> forward(std::span<const float> input, InferenceWorkspace &ws) const
+    {
+        if (static_cast<int>(input.size()) != input_dim)
+        {
+            throw std::runtime_error("Invalid input dimension: " + std::to_string(input.size()));
+        }
+        for (float val : input)
+        {
+            if (std::isnan(val) || std::isinf(val))
+            {
+                throw std::runtime_error("Invalid input detected");
+            }
+        }
+
+        // 第一层：input -> int8 fc1 -> relu
+        uint8_t *input_q = reinterpret_cast<uint8_t *>(ws.input_q.data());
+        float input_scale = kernels::quantize_input(input.data(), input.size(), input_q);
+        kernels::qgemv(fc1.weights, input_q, input_scale, fc1.biases.data(), ws.hidden.data());
+        Activation::relu(std::span<float>(ws.hidden));
+
+        // 输出层：hidden -> int8 fc2 -> softmax(原地)
+        uint8_t *hidden_q = reinterpret_cast<uint8_t *>(ws.hidden_q.data());
+        float hidden_scale = kernels::quantize_input(ws.hidden.data(), ws.hidden.size(), hidden_q);
+        kernels::qgemv(fc2.weights, hidden_q, hidden_scale, fc2.biases.data(), ws.probabilities.data());
+        Activation::softmax(ws.probabilities, ws.probabilities);
+        return ws.probabilities;
+    }
+
+    // 量化权重占用的内存(字节)，包括缩放因子和偏置
+    size_t weight_bytes() const
+    {
+        return fc1.weights.bytes() + fc2.weights.bytes() + (fc1.biases.size() + fc2.biases.size()) * sizeof(float);
+    }
+
+    const ModelMetadata &get_metadata() const { return metadata; }
+    int get_input_dim() const { return input_dim; }
+    int get_num_labels() const { return num_labels; }
+};
+
+#endif // _QUANTIZED_CNN_HPP_
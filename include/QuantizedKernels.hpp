@@ -0,0 +1,473 @@
+/*
+QuantizedKernels提供int8量化推理使用的矩阵存储和整数点积内核：
+    QuantizedMatrix  int8权重，每行一个缩放因子(对称量化，w ≈ scale * q)，行跨度补齐到64字节，补齐部分为0
+    quantize_input   把float输入按整个向量的最大绝对值量化为带128偏移的uint8(x ≈ scale * (q - 128))
+    qgemv            y = W * x + b，每次4行共享输入的加载，整数累加后再乘以两个缩放因子
+整数点积在所有实现中结果完全一致：sum((x[i] - 128) * w[i])。
+x86上VNNI的vpdpbusd是 uint8 x int8，直接用偏移后的输入累加，再减去 128 * 行和；
+AVX2把两边扩展为int16后用vpmaddwd；AArch64上有dotprod扩展时把输入异或0x80变回int8后使用sdot。
+*/
+#ifndef _QUANTIZED_KERNELS_HPP_
+#define _QUANTIZED_KERNELS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "MatrixKernels.hpp"
+
+// int8行主序矩阵，每行起始地址64字节对齐
+class QuantizedMatrix
+{
+public:
+    static constexpr size_t STRIDE_ALIGN = 64; // 64个int8 = 一条缓存行/一个AVX-512寄存器
+
+private:
+    size_t num_rows = 0;
+    size_t num_cols = 0;
+    size_t row_stride = 0;
+    AlignedBuffer storage;             // 按float分配以复用64字节对齐的缓冲区
+    std::vector<float> row_scales;     // 每行的缩放因子
+    std::vector<int32_t> row_sums;     // 每行量化权重之和，VNNI内核用于扣除输入的128偏移
+
+public:
+    QuantizedMatrix() = default;
+
+    static size_t padded(size_t cols) { return (cols + STRIDE_ALIGN - 1) / STRIDE_ALIGN * STRIDE_ALIGN; }
+
+    // 按行对称量化：scale = max|w| / 127
+    void quantize(const AlignedMatrix &weights)
+    {
+        num_rows = weights.rows();
+        num_cols = weights.cols();
+        row_stride = padded(num_cols);
+        storage.resize((num_rows * row_stride + sizeof(float) - 1) / sizeof(float));
+        std::memset(storage.data(), 0, storage.size() * sizeof(float));
+        row_scales.assign(num_rows, 0.0f);
+        row_sums.assign(num_rows, 0);
+
+        for (size_t r = 0; r < num_rows; ++r)
+        {
+            const float *w = weights.row(r);
+            float max_abs = 0.0f;
+            for (size_t c = 0; c < num_cols; ++c)
+                max_abs = std::max(max_abs, std::fabs(w[c]));
+            float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+            row_scales[r] = scale;
+
+            int8_t *q = row(r);
+            int32_t sum = 0;
+            for (size_t c = 0; c < num_cols; ++c)
+            {
+                int v = static_cast<int>(std::lround(w[c] / scale));
+                q[c] = static_cast<int8_t>(std::clamp(v, -127, 127));
+                sum += q[c];
+            }
+            row_sums[r] = sum;
+        }
+    }
+
+    size_t rows() const { return num_rows; }
+    size_t cols() const { return num_cols; }
+    size_t stride() const { return row_stride; }
+    int8_t *row(size_t r) { return reinterpret_cast<int8_t *>(storage.data()) + r * row_stride; }
+    const int8_t *row(size_t r) const { return reinterpret_cast<const int8_t *>(storage.data()) + r * row_stride; }
+    float scale(size_t r) const { return row_scales[r]; }
+    int32_t row_sum(size_t r) const { return row_sums[r]; }
+    const int32_t *row_sums_data() const { return row_sums.data(); }
+    size_t bytes() const { return num_rows * row_stride + num_rows * (sizeof(float) + sizeof(int32_t)); }
+};
+
+namespace kernels
+{
+    enum class QuantIsa
+    {
+        SCALAR,
+        AVX2,
+        AVX_VNNI,
+        AVX512_VNNI,
+        NEON_DOTPROD
+    };
+
+    inline const char *quant_isa_name(QuantIsa isa)
+    {
+        switch (isa)
+        {
+        case QuantIsa::AVX2:
+            return "AVX2";
+        case QuantIsa::AVX_VNNI:
+            return "AVX-VNNI";
+        case QuantIsa::AVX512_VNNI:
+            return "AVX-512 VNNI";
+        case QuantIsa::NEON_DOTPROD:
+            return "NEON dotprod";
+        default:
+            return "scalar";
+        }
+    }
+
+    // sum((x[i] - 128) * w[i])，n为补齐后的长度(64的整数倍)，补齐部分的w为0
+    using QDotFn = int32_t (*)(const int8_t *w, const uint8_t *x, size_t n, int32_t row_sum);
+    // 同时计算连续4行，行跨度为stride，row_sums指向这4行的行和
+    using QDot4Fn = void (*)(const int8_t *w, size_t stride, const uint8_t *x, size_t n, const int32_t *row_sums, int32_t *out);
+    // 量化长度为n的输入，返回缩放因子，见quantize_input
+    using QuantizeFn = float (*)(const float *x, size_t n, uint8_t *q);
+
+    inline int32_t qdot_scalar(const int8_t *w, const uint8_t *x, size_t n, int32_t)
+    {
+        int32_t sum = 0;
+        for (size_t i = 0; i < n; ++i)
+            sum += (static_cast<int32_t>(x[i]) - 128) * w[i];
+        return sum;
+    }
+
+    inline void qdot4_scalar(const int8_t *w, size_t stride, const uint8_t *x, size_t n, const int32_t *row_sums, int32_t *out)
+    {
+        for (size_t k = 0; k < 4; ++k)
+            out[k] = qdot_scalar(w + k * stride, x, n, row_sums[k]);
+    }
+
+    inline float input_scale(float max_abs) { return max_abs > 0.0f ? max_abs / 127.0f : 1.0f; }
+
+    inline float quantize_scalar(const float *x, size_t n, uint8_t *q)
+    {
+        float max_abs = 0.0f;
+        for (size_t i = 0; i < n; ++i)
+            max_abs = std::max(max_abs, std::fabs(x[i]));
+        float scale = input_scale(max_abs);
+        float inv_scale = 1.0f / scale;
+        for (size_t i = 0; i < n; ++i)
+        {
+            // |x * inv_scale| <= 127，加128.5后截断即为四舍五入
+            float v = std::clamp(x[i] * inv_scale + 128.5f, 1.0f, 255.0f);
+            q[i] = static_cast<uint8_t>(static_cast<int>(v));
+        }
+        return scale;
+    }
+
+#if defined(TLS_KERNELS_X86)
+    __attribute__((target("avx2"))) inline int32_t hsum256_epi32(__m256i v)
+    {
+        __m128i lo = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+        lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(lo);
+    }
+
+    // 扩展为int16后相乘并两两相加，不会像vpmaddubsw那样饱和
+    __attribute__((target("avx2"))) inline int32_t qdot_avx2(const int8_t *w, const uint8_t *x, size_t n, int32_t)
+    {
+        const __m256i offset = _mm256_set1_epi16(128);
+        __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+        for (size_t i = 0; i < n; i += 32)
+        {
+            __m128i x0 = _mm_load_si128(reinterpret_cast<const __m128i *>(x + i));
+            __m128i x1 = _mm_load_si128(reinterpret_cast<const __m128i *>(x + i + 16));
+            __m128i w0 = _mm_load_si128(reinterpret_cast<const __m128i *>(w + i));
+            __m128i w1 = _mm_load_si128(reinterpret_cast<const __m128i *>(w + i + 16));
+            __m256i xs0 = _mm256_sub_epi16(_mm256_cvtepu8_epi16(x0), offset);
+            __m256i xs1 = _mm256_sub_epi16(_mm256_cvtepu8_epi16(x1), offset);
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(xs0, _mm256_cvtepi8_epi16(w0)));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(xs1, _mm256_cvtepi8_epi16(w1)));
+        }
+        return hsum256_epi32(_mm256_add_epi32(acc0, acc1));
+    }
+
+    __attribute__((target("avx2"))) inline void qdot4_avx2(const int8_t *w, size_t stride, const uint8_t *x, size_t n,
+                                                           const int32_t *, int32_t *out)
+    {
+        const __m256i offset = _mm256_set1_epi16(128);
+        __m256i acc[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+        for (size_t i = 0; i < n; i += 16)
+        {
+            __m256i xs = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_load_si128(reinterpret_cast<const __m128i *>(x + i))), offset);
+            for (size_t k = 0; k < 4; ++k)
+            {
+                __m256i wv = _mm256_cvtepi8_epi16(_mm_load_si128(reinterpret_cast<const __m128i *>(w + k * stride + i)));
+                acc[k] = _mm256_add_epi32(acc[k], _mm256_madd_epi16(xs, wv));
+            }
+        }
+        for (size_t k = 0; k < 4; ++k)
+            out[k] = hsum256_epi32(acc[k]);
+    }
+
+    // 8个float -> 8个int32，先乘后加(不用FMA)，结果与标量实现逐位一致
+    __attribute__((target("avx2"))) inline __m256i quantize8_avx2(const float *p, __m256 inv)
+    {
+        __m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(p), inv), _mm256_set1_ps(128.5f));
+        return _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(1.0f)), _mm256_set1_ps(255.0f)));
+    }
+
+    __attribute__((target("avx2"))) inline float quantize_avx2(const float *x, size_t n, uint8_t *q)
+    {
+        const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        __m256 max_v = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+            max_v = _mm256_max_ps(max_v, _mm256_and_ps(_mm256_loadu_ps(x + i), abs_mask));
+        __m128 m = _mm_max_ps(_mm256_castps256_ps128(max_v), _mm256_extractf128_ps(max_v, 1));
+        m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+        m = _mm_max_ss(m, _mm_movehdup_ps(m));
+        float max_abs = _mm_cvtss_f32(m);
+        for (size_t j = i; j < n; ++j)
+            max_abs = std::max(max_abs, std::fabs(x[j]));
+
+        float scale = input_scale(max_abs);
+        const __m256 inv = _mm256_set1_ps(1.0f / scale);
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7); // 还原两次pack打乱的顺序
+        i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i p01 = _mm256_packs_epi32(quantize8_avx2(x + i, inv), quantize8_avx2(x + i + 8, inv));
+            __m256i p23 = _mm256_packs_epi32(quantize8_avx2(x + i + 16, inv), quantize8_avx2(x + i + 24, inv));
+            __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(p01, p23), order);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(q + i), bytes);
+        }
+        float inv_scale = 1.0f / scale;
+        for (; i < n; ++i)
+            q[i] = static_cast<uint8_t>(static_cast<int>(std::clamp(x[i] * inv_scale + 128.5f, 1.0f, 255.0f)));
+        return scale;
+    }
+
+    __attribute__((target("avx2,avxvnni"))) inline int32_t qdot_avx_vnni(const int8_t *w, const uint8_t *x, size_t n,
+                                                                         int32_t row_sum)
+    {
+        __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+        for (size_t i = 0; i < n; i += 64)
+        {
+            acc0 = _mm256_dpbusd_avx_epi32(acc0, _mm256_load_si256(reinterpret_cast<const __m256i *>(x + i)),
+                                           _mm256_load_si256(reinterpret_cast<const __m256i *>(w + i)));
+            acc1 = _mm256_dpbusd_avx_epi32(acc1, _mm256_load_si256(reinterpret_cast<const __m256i *>(x + i + 32)),
+                                           _mm256_load_si256(reinterpret_cast<const __m256i *>(w + i + 32)));
+        }
+        return hsum256_epi32(_mm256_add_epi32(acc0, acc1)) - 128 * row_sum;
+    }
+
+    __attribute__((target("avx2,avxvnni"))) inline void qdot4_avx_vnni(const int8_t *w, size_t stride, const uint8_t *x, size_t n,
+                                                                      const int32_t *row_sums, int32_t *out)
+    {
+        __m256i acc[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+        for (size_t i = 0; i < n; i += 32)
+        {
+            __m256i xv = _mm256_load_si256(reinterpret_cast<const __m256i *>(x + i));
+            for (size_t k = 0; k < 4; ++k)
+                acc[k] = _mm256_dpbusd_avx_epi32(acc[k], xv, _mm256_load_si256(reinterpret_cast<const __m256i *>(w + k * stride + i)));
+        }
+        for (size_t k = 0; k < 4; ++k)
+            out[k] = hsum256_epi32(acc[k]) - 128 * row_sums[k];
+    }
+
+    // 与hsum512相同，避开GCC 12中_mm512_reduce_*的未初始化误报：用全1掩码的maskz形式取出高低256位再归约
+    __attribute__((target("avx512f"))) inline int32_t hsum512_epi32(__m512i v)
+    {
+        return hsum256_epi32(_mm256_add_epi32(_mm512_maskz_extracti64x4_epi64(0xF, v, 0), _mm512_maskz_extracti64x4_epi64(0xF, v, 1)));
+    }
+
+    __attribute__((target("avx512f"))) inline float hmax512(__m512 v)
+    {
+        __m512d d = _mm512_castps_pd(v);
+        __m256 m = _mm256_max_ps(_mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, d, 0)),
+                                 _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, d, 1)));
+        __m128 lo = _mm_max_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+        lo = _mm_max_ps(lo, _mm_movehl_ps(lo, lo));
+        lo = _mm_max_ss(lo, _mm_movehdup_ps(lo));
+        return _mm_cvtss_f32(lo);
+    }
+
+    __attribute__((target("avx512f,avx512bw,avx512vnni"))) inline int32_t qdot_avx512_vnni(const int8_t *w, const uint8_t *x,
+                                                                                           size_t n, int32_t row_sum)
+    {
+        __m512i acc = _mm512_setzero_si512();
+        for (size_t i = 0; i < n; i += 64)
+            acc = _mm512_dpbusd_epi32(acc, _mm512_load_si512(x + i), _mm512_load_si512(w + i));
+        return hsum512_epi32(acc) - 128 * row_sum;
+    }
+
+    __attribute__((target("avx512f,avx512bw,avx512vnni"))) inline void qdot4_avx512_vnni(const int8_t *w, size_t stride,
+                                                                                         const uint8_t *x, size_t n,
+                                                                                         const int32_t *row_sums, int32_t *out)
+    {
+        __m512i acc[4] = {_mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512()};
+        for (size_t i = 0; i < n; i += 64)
+        {
+            __m512i xv = _mm512_load_si512(x + i);
+            for (size_t k = 0; k < 4; ++k)
+                acc[k] = _mm512_dpbusd_epi32(acc[k], xv, _mm512_load_si512(w + k * stride + i));
+        }
+        for (size_t k = 0; k < 4; ++k)
+            out[k] = hsum512_epi32(acc[k]) - 128 * row_sums[k];
+    }
+
+    // x * inv + 128.5截断并限制在[1, 255]后按mask写出；全部使用全1掩码的maskz形式，
+    // GCC 12中不带掩码的max/min/cvt同样以undefined为直通操作数，会误报未初始化
+    __attribute__((target("avx512f"))) inline void quantize16_avx512(__m512 x, __m512 inv, __mmask16 mask, uint8_t *q)
+    {
+        const __mmask16 all = 0xFFFF;
+        __m512 v = _mm512_add_ps(_mm512_mul_ps(x, inv), _mm512_set1_ps(128.5f));
+        v = _mm512_maskz_min_ps(all, _mm512_maskz_max_ps(all, v, _mm512_set1_ps(1.0f)), _mm512_set1_ps(255.0f));
+        _mm512_mask_cvtepi32_storeu_epi8(q, mask, _mm512_maskz_cvttps_epi32(all, v));
+    }
+
+    __attribute__((target("avx512f,avx512bw,avx512vnni"))) inline float quantize_avx512(const float *x, size_t n, uint8_t *q)
+    {
+        const __mmask16 all = 0xFFFF; // 同quantize16_avx512，避开不带掩码的max
+        __m512 max_v = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+            max_v = _mm512_maskz_max_ps(all, max_v, _mm512_abs_ps(_mm512_loadu_ps(x + i)));
+        __mmask16 tail = static_cast<__mmask16>((1u << (n - i)) - 1);
+        if (i < n) // 尾部用掩码加载，不会越界读取
+            max_v = _mm512_maskz_max_ps(all, max_v, _mm512_abs_ps(_mm512_maskz_loadu_ps(tail, x + i)));
+
+        float scale = input_scale(hmax512(max_v));
+        const __m512 inv = _mm512_set1_ps(1.0f / scale);
+        for (i = 0; i + 16 <= n; i += 16)
+            quantize16_avx512(_mm512_loadu_ps(x + i), inv, all, q + i);
+        if (i < n)
+            quantize16_avx512(_mm512_maskz_loadu_ps(tail, x + i), inv, tail, q + i);
+        return scale;
+    }
+#endif
+
+#if defined(TLS_KERNELS_NEON) && defined(__ARM_FEATURE_DOTPROD)
+    inline int32_t qdot_neon_dotprod(const int8_t *w, const uint8_t *x, size_t n, int32_t)
+    {
+        const uint8x16_t flip = vdupq_n_u8(0x80);
+        int32x4_t acc0 = vdupq_n_s32(0), acc1 = vdupq_n_s32(0);
+        for (size_t i = 0; i < n; i += 32)
+        {
+            int8x16_t x0 = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(x + i), flip)); // x - 128
+            int8x16_t x1 = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(x + i + 16), flip));
+            acc0 = vdotq_s32(acc0, x0, vld1q_s8(w + i));
+            acc1 = vdotq_s32(acc1, x1, vld1q_s8(w + i + 16));
+        }
+        return vaddvq_s32(vaddq_s32(acc0, acc1));
+    }
+
+    inline void qdot4_neon_dotprod(const int8_t *w, size_t stride, const uint8_t *x, size_t n, const int32_t *row_sums, int32_t *out)
+    {
+        for (size_t k = 0; k < 4; ++k)
+            out[k] = qdot_neon_dotprod(w + k * stride, x, n, row_sums[k]);
+    }
+#endif
+
+    struct QuantDispatch
+    {
+        QuantIsa isa = QuantIsa::SCALAR;
+        QDotFn qdot = qdot_scalar;
+        QDot4Fn qdot4 = qdot4_scalar;
+        QuantizeFn quantize = quantize_scalar;
+    };
+
+    inline bool quant_isa_supported(QuantIsa isa)
+    {
+        switch (isa)
+        {
+        case QuantIsa::SCALAR:
+            return true;
+#if defined(TLS_KERNELS_X86)
+        case QuantIsa::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+        case QuantIsa::AVX_VNNI:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avxvnni");
+        case QuantIsa::AVX512_VNNI:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512bw");
+#endif
+#if defined(TLS_KERNELS_NEON) && defined(__ARM_FEATURE_DOTPROD)
+        case QuantIsa::NEON_DOTPROD:
+            return true;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    inline QuantDispatch make_quant_dispatch(QuantIsa isa)
+    {
+        QuantDispatch d;
+        if (!quant_isa_supported(isa))
+            return d;
+        switch (isa)
+        {
+#if defined(TLS_KERNELS_X86)
+        case QuantIsa::AVX2:
+            d = QuantDispatch{isa, qdot_avx2, qdot4_avx2, quantize_avx2};
+            break;
+        case QuantIsa::AVX_VNNI:
+            d = QuantDispatch{isa, qdot_avx_vnni, qdot4_avx_vnni, quantize_avx2};
+            break;
+        case QuantIsa::AVX512_VNNI:
+            d = QuantDispatch{isa, qdot_avx512_vnni, qdot4_avx512_vnni, quantize_avx512};
+            break;
+#endif
+#if defined(TLS_KERNELS_NEON) && defined(__ARM_FEATURE_DOTPROD)
+        case QuantIsa::NEON_DOTPROD:
+            d = QuantDispatch{isa, qdot_neon_dotprod, qdot4_neon_dotprod, quantize_scalar};
+            break;
+#endif
+        default:
+            break;
+        }
+        return d;
+    }
+
+    inline QuantIsa best_quant_isa()
+    {
+        for (QuantIsa isa : {QuantIsa::AVX512_VNNI, QuantIsa::AVX_VNNI, QuantIsa::NEON_DOTPROD, QuantIsa::AVX2})
+        {
+            if (quant_isa_supported(isa))
+                return isa;
+        }
+        return QuantIsa::SCALAR;
+    }
+
+    inline QuantDispatch &quant_dispatch()
+    {
+        static QuantDispatch d = make_quant_dispatch(best_quant_isa());
+        return d;
+    }
+
+    // 强制使用指定的整数内核(用于对比结果)，CPU不支持时退回标量实现
+    inline void force_quant_isa(QuantIsa isa) { quant_dispatch() = make_quant_dispatch(isa); }
+
+    inline QuantIsa current_quant_isa() { return quant_dispatch().isa; }
+
+    /*
+    @brief 把x量化为带128偏移的uint8，q的长度为QuantizedMatrix::padded(n)，补齐部分写为128(即0)
+    @return 缩放因子scale，x[i] ≈ scale * (q[i] - 128)
+    */
+    inline float quantize_input(const float *x, size_t n, uint8_t *q)
+    {
+        float scale = quant_dispatch().quantize(x, n, q);
+        std::fill(q + n, q + QuantizedMatrix::padded(n), static_cast<uint8_t>(128));
+        return scale;
+    }
+
+    // y = W * x + bias，xq为quantize_input的结果
+    inline void qgemv(const QuantizedMatrix &w, const uint8_t *xq, float x_scale, const float *bias, float *y)
+    {
+        const QuantDispatch &d = quant_dispatch();
+        size_t rows = w.rows(), n = w.stride();
+        int32_t acc[4];
+        size_t r = 0;
+        for (; r + 4 <= rows; r += 4)
+        {
+            d.qdot4(w.row(r), n, xq, n, w.row_sums_data() + r, acc);
+            for (size_t k = 0; k < 4; ++k)
+                y[r + k] = static_cast<float>(acc[k]) * (w.scale(r + k) * x_scale) + (bias ? bias[r + k] : 0.0f);
+        }
+        for (; r < rows; ++r)
+        {
+            int32_t sum = d.qdot(w.row(r), xq, n, w.row_sum(r));
+            y[r] = static_cast<float>(sum) * (w.scale(r) * x_scale) + (bias ? bias[r] : 0.0f);
+        }
+    }
+}
+
+#endif // _QUANTIZED_KERNELS_HPP_
@@ -0,0 +1,274 @@
+/*
+SessionDemux从一次采集的抓包环(tcpdump -C/-W 轮转的若干个大文件)中按会话日志分离出每个会话的TLS记录序列，
+直接写入TLSTraceStore，不再为每个会话生成一个小pcap文件：
+    - 数据包按 客户端端口 + 服务器地址/端口 匹配会话，时间戳必须落在会话的[start - 1s, end + 2s]内，
+      同一个本地端口被先后复用时按时间区分
+    - 会话的方向由会话日志确定(从客户端端口发出的为0)，TLS记录边界的判断与Parser相同(TLSStreamDecoder)
+    - 标签为会话域名对应的网站名称，trace的文件名为 <采集目录>/<start_us>_<port>
+    - 设置了记录预算时，每个会话只保留前record_budget条记录，之后该会话的包不再做TLS解码
+
+采集目录结构：
+    <capture_root>/<timestamp>/ring.pcap0, ring.pcap1, ...   抓包环，按第一个数据包的时间排序后顺序读取
+    <capture_root>/<timestamp>/sessions.csv                  会话日志(SessionLog)
+*/
+#ifndef _SESSION_DEMUX_HPP_
+#define _SESSION_DEMUX_HPP_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "PcapReader.hpp"
+#include "TLSStreamDecoder.hpp"
+#include "TLSTraceStore.hpp"
+#include "SessionLog.hpp"
+#include "LabelMap.hpp"
+#include "Logger.hpp"
+
+class SessionDemux
+{
+public:
+    static inline const std::string RING_PREFIX = "ring.pcap";
+    static inline const std::string SESSION_LOG = "sessions.csv";
+
+private:
+    static const uint64_t LEAD_US = 1000000;  // 会话开始前1s内的包也计入(时钟误差)
+    static const uint64_t TRAIL_US = 2000000; // 会话结束后2s内的包也计入(FIN/RST)
+
+    // 一个会话的匹配条件和解析状态
+    struct Session
+    {
+        const SessionRecord *record = nullptr;
+        std::string site_name;
+        uint8_t server_addr[4]{};
+        TLSStreamDecoder::StreamState streams[2]; // 客户端->服务端 和 服务端->客户端
+        std::vector<uint16_t> sizes;
+        std::vector<int8_t> directions;
+        std::vector<int8_t> handshake_types;
+        size_t packets = 0;
+    };
+
+    std::vector<SessionRecord> records;
+    std::vector<Session> sessions;
+    std::unordered_map<uint16_t, std::vector<Session *>> by_port; // 客户端端口 -> 会话(按开始时间排序)
+    TCPPacket tcp;
+    size_t total_packets = 0;
+    size_t matched_packets = 0;
+    size_t record_budget = 0; // 每个会话最多保留的记录数，0表示不限制
+
+public:
+    // 只分离成功的会话
+    explicit SessionDemux(std::vector<SessionRecord> session_records, size_t record_budget = 0)
+        : records(std::move(session_records)), record_budget(record_budget)
+    {
+        sessions.reserve(records.size());
+        for (const SessionRecord &record : records)
+        {
+            Session session;
+            if (!record.ok || inet_pton(AF_INET, record.server_addr.c_str(), session.server_addr) != 1)
+                continue;
+            session.record = &record;
+            session.site_name = LabelMap::site_name_from_domain(record.domain);
+            sessions.push_back(std::move(session));
+        }
+        for (Session &session : sessions)
+            by_port[session.record->client_port].push_back(&session);
+        for (auto &entry : by_port)
+        {
+            std::sort(entry.second.begin(), entry.second.end(), [](const Session *a, const Session *b)
+                      { return a->record->start_us < b->record->start_us; });
+        }
+    }
+
+    SessionDemux(const SessionDemux &) = delete;
+    SessionDemux &operator=(const SessionDemux &) = delete;
+
+    // 把一个数据包分配给所属的会话，不属于任何会话的包被忽略
+    void process(const RawPacket &raw)
+    {
+        total_packets++;
+        if (!PacketDecoder::decode_tcp(raw, tcp) || tcp.ip_version != 4)
+            return;
+
+        bool from_client = true;
+        Session *session = match(tcp.src_port, tcp.dst_port, tcp.dst_addr, raw.timestamp_us);
+        if (!session)
+        {
+            from_client = false;
+            session = match(tcp.dst_port, tcp.src_port, tcp.src_addr, raw.timestamp_us);
+        }
+        if (!session)
+            return;
+        matched_packets++;
+        session->packets++;
+        if (record_budget > 0 && session->sizes.size() >= record_budget)
+            return;
+
+        TLSPacketInfo info = TLSStreamDecoder::process(tcp, session->streams[from_client ? 0 : 1]);
+        if (!info.is_tls)
+            return;
+        session->sizes.push_back(static_cast<uint16_t>(std::min<uint32_t>(raw.origlen, TLSTraceStore::MAX_SIZE)));
+        session->directions.push_back(from_client ? 0 : 1);
+        session->handshake_types.push_back(static_cast<int8_t>(info.tls_handshake_type));
+    }
+
+    bool process_file(const std::string &pcap_file)
+    {
+        PcapReader reader;
+        if (!reader.open(pcap_file))
+        {
+            LOG_ERROR << "Failed to open capture file: " << pcap_file;
+            return false;
+        }
+        RawPacket raw;
+        while (reader.next(raw))
+            process(raw);
+        return true;
+    }
+
+    /*
+    @brief 把所有会话按 网站 -> 开始时间 的顺序写入store，没有TLS记录的会话被丢弃
+    @param trace_prefix trace文件名的前缀，通常为采集目录名
+    @return 写入的trace数
+    */
+    size_t finish(TLSTraceStore &store, const std::string &trace_prefix) const
+    {
+        std::vector<const Session *> order;
+        for (const Session &session : sessions)
+            order.push_back(&session);
+        std::sort(order.begin(), order.end(), [](const Session *a, const Session *b)
+                  { return a->site_name != b->site_name ? a->site_name < b->site_name
+                                                        : a->record->start_us < b->record->start_us; });
+
+        size_t written = 0, missing = 0;
+        for (const Session *session : order)
+        {
+            if (session->sizes.empty())
+            {
+                missing++;
+                continue;
+            }
+            const SessionRecord &r = *session->record;
+            store.begin_trace(session->site_name, trace_prefix + "/" + std::to_string(r.start_us) + "_" + std::to_string(r.client_port));
+            for (size_t i = 0; i < session->sizes.size(); ++i)
+            {
+                store.push_record(session->sizes[i], session->handshake_types[i], session->directions[i],
+                                  session->directions[i] == 0 ? r.client_addr : r.server_addr,
+                                  session->directions[i] == 0 ? r.server_addr : r.client_addr);
+            }
+            store.end_trace();
+            written++;
+        }
+
+        LOG_INFO << "Demultiplexed " << matched_packets << "/" << total_packets << " packets into " << written
+                 << " sessions"
+                 << (missing > 0 ? ", " + std::to_string(missing) + " sessions without TLS records (lost to ring rotation?)" : "");
+        return written;
+    }
+
+    /*
+    @brief 分离一个采集目录(抓包环 + 会话日志)中的所有会话并写入store
+    @return 写入的trace数
+    */
+    static size_t demux_capture(const std::string &capture_dir, TLSTraceStore &store, size_t record_budget = 0)
+    {
+        std::vector<SessionRecord> session_records;
+        if (!SessionLog::read(capture_dir + "/" + SESSION_LOG, session_records))
+            return 0;
+
+        std::vector<std::string> ring = list_ring_files(capture_dir);
+        if (ring.empty())
+        {
+            LOG_WARN << "No capture files found in " << capture_dir;
+            return 0;
+        }
+        LOG_INFO << "Demultiplexing " << session_records.size() << " sessions from " << ring.size()
+                 << " capture files in " << capture_dir;
+
+        SessionDemux demux(std::move(session_records), record_budget);
+        for (const std::string &file : ring)
+            demux.process_file(file);
+
+        std::string prefix = capture_dir.substr(capture_dir.find_last_of('/') + 1);
+        return demux.finish(store, prefix);
+    }
+
+    // capture_root下所有含会话日志的采集目录，按名称(即采集开始时间)排序
+    static std::vector<std::string> list_capture_dirs(const std::string &capture_root)
+    {
+        std::vector<std::string> capture_dirs;
+        DIR *dir = opendir(capture_root.c_str());
+        if (!dir)
+            return capture_dirs;
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            std::string name = entry->d_name;
+            if (name == "." || name == "..")
+                continue;
+            std::string path = capture_root + "/" + name;
+            if (access((path + "/" + SESSION_LOG).c_str(), R_OK) == 0)
+                capture_dirs.push_back(path);
+        }
+        closedir(dir);
+        std::sort(capture_dirs.begin(), capture_dirs.end());
+        return capture_dirs;
+    }
+
+private:
+    Session *match(uint16_t client_port, uint16_t server_port, const uint8_t *server_addr, uint64_t ts)
+    {
+        auto it = by_port.find(client_port);
+        if (it == by_port.end())
+            return nullptr;
+        for (Session *session : it->second)
+        {
+            const SessionRecord &r = *session->record;
+            if (r.start_us > ts + LEAD_US)
+                break;
+            if (r.server_port == server_port && std::memcmp(session->server_addr, server_addr, 4) == 0 &&
+                ts <= r.end_us + TRAIL_US)
+                return session;
+        }
+        return nullptr;
+    }
+
+    // 抓包环中的文件按第一个数据包的时间排序(环形覆盖后文件编号不再代表先后顺序)
+    static std::vector<std::string> list_ring_files(const std::string &capture_dir)
+    {
+        std::vector<std::pair<uint64_t, std::string>> files;
+        DIR *dir = opendir(capture_dir.c_str());
+        if (!dir)
+        {
+            LOG_ERROR << "Failed to open capture directory: " << capture_dir;
+            return {};
+        }
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            std::string file_name = entry->d_name;
+            if (file_name.compare(0, RING_PREFIX.size(), RING_PREFIX) != 0)
+                continue;
+            std::string path = capture_dir + "/" + file_name;
+            PcapReader reader;
+            RawPacket first;
+            if (reader.open(path) && reader.next(first))
+                files.emplace_back(first.timestamp_us, path);
+        }
+        closedir(dir);
+
+        std::sort(files.begin(), files.end());
+        std::vector<std::string> paths;
+        for (auto &file : files)
+            paths.push_back(std::move(file.second));
+        return paths;
+    }
+};
+
+#endif // _SESSION_DEMUX_HPP_
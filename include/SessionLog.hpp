@@ -0,0 +1,91 @@
+/*
+SessionLog记录流量生成器发起的每一次TLS会话：域名、五元组和起止时间。
+抓包时只运行一个长期的tcpdump，事后按会话日志中的五元组和时间范围把数据包分配到各个会话(见SessionDemux)，
+会话的标签即其域名对应的网站名称。
+
+文件格式(csv)：
+    domain,client_addr,client_port,server_addr,server_port,start_us,end_us,bytes,status
+*/
+#ifndef _SESSION_LOG_HPP_
+#define _SESSION_LOG_HPP_
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+
+struct SessionRecord
+{
+    std::string domain;
+    std::string client_addr; // 本地地址(点分十进制)
+    uint16_t client_port = 0;
+    std::string server_addr;
+    uint16_t server_port = 0;
+    uint64_t start_us = 0; // 开始connect的时间(CLOCK_REALTIME，与抓包时间戳相同)
+    uint64_t end_us = 0;   // 连接关闭的时间
+    size_t bytes = 0;      // 收到的应用层数据字节数
+    bool ok = false;       // 是否完成了握手并收到了响应
+};
+
+class SessionLog
+{
+public:
+    static bool write(const std::string &path, const std::vector<SessionRecord> &records)
+    {
+        std::ofstream ofs(path);
+        if (!ofs.is_open())
+        {
+            std::cerr << "[ERROR] Failed to write session log: " << path << std::endl;
+            return false;
+        }
+        ofs << "domain,client_addr,client_port,server_addr,server_port,start_us,end_us,bytes,status\n";
+        for (const SessionRecord &r : records)
+        {
+            ofs << r.domain << "," << r.client_addr << "," << r.client_port << "," << r.server_addr << ","
+                << r.server_port << "," << r.start_us << "," << r.end_us << "," << r.bytes << ","
+                << (r.ok ? "ok" : "failed") << "\n";
+        }
+        return static_cast<bool>(ofs);
+    }
+
+    static bool read(const std::string &path, std::vector<SessionRecord> &records)
+    {
+        std::ifstream ifs(path);
+        if (!ifs.is_open())
+        {
+            std::cerr << "[ERROR] Failed to open session log: " << path << std::endl;
+            return false;
+        }
+
+        std::string line;
+        std::getline(ifs, line); // 跳过header
+        while (std::getline(ifs, line))
+        {
+            std::vector<std::string> fields;
+            std::istringstream iss(line);
+            std::string field;
+            while (std::getline(iss, field, ','))
+                fields.push_back(field);
+            if (fields.size() != 9)
+                continue;
+
+            SessionRecord r;
+            r.domain = fields[0];
+            r.client_addr = fields[1];
+            r.client_port = static_cast<uint16_t>(std::atoi(fields[2].c_str()));
+            r.server_addr = fields[3];
+            r.server_port = static_cast<uint16_t>(std::atoi(fields[4].c_str()));
+            r.start_us = std::strtoull(fields[5].c_str(), nullptr, 10);
+            r.end_us = std::strtoull(fields[6].c_str(), nullptr, 10);
+            r.bytes = std::strtoull(fields[7].c_str(), nullptr, 10);
+            r.ok = fields[8] == "ok";
+            records.push_back(r);
+        }
+        return true;
+    }
+};
+
+#endif // _SESSION_LOG_HPP_
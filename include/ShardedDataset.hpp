@@ -0,0 +1,307 @@
+/*
+ShardedDataset把二进制数据集(FeatureDataset)拆成N个可以独立加载的分片，用于多台机器分别预处理、集中训练：
+    - 样本按所属pcap的键(网站名/文件名)的哈希值分到分片，同一个pcap在任何节点、任何一次运行中都落在同一个分片
+    - 每个分片是一个完整的FeatureDataset文件(自带标签表)，先写临时文件再rename
+    - 所有分片写完后最后写清单manifest.txt，记录标签表和每个分片的样本数、记录数
+
+目录布局：
+    <dir>/manifest.txt
+    <dir>/shard-00000-of-00004.bin ... shard-00003-of-00004.bin
+
+清单为文本格式，每行一项：
+    TLSSHARDS 1                       魔数和版本
+    shards 4                          分片数
+    label <label> <site_name>         标签表，与各分片的标签表相同
+    shard <file> <samples> <records>  分片文件(相对清单所在目录)及其样本数、记录数
+
+训练时可以同时读取多个目录(多个节点的输出)：还没有清单的目录说明该节点仍在预处理，跳过；
+清单中列出但缺失的分片也跳过，因此可以先用已经完成的分片开始训练。
+各清单的标签表必须一致(都来自同一个domain_list.txt)，否则抛出异常。
+*/
+#ifndef _SHARDED_DATASET_HPP_
+#define _SHARDED_DATASET_HPP_
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdio>
+#include <sys/stat.h>
+
+#include "FeatureDataset.hpp"
+#include "Logger.hpp"
+
+namespace shard_format
+{
+    static constexpr const char *MANIFEST_MAGIC = "TLSSHARDS";
+    static constexpr uint32_t VERSION = 1;
+    static constexpr const char *MANIFEST_NAME = "manifest.txt";
+
+    inline std::string shard_file_name(size_t shard, size_t num_shards)
+    {
+        char name[64];
+        std::snprintf(name, sizeof(name), "shard-%05zu-of-%05zu.bin", shard, num_shards);
+        return name;
+    }
+
+    // 样本键(网站名/文件名)的FNV-1a哈希，与平台和标准库实现无关，保证各节点的分片划分一致
+    inline uint64_t key_hash(std::string_view site_name, std::string_view file_name)
+    {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        auto mix = [&h](std::string_view s)
+        {
+            for (unsigned char c : s)
+            {
+                h ^= c;
+                h *= 0x100000001b3ULL;
+            }
+        };
+        mix(site_name);
+        mix("/");
+        mix(file_name);
+        return h;
+    }
+
+    inline size_t shard_of(uint64_t hash, size_t num_shards)
+    {
+        return static_cast<size_t>(hash % num_shards);
+    }
+
+    inline bool is_directory(const std::string &path)
+    {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    // 目录或清单文件所对应的清单路径
+    inline std::string manifest_path(const std::string &path)
+    {
+        return is_directory(path) ? path + "/" + MANIFEST_NAME : path;
+    }
+
+    // 判断路径是否为分片数据集：多个路径的列表(逗号分隔)、含清单的目录或清单文件
+    inline bool is_sharded(const std::string &path)
+    {
+        if (path.find(',') != std::string::npos)
+            return true;
+        std::ifstream ifs(manifest_path(path));
+        std::string magic;
+        return ifs >> magic && magic == MANIFEST_MAGIC;
+    }
+}
+
+class ShardedDatasetWriter
+{
+private:
+    std::vector<FeatureDatasetWriter> shards;
+    std::vector<std::pair<int, std::string>> labels;
+
+public:
+    explicit ShardedDatasetWriter(size_t num_shards) : shards(std::max<size_t>(num_shards, 1)) {}
+
+    size_t num_shards() const { return shards.size(); }
+
+    void add_label(int label, const std::string &site_name)
+    {
+        labels.push_back({label, site_name});
+        for (auto &shard : shards)
+            shard.add_label(label, site_name);
+    }
+
+    // 按key_hash把样本追加到对应的分片，其余参数与FeatureDatasetWriter::add_sample相同
+    void add_sample(uint64_t key_hash, int label, const uint16_t *record_sizes, const int8_t *record_directions,
+                    size_t length, bool only_valid = true)
+    {
+        shards[shard_format::shard_of(key_hash, shards.size())].add_sample(label, record_sizes, record_directions, length,
+                                                                            only_valid);
+    }
+
+    size_t num_samples() const
+    {
+        size_t total = 0;
+        for (const auto &shard : shards)
+            total += shard.num_samples();
+        return total;
+    }
+
+    // 依次写出所有分片，最后写清单；清单存在即表示该目录的分片已全部写完
+    bool write(const std::string &dir) const
+    {
+        if (!shard_format::is_directory(dir) && mkdir(dir.c_str(), 0755) != 0)
+        {
+            LOG_ERROR << "Failed to create shard directory: " << dir;
+            return false;
+        }
+
+        std::ostringstream manifest;
+        manifest << shard_format::MANIFEST_MAGIC << " " << shard_format::VERSION << "\n";
+        manifest << "shards " << shards.size() << "\n";
+        for (const auto &label : labels)
+            manifest << "label " << label.first << " " << label.second << "\n";
+        for (size_t i = 0; i < shards.size(); ++i)
+        {
+            std::string name = shard_format::shard_file_name(i, shards.size());
+            if (!shards[i].write(dir + "/" + name))
+                return false;
+            manifest << "shard " << name << " " << shards[i].num_samples() << " " << shards[i].num_records() << "\n";
+        }
+
+        std::string path = dir + "/" + shard_format::MANIFEST_NAME;
+        std::string tmp_path = path + ".tmp";
+        std::ofstream ofs(tmp_path, std::ios::trunc);
+        ofs << manifest.str();
+        ofs.close();
+        if (!ofs || std::rename(tmp_path.c_str(), path.c_str()) != 0)
+        {
+            LOG_ERROR << "Failed to write shard manifest: " << path;
+            return false;
+        }
+        return true;
+    }
+};
+
+/*
+只读的分片数据集，把一个或多个目录中的分片合并为一个数据集，接口与FeatureDataset相同。
+单个FeatureDataset文件也可以出现在路径列表中，作为只有一个分片的数据集
+*/
+class ShardedDataset
+{
+private:
+    std::vector<std::unique_ptr<FeatureDataset>> shards;
+    std::vector<size_t> shard_begin; // 每个分片第一个样本的全局下标，最后一项为样本总数
+    std::vector<std::pair<int, std::string>> labels;
+    size_t records = 0;
+
+public:
+    /*
+    @brief 打开逗号分隔的路径列表，每一项为分片目录、清单文件或单个数据集文件
+           格式错误、标签表不一致或没有任何可用分片时抛出异常
+    */
+    void open(const std::string &paths)
+    {
+        shards.clear();
+        shard_begin.assign(1, 0);
+        labels.clear();
+        records = 0;
+        bool has_labels = false;
+
+        std::stringstream list(paths);
+        std::string path;
+        while (std::getline(list, path, ','))
+        {
+            if (path.empty())
+                continue;
+            if (dataset_format::is_dataset_file(path))
+            {
+                add_shard(path, has_labels);
+                continue;
+            }
+            std::string manifest = shard_format::manifest_path(path);
+            std::ifstream ifs(manifest);
+            if (!ifs.is_open())
+            {
+                LOG_WARN << "No shard manifest in " << path << " (preprocessing not finished?), skipped";
+                continue;
+            }
+            open_manifest(ifs, manifest, has_labels);
+        }
+
+        Logger::instance()->flush(); // 跳过的目录和分片先于调用方随后的直接输出
+        if (shards.empty())
+            throw std::runtime_error("No dataset shards available: " + paths);
+    }
+
+    size_t num_shards() const { return shards.size(); }
+    size_t num_samples() const { return shard_begin.back(); }
+    size_t num_records() const { return records; }
+    const std::vector<std::pair<int, std::string>> &get_labels() const { return labels; }
+
+    DatasetSample sample(size_t index) const
+    {
+        size_t shard = std::upper_bound(shard_begin.begin(), shard_begin.end(), index) - shard_begin.begin() - 1;
+        return shards[shard]->sample(index - shard_begin[shard]);
+    }
+
+private:
+    void open_manifest(std::istream &is, const std::string &manifest, bool &has_labels)
+    {
+        std::string dir = manifest.substr(0, manifest.find_last_of('/') + 1);
+        std::string magic;
+        uint32_t version = 0;
+        if (!(is >> magic >> version) || magic != shard_format::MANIFEST_MAGIC)
+            throw std::runtime_error("Not a shard manifest: " + manifest);
+        if (version != shard_format::VERSION)
+            throw std::runtime_error("Unsupported shard manifest version " + std::to_string(version) + ": " + manifest);
+
+        std::vector<std::pair<int, std::string>> manifest_labels;
+        std::string key;
+        size_t available = 0, listed = 0;
+        while (is >> key)
+        {
+            if (key == "label")
+            {
+                int label;
+                std::string site_name;
+                is >> label >> site_name;
+                manifest_labels.push_back({label, site_name});
+            }
+            else if (key == "shard")
+            {
+                // 标签行都在分片行之前，第一个分片之前校验一次
+                if (listed++ == 0)
+                    merge_labels(manifest_labels, manifest, has_labels);
+                std::string name;
+                size_t samples = 0, shard_records = 0;
+                if (!(is >> name >> samples >> shard_records))
+                    throw std::runtime_error("Corrupted shard manifest: " + manifest);
+                if (!dataset_format::is_dataset_file(dir + name))
+                {
+                    LOG_WARN << "Shard not available: " << dir + name << ", skipped";
+                    continue;
+                }
+                add_shard(dir + name, has_labels);
+                if (shards.back()->num_samples() != samples || shards.back()->num_records() != shard_records)
+                    throw std::runtime_error("Shard does not match manifest: " + dir + name);
+                available++;
+            }
+            else
+            {
+                std::string rest;
+                std::getline(is, rest); // 忽略不认识的行，便于以后扩展
+            }
+        }
+        LOG_INFO << "Shard manifest " << manifest << ": " << available << "/" << listed << " shards available";
+    }
+
+    void add_shard(const std::string &path, bool &has_labels)
+    {
+        auto shard = std::make_unique<FeatureDataset>();
+        shard->open(path);
+        merge_labels(shard->get_labels(), path, has_labels);
+        records += shard->num_records();
+        shard_begin.push_back(shard_begin.back() + shard->num_samples());
+        shards.push_back(std::move(shard));
+    }
+
+    // 第一个标签表作为整个数据集的标签表，之后的必须与之相同
+    void merge_labels(const std::vector<std::pair<int, std::string>> &other, const std::string &source, bool &has_labels)
+    {
+        if (!has_labels)
+        {
+            labels = other;
+            has_labels = true;
+        }
+        else if (other != labels)
+        {
+            throw std::runtime_error("Label table of " + source + " does not match the other shards");
+        }
+    }
+};
+
+#endif // _SHARDED_DATASET_HPP_
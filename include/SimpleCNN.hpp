@@ -8,29 +8,38 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <memory>
+#include <span>
+#include <cstring>
 
 #include "TLSDataProcessor.hpp"
+#include "MatrixKernels.hpp"
+#include "ThreadPool.hpp"
+#include "ModelFile.hpp"
 
-// 激活函数工具类
+// 激活函数工具类。span版本写入调用者提供的缓冲区(可与输入相同)，不分配内存
 class Activation
 {
 public:
-    // ReLU前向传播
-    static std::vector<float> relu(const std::vector<float> &x)
+    // ReLU前向传播(原地)
+    static void relu(std::span<float> x)
     {
-        std::vector<float> result(x.size());
-        for (size_t i = 0; i < x.size(); ++i)
+        for (float &v : x)
         {
-            result[i] = std::max(0.0f, x[i]);
+            v = std::max(0.0f, v);
         }
+    }
+
+    static std::vector<float> relu(const std::vector<float> &x)
+    {
+        std::vector<float> result(x);
+        relu(std::span<float>(result));
         return result;
     }
 
     // Softmax激活 - 增强数值稳定性
-    static std::vector<float> softmax(const std::vector<float> &x)
+    static void softmax(std::span<const float> x, std::span<float> result)
     {
-        std::vector<float> result(x.size());
-
         // 为了数值稳定性，减去最大值
         float max_val = *std::max_element(x.begin(), x.end());
 
@@ -47,24 +56,53 @@ public:
         {
             result[i] /= sum;
         }
+    }
 
+    static std::vector<float> softmax(const std::vector<float> &x)
+    {
+        std::vector<float> result(x.size());
+        softmax(x, result);
         return result;
     }
 };
 
-// 全连接层
+// 一个全连接层在一个batch内累加的梯度。多线程训练时每个线程一份，最后归约到一起
+struct LayerGradients
+{
+    AlignedMatrix weights;
+    std::vector<float> biases;
+
+    void resize(int output_size, int input_size)
+    {
+        weights.resize(output_size, input_size);
+        biases.assign(output_size, 0.0f);
+    }
+
+    void clear()
+    {
+        std::fill(weights.data(), weights.data() + weights.rows() * weights.stride(), 0.0f);
+        std::fill(biases.begin(), biases.end(), 0.0f);
+    }
+
+    // this += other，补齐部分同为0，直接按整个缓冲区相加
+    void add(const LayerGradients &other)
+    {
+        kernels::axpy(1.0f, other.weights.data(), weights.data(), weights.rows() * weights.stride());
+        for (size_t o = 0; o < biases.size(); ++o)
+            biases[o] += other.biases[o];
+    }
+};
+
+// 全连接层。层本身只保存参数，前向/反向传播的中间结果由调用者提供的缓冲区保存，因此可被多个线程同时使用
 class FCLayer
 {
 private:
     int input_size;
     int output_size;
 
-    std::vector<std::vector<float>> weights;
+    AlignedMatrix weights; // [output_size x input_size]，连续存储，行跨度补齐到SIMD宽度
     std::vector<float> biases;
 
-    std::vector<float> input;
-    std::vector<float> output;
-
 public:
     // 在FCLayer构造函数中使用更保守的初始化
     FCLayer(int input_size, int output_size) : input_size(input_size), output_size(output_size)
@@ -77,12 +115,13 @@ public:
         std::normal_distribution<float> dist(0.0f, scale);
 
         // 初始化权重
-        weights.resize(output_size, std::vector<float>(input_size));
+        weights.resize(output_size, input_size);
         for (int o = 0; o < output_size; ++o)
         {
+            float *row = weights.row(o);
             for (int i = 0; i < input_size; ++i)
             {
-                weights[o][i] = dist(gen);
+                row[i] = dist(gen);
             }
         }
 
@@ -90,48 +129,59 @@ public:
         biases.resize(output_size, 0.0f);
     }
 
-    // 前向传播
-    std::vector<float> forward(const std::vector<float> &input)
+    // 前向传播：output = W * input + b，output由调用者提供
+    void forward(std::span<const float> input, std::span<float> output) const
     {
-        this->input = input;
-        output.resize(output_size);
-
-        for (int o = 0; o < output_size; ++o)
-        {
-            float sum = biases[o];
-            for (int i = 0; i < input_size; ++i)
-            {
-                sum += weights[o][i] * input[i];
-            }
-            output[o] = sum;
-        }
+        kernels::gemv(weights, input.data(), biases.data(), output.data());
+    }
 
+    std::vector<float> forward(const std::vector<float> &input) const
+    {
+        std::vector<float> output(output_size);
+        forward(input, output);
         return output;
     }
 
-    // 反向传播
-    std::vector<float> backward(const std::vector<float> &gradient, float learning_rate)
+    // 批量前向传播：outputs = inputs * W^T + b，inputs为[batch x input_size]
+    void forward_batch(const AlignedMatrix &inputs, size_t batch, AlignedMatrix &outputs) const
     {
-        std::vector<float> input_gradient(input_size, 0.0f);
+        kernels::gemm_nt(inputs.data(), inputs.stride(), batch, weights, biases.data(), outputs.data(), outputs.stride());
+    }
 
-        // 更新权重和偏置
-        for (int o = 0; o < output_size; ++o)
+    /*
+    @brief 批量反向传播：把整个batch的梯度累加到grads中，不更新权重
+    @param inputs 前向传播时的输入
+    @param input_gradients 为nullptr时不计算输入梯度(第一层不需要)
+    */
+    void backward_batch(const AlignedMatrix &inputs, const AlignedMatrix &gradients, size_t batch,
+                        LayerGradients &grads, AlignedMatrix *input_gradients) const
+    {
+        kernels::gemm_tn_acc(gradients.data(), gradients.stride(), inputs.data(), inputs.stride(), batch, grads.weights);
+        for (size_t b = 0; b < batch; ++b)
         {
-            for (int i = 0; i < input_size; ++i)
-            {
-                weights[o][i] -= learning_rate * gradient[o] * input[i];
-                input_gradient[i] += gradient[o] * weights[o][i];
-            }
-            biases[o] -= learning_rate * gradient[o];
+            const float *g = gradients.row(b);
+            for (int o = 0; o < output_size; ++o)
+                grads.biases[o] += g[o];
         }
+        if (input_gradients)
+            kernels::gemm_nn(gradients.data(), gradients.stride(), batch, weights, input_gradients->data(),
+                             input_gradients->stride());
+    }
 
-        return input_gradient;
+    // 用一个batch累加的梯度更新一次权重
+    void apply_gradients(const LayerGradients &grads, float learning_rate)
+    {
+        for (int o = 0; o < output_size; ++o)
+        {
+            kernels::axpy(-learning_rate, grads.weights.row(o), weights.row(o), input_size);
+            biases[o] -= learning_rate * grads.biases[o];
+        }
     }
 
     // 权重访问方法
-    const std::vector<std::vector<float>> &get_weights() const { return weights; }
+    const AlignedMatrix &get_weights() const { return weights; }
     const std::vector<float> &get_biases() const { return biases; }
-    std::vector<std::vector<float>> &get_mutable_weights() { return weights; }
+    AlignedMatrix &get_mutable_weights() { return weights; }
     std::vector<float> &get_mutable_biases() { return biases; }
 
     int get_input_size() const { return input_size; }
@@ -149,10 +199,55 @@ private:
     FCLayer fc1;
     FCLayer fc2;
 
-    // 存储中间激活值
-    std::vector<float> fc1_input, fc1_output;
+public:
+    // 批量推理的工作区，[batch x 维度]的中间结果，batch变大时才重新分配
+    struct BatchWorkspace
+    {
+        AlignedMatrix hidden;
+        AlignedMatrix probabilities;
+    };
+
+private:
+    // 一个训练线程的私有缓冲区：批量前向/反向传播的中间结果([batch x 维度])和梯度
+    struct TrainWorkspace
+    {
+        AlignedMatrix inputs, hidden, logits;
+        AlignedMatrix output_grad, hidden_grad;
+        LayerGradients fc1_grads, fc2_grads;
+        float loss_sum = 0.0f;
+        int valid_samples = 0;
+        int correct = 0; // 前向传播时预测正确的样本数，用于训练准确率
+    };
+
+    // 一个评估线程的私有缓冲区
+    struct EvalWorkspace
+    {
+        AlignedMatrix inputs;
+        std::vector<int> labels;
+        BatchWorkspace batch;
+        size_t correct = 0;
+        size_t total = 0;
+    };
+
+    static const size_t EVAL_BATCH = 256; // 评估时一次前向传播的样本数，也是分给线程的任务粒度
+
+    std::vector<TrainWorkspace> workspaces;
+    std::vector<const Sample *> valid_buffer; // train_batch中通过检查的样本，容量跨batch复用
+    std::vector<const Sample *> batch_buffer; // 连续样本的batch转换为指针，容量跨batch复用
+    std::unique_ptr<WorkStealingPool> pool;      // 为nullptr时单线程训练
+    std::unique_ptr<WorkStealingPool> eval_pool; // 为nullptr时单线程评估
+    size_t train_correct = 0; // 自上次reset_train_accuracy()以来训练样本中预测正确的数量
+    size_t train_seen = 0;
+    ModelMetadata metadata;                 // 预处理参数和标签表，随模型一起保存
 
 public:
+    // 单样本推理的工作区，按网络维度一次性分配，之后的forward不再分配内存。每个线程各用一份
+    struct InferenceWorkspace
+    {
+        std::vector<float> hidden;
+        std::vector<float> probabilities;
+    };
+
     SimpleCNN(int input_dim, int num_labels)
         : input_dim(input_dim), num_labels(num_labels),
           fc1(input_dim, 16), // 大幅减少隐藏层神经元：352 -> 16
@@ -162,32 +257,109 @@ public:
         std::cout << "  Input: " << input_dim << std::endl;
         std::cout << "  Hidden: " << input_dim << " -> 16" << std::endl;
         std::cout << "  Output: 16 -> " << num_labels << std::endl;
+        std::cout << "  Kernels: " << kernels::isa_name(kernels::current_isa()) << std::endl;
+
+        metadata.sequence_length = static_cast<uint32_t>(TLSDataProcessor::sequence_length_for(input_dim));
+        metadata.packet_features = TLSDataProcessor::PACKET_FEATURES;
+        metadata.stats_features = TLSDataProcessor::STATS_FEATURES;
+        metadata.size_log_base = TLSDataProcessor::SIZE_LOG_BASE;
+    }
+
+    // 训练使用的线程数，num_threads <= 1时单线程
+    void set_num_threads(size_t num_threads)
+    {
+        pool = num_threads > 1 ? std::make_unique<WorkStealingPool>(num_threads) : nullptr;
+    }
+
+    size_t get_num_threads() const { return pool ? pool->size() : 1; }
+
+    // 评估使用的线程数，与训练线程数无关：评估没有batch间的依赖，总是可以并行
+    void set_eval_threads(size_t num_threads)
+    {
+        eval_pool = num_threads > 1 ? std::make_unique<WorkStealingPool>(num_threads) : nullptr;
+    }
+
+    size_t get_eval_threads() const { return eval_pool ? eval_pool->size() : 1; }
+
+    /*
+    训练准确率：train_batch前向传播时顺便统计的预测结果，每个样本按所在batch更新权重之前的参数计算，
+    不需要额外遍历训练集。与训练结束后重新评估的准确率相比略低(epoch前期的参数较差)
+    */
+    float get_train_accuracy() const { return train_seen > 0 ? static_cast<float>(train_correct) / train_seen : 0.0f; }
+
+    void reset_train_accuracy()
+    {
+        train_correct = 0;
+        train_seen = 0;
+    }
+
+    InferenceWorkspace make_workspace() const
+    {
+        InferenceWorkspace ws;
+        ws.hidden.resize(fc1.get_output_size());
+        ws.probabilities.resize(num_labels);
+        return ws;
     }
 
-    // 前向传播
-    std::vector<float> forward(const std::vector<float> &input)
+    /*
+    @brief 前向传播，所有中间结果写入ws
+    @return 各类别的概率，指向ws内部，下一次使用ws前有效
+    */
+    std::span<const float> forward(std::span<const float> input, InferenceWorkspace &ws) const
     {
         // 输入验证
-        for (float val : input)
+        if (static_cast<int>(input.size()) != input_dim)
         {
-            if (std::isnan(val) || std::isinf(val))
-            {
-                throw std::runtime_error("Invalid input detected");
-            }
+            throw std::runtime_error("Invalid input dimension: " + std::to_string(input.size()));
+        }
+        if (!all_finite(input))
+        {
+            throw std::runtime_error("Invalid input detected");
         }
 
         // 第一层：input -> fc1 -> relu
-        fc1_input = input;
-        auto fc1_raw = fc1.forward(input);
-        fc1_output = Activation::relu(fc1_raw);
+        fc1.forward(input, ws.hidden);
+        Activation::relu(std::span<float>(ws.hidden));
+
+        // 输出层：hidden -> fc2 -> softmax(原地)
+        fc2.forward(ws.hidden, ws.probabilities);
+        Activation::softmax(ws.probabilities, ws.probabilities);
+        return ws.probabilities;
+    }
+
+    /*
+    @brief 批量前向传播，inputs的前n行为n个样本(列数为input_dim)，不检查输入，调用者负责过滤NaN/Inf
+    @return 各样本的概率为ws.probabilities的前n行，每行num_labels个
+    */
+    const AlignedMatrix &forward_batch(const AlignedMatrix &inputs, size_t n, BatchWorkspace &ws) const
+    {
+        if (ws.hidden.rows() < n)
+        {
+            ws.hidden.resize(n, fc1.get_output_size());
+            ws.probabilities.resize(n, num_labels);
+        }
+        fc1.forward_batch(inputs, n, ws.hidden);
+        for (size_t b = 0; b < n; ++b)
+            Activation::relu(std::span<float>(ws.hidden.row(b), fc1.get_output_size()));
+        fc2.forward_batch(ws.hidden, n, ws.probabilities);
+        for (size_t b = 0; b < n; ++b)
+        {
+            std::span<float> row(ws.probabilities.row(b), num_labels);
+            Activation::softmax(row, row);
+        }
+        return ws.probabilities;
+    }
 
-        // 输出层：fc1_output -> fc2 -> softmax
-        auto logits = fc2.forward(fc1_output);
-        return Activation::softmax(logits);
+    // 便捷版本，每次调用都会分配工作区
+    std::vector<float> forward(const std::vector<float> &input) const
+    {
+        InferenceWorkspace ws = make_workspace();
+        forward(input, ws);
+        return std::move(ws.probabilities);
     }
 
     // 损失计算
-    float compute_loss(const std::vector<float> &output, int label)
+    float compute_loss(std::span<const float> output, int label) const
     {
         if (label < 0 || label >= static_cast<int>(output.size()))
         {
@@ -201,110 +373,150 @@ public:
         return std::min(loss, 10.0f);
     }
 
-    // 改进的训练方法
-    float train_batch(const std::vector<Sample> &batch, float learning_rate)
+    /*
+    @brief 小批量训练：整个batch打包为[batch x features]矩阵一次完成前向和反向传播，每个batch只更新一次权重。
+    梯度按样本求和而不是取平均，每个epoch内权重移动的总步长与逐样本更新时一致，原有的学习率不需要重新调整。
+    多线程时batch被均分给各线程，每个线程在自己的TrainWorkspace中计算梯度，再两两树形归约后统一更新
+    */
+    float train_batch(std::span<const Sample> batch, float learning_rate)
     {
-        float total_loss = 0.0f;
-        int valid_samples = 0;
-
+        batch_buffer.clear();
         for (const auto &sample : batch)
+            batch_buffer.push_back(&sample);
+        return train_batch(std::span<const Sample *const>(batch_buffer), learning_rate);
+    }
+
+    // batch为样本指针，调用者打乱索引而不是样本本身，不需要拷贝特征向量
+    float train_batch(std::span<const Sample *const> batch, float learning_rate)
+    {
+        // 维度不符或包含NaN/Inf的样本被丢弃
+        std::vector<const Sample *> &valid = valid_buffer;
+        valid.clear();
+        for (const Sample *sample_ptr : batch)
         {
-            try
+            const Sample &sample = *sample_ptr;
+            if (static_cast<int>(sample.features.size()) != input_dim || sample.label < 0 || sample.label >= num_labels ||
+                !all_finite(sample.features))
             {
-                // 前向传播
-                auto output = forward(sample.features);
-
-                // 计算损失
-                float loss = compute_loss(output, sample.label);
-
-                // 严格的损失检查
-                if (std::isnan(loss) || std::isinf(loss) || loss > 5.0f)
-                {
-                    std::cout << "[WARNING] Skipping sample with loss: " << loss << std::endl;
-                    continue;
-                }
-
-                total_loss += loss;
-                valid_samples++;
-
-                // 计算输出层梯度
-                std::vector<float> gradient(num_labels, 0.0f);
-                for (int i = 0; i < num_labels; ++i)
-                {
-                    gradient[i] = output[i];
-                }
-                gradient[sample.label] -= 1.0f;
-
-                // 严格的梯度裁剪
-                clip_gradients(gradient, 1.0f);
+                std::cout << "[WARNING] Error in sample: Invalid input detected" << std::endl;
+                continue;
+            }
+            valid.push_back(sample_ptr);
+        }
+        size_t n = valid.size();
+        if (n == 0)
+            return 0.0f;
 
-                // 简化的反向传播（只有两层）
-                auto fc2_grad = fc2.backward(gradient, learning_rate);
-                clip_gradients(fc2_grad, 1.0f);
+        size_t parts = pool ? std::min(pool->size(), n) : 1;
+        if (workspaces.size() < parts)
+            workspaces.resize(parts);
 
-                auto fc1_relu_grad = apply_relu_gradient(fc2_grad, fc1_output);
-                fc1.backward(fc1_relu_grad, learning_rate);
-            }
-            catch (const std::exception &e)
+        // lambda只捕获一个指针，std::function可以内联保存而不分配内存
+        struct PartContext
+        {
+            SimpleCNN *model;
+            size_t n, parts;
+        } ctx{this, n, parts};
+        auto compute_part = [&ctx](size_t part, size_t)
+        {
+            size_t begin = part * ctx.n / ctx.parts, end = (part + 1) * ctx.n / ctx.parts;
+            ctx.model->compute_gradients(ctx.model->valid_buffer.data() + begin, end - begin, ctx.model->workspaces[part]);
+        };
+        if (parts > 1)
+            pool->parallel_for(parts, compute_part);
+        else
+            compute_part(0, 0);
+
+        // 树形归约：每一轮把相距step的两份梯度相加，log2(parts)轮后全部汇总到workspaces[0]
+        for (size_t step = 1; step < parts; step *= 2)
+        {
+            size_t pairs = (parts - step + 2 * step - 1) / (2 * step);
+            auto reduce_pair = [this, step](size_t pair, size_t)
             {
-                std::cout << "[WARNING] Error in sample: " << e.what() << std::endl;
-                continue;
-            }
+                size_t dst = pair * 2 * step;
+                workspaces[dst].fc1_grads.add(workspaces[dst + step].fc1_grads);
+                workspaces[dst].fc2_grads.add(workspaces[dst + step].fc2_grads);
+                workspaces[dst].loss_sum += workspaces[dst + step].loss_sum;
+                workspaces[dst].valid_samples += workspaces[dst + step].valid_samples;
+                workspaces[dst].correct += workspaces[dst + step].correct;
+            };
+            if (pairs > 1)
+                pool->parallel_for(pairs, reduce_pair);
+            else
+                reduce_pair(0, 0);
         }
 
-        return valid_samples > 0 ? total_loss / valid_samples : 0.0f;
+        const TrainWorkspace &total = workspaces[0];
+        train_correct += static_cast<size_t>(total.correct);
+        train_seen += n;
+        if (total.valid_samples > 0)
+        {
+            fc2.apply_gradients(total.fc2_grads, learning_rate);
+            fc1.apply_gradients(total.fc1_grads, learning_rate);
+        }
+
+        return total.valid_samples > 0 ? total.loss_sum / total.valid_samples : 0.0f;
     }
 
-    // 模型评估
-    float evaluate(const std::vector<Sample> &samples)
+    /*
+    @brief 模型评估：每EVAL_BATCH个样本一次批量前向传播，设置了评估线程时各块并行执行。
+           维度不符或包含NaN/Inf的样本无法预测，被跳过，不计入准确率
+    */
+    float evaluate(std::span<const Sample> samples) const
     {
-        int correct = 0;
-        int total = 0;
-
-        for (const auto &sample : samples)
+        size_t tasks = (samples.size() + EVAL_BATCH - 1) / EVAL_BATCH;
+        std::vector<EvalWorkspace> eval_workspaces(get_eval_threads());
+        auto evaluate_block = [&](size_t task, size_t worker)
         {
-            try
+            EvalWorkspace &ws = eval_workspaces[worker];
+            if (ws.inputs.rows() == 0)
             {
-                auto output = forward(sample.features);
-                int predicted = std::max_element(output.begin(), output.end()) - output.begin();
-                if (predicted == sample.label)
-                {
-                    correct++;
-                }
-                total++;
+                ws.inputs.resize(EVAL_BATCH, input_dim);
+                ws.labels.resize(EVAL_BATCH);
             }
-            catch (const std::exception &e)
+            size_t rows = 0;
+            for (size_t i = task * EVAL_BATCH; i < std::min(samples.size(), (task + 1) * EVAL_BATCH); ++i)
             {
-                // 跳过无法预测的样本
-                continue;
+                const Sample &sample = samples[i];
+                if (static_cast<int>(sample.features.size()) != input_dim || !all_finite(sample.features))
+                    continue;
+                std::copy(sample.features.begin(), sample.features.end(), ws.inputs.row(rows));
+                ws.labels[rows++] = sample.label;
+            }
+            const AlignedMatrix &probabilities = forward_batch(ws.inputs, rows, ws.batch);
+            for (size_t r = 0; r < rows; ++r)
+            {
+                const float *p = probabilities.row(r);
+                ws.correct += std::max_element(p, p + num_labels) - p == ws.labels[r];
             }
+            ws.total += rows;
+        };
+        if (eval_pool)
+            eval_pool->parallel_for(tasks, evaluate_block);
+        else
+            for (size_t task = 0; task < tasks; ++task)
+                evaluate_block(task, 0);
+
+        size_t correct = 0, total = 0;
+        for (const EvalWorkspace &ws : eval_workspaces)
+        {
+            correct += ws.correct;
+            total += ws.total;
         }
-
         return total > 0 ? static_cast<float>(correct) / total : 0.0f;
     }
 
-    // 修复模型保存（只保存两层）
+    // 保存为自描述的模型文件，包含预处理参数和标签表
     void save_model(const std::string &path)
     {
-        std::ofstream ofs(path, std::ios::binary);
-        if (!ofs.is_open())
-        {
-            throw std::runtime_error("Failed to save model to: " + path);
-        }
-
-        // 保存配置
-        ofs.write(reinterpret_cast<const char *>(&input_dim), sizeof(input_dim));
-        ofs.write(reinterpret_cast<const char *>(&num_labels), sizeof(num_labels));
-
-        // 只保存两层
-        save_fc_weights(ofs, fc1);
-        save_fc_weights(ofs, fc2);
-
-        ofs.close();
+        ModelFileWriter writer(input_dim, num_labels, metadata);
+        writer.add_layer(fc1.get_weights(), fc1.get_biases());
+        writer.add_layer(fc2.get_weights(), fc2.get_biases());
+        writer.write(path);
         std::cout << "[INFO] Model saved to " << path << std::endl;
     }
 
-    // 修复模型加载（只加载两层）
+    // 继续训练时加载模型，文件缺失、损坏或维度不一致时创建新模型
     static SimpleCNN load_model(const std::string &path, int input_dim, int num_labels)
     {
         std::ifstream ifs(path, std::ios::binary);
@@ -313,103 +525,239 @@ public:
             std::cout << "[WARNING] Model file not found, creating new model" << std::endl;
             return SimpleCNN(input_dim, num_labels);
         }
-
-        // 读取配置
-        int saved_input_dim, saved_num_labels;
-        ifs.read(reinterpret_cast<char *>(&saved_input_dim), sizeof(saved_input_dim));
-        ifs.read(reinterpret_cast<char *>(&saved_num_labels), sizeof(saved_num_labels));
-
-        if (saved_input_dim != input_dim || saved_num_labels != num_labels)
-        {
-            std::cout << "[WARNING] Model dimension mismatch, creating new model" << std::endl;
-            ifs.close();
-            return SimpleCNN(input_dim, num_labels);
-        }
-
-        SimpleCNN model(input_dim, num_labels);
+        ifs.close();
 
         try
         {
-            // 只加载两层
-            load_fc_weights(ifs, model.fc1);
-            load_fc_weights(ifs, model.fc2);
-
-            ifs.close();
-            std::cout << "[INFO] Model loaded from " << path << std::endl;
+            SimpleCNN model = load_model(path);
+            if (model.input_dim != input_dim || model.num_labels != num_labels)
+            {
+                std::cout << "[WARNING] Model dimension mismatch, creating new model" << std::endl;
+                return SimpleCNN(input_dim, num_labels);
+            }
+            return model;
         }
         catch (const std::exception &e)
         {
             std::cout << "[WARNING] Failed to load weights: " << e.what() << std::endl;
-            ifs.close();
             return SimpleCNN(input_dim, num_labels);
         }
+    }
 
+    // 按模型文件中保存的维度加载模型，用于不读取训练数据的推理场景。文件缺失或损坏时抛出异常，不会退回随机权重
+    static SimpleCNN load_model(const std::string &path)
+    {
+        SimpleCNN model = model_format::is_model_file(path) ? read_model_file(path) : read_legacy_model(path);
+        std::cout << "[INFO] Model loaded from " << path << std::endl;
         return model;
     }
 
+    // 预处理参数和标签表，训练前由调用者根据数据集设置
+    const ModelMetadata &get_metadata() const { return metadata; }
+    void set_labels(const std::vector<std::pair<int, std::string>> &labels) { metadata.labels = labels; }
+
+    int get_input_dim() const { return input_dim; }
+    int get_num_labels() const { return num_labels; }
+
+    // 各层的只读访问，供量化推理等复制权重使用
+    const FCLayer &get_hidden_layer() const { return fc1; }
+    const FCLayer &get_output_layer() const { return fc2; }
+
 private:
+    // NaN和Inf的指数位全为1；按位或归约没有提前退出的分支，可以向量化
+    static bool all_finite(std::span<const float> values)
+    {
+        uint32_t non_finite = 0;
+        for (float val : values)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &val, sizeof(bits));
+            non_finite |= (bits & 0x7f800000u) == 0x7f800000u;
+        }
+        return non_finite == 0;
+    }
+
     // 梯度裁剪
-    void clip_gradients(std::vector<float> &gradients, float max_norm)
+    static void clip_gradients(float *gradients, size_t n, float max_norm)
     {
         float norm = 0.0f;
-        for (float grad : gradients)
+        for (size_t i = 0; i < n; ++i)
         {
-            norm += grad * grad;
+            norm += gradients[i] * gradients[i];
         }
         norm = std::sqrt(norm);
 
         if (norm > max_norm)
         {
             float scale = max_norm / norm;
-            for (float &grad : gradients)
+            for (size_t i = 0; i < n; ++i)
             {
-                grad *= scale;
+                gradients[i] *= scale;
             }
         }
     }
 
-    // 应用ReLU梯度
-    std::vector<float> apply_relu_gradient(const std::vector<float> &upstream_grad,
-                                           const std::vector<float> &activation_output)
+    // 计算一组样本的梯度，结果(覆盖而非累加)写入ws。只读取模型参数，可在多个线程中同时调用
+    void compute_gradients(const Sample *const *samples, size_t n, TrainWorkspace &ws) const
     {
-        std::vector<float> result(upstream_grad.size());
-        for (size_t i = 0; i < upstream_grad.size(); ++i)
+        int hidden_dim = fc1.get_output_size();
+        ensure_workspace(ws, n);
+        ws.fc1_grads.clear();
+        ws.fc2_grads.clear();
+        ws.loss_sum = 0.0f;
+        ws.valid_samples = 0;
+        ws.correct = 0;
+        if (n == 0)
+            return;
+
+        for (size_t b = 0; b < n; ++b)
+            std::copy(samples[b]->features.begin(), samples[b]->features.end(), ws.inputs.row(b));
+
+        // 前向传播：input -> fc1 -> relu -> fc2
+        fc1.forward_batch(ws.inputs, n, ws.hidden);
+        for (size_t b = 0; b < n; ++b)
         {
-            result[i] = (activation_output[i] > 0) ? upstream_grad[i] : 0.0f;
+            float *h = ws.hidden.row(b);
+            for (int i = 0; i < hidden_dim; ++i)
+                h[i] = std::max(0.0f, h[i]);
         }
-        return result;
+        fc2.forward_batch(ws.hidden, n, ws.logits);
+
+        // softmax + 交叉熵，逐样本计算输出层梯度。概率直接写入梯度矩阵，再减去one-hot
+        for (size_t b = 0; b < n; ++b)
+        {
+            float *grad = ws.output_grad.row(b);
+            std::span<float> output(grad, num_labels);
+            Activation::softmax(std::span<const float>(ws.logits.row(b), num_labels), output);
+            ws.correct += std::max_element(output.begin(), output.end()) - output.begin() == samples[b]->label;
+            float loss = compute_loss(output, samples[b]->label);
+
+            // 严格的损失检查，被跳过的样本梯度为0，不参与更新
+            if (std::isnan(loss) || std::isinf(loss) || loss > 5.0f)
+            {
+                std::cout << "[WARNING] Skipping sample with loss: " << loss << std::endl;
+                std::fill(grad, grad + num_labels, 0.0f);
+                continue;
+            }
+
+            ws.loss_sum += loss;
+            ws.valid_samples++;
+
+            grad[samples[b]->label] -= 1.0f;
+
+            // 严格的梯度裁剪
+            clip_gradients(grad, num_labels, 1.0f);
+        }
+
+        if (ws.valid_samples == 0)
+            return;
+
+        // 反向传播（只有两层）
+        fc2.backward_batch(ws.hidden, ws.output_grad, n, ws.fc2_grads, &ws.hidden_grad);
+        for (size_t b = 0; b < n; ++b)
+        {
+            float *g = ws.hidden_grad.row(b);
+            const float *h = ws.hidden.row(b);
+            clip_gradients(g, hidden_dim, 1.0f);
+            for (int i = 0; i < hidden_dim; ++i) // ReLU梯度
+                g[i] = h[i] > 0 ? g[i] : 0.0f;
+        }
+        fc1.backward_batch(ws.inputs, ws.hidden_grad, n, ws.fc1_grads, nullptr);
+    }
+
+    // 工作区的矩阵只在batch变大时重新分配
+    void ensure_workspace(TrainWorkspace &ws, size_t n) const
+    {
+        int hidden_dim = fc1.get_output_size();
+        if (ws.fc1_grads.biases.empty())
+        {
+            ws.fc1_grads.resize(hidden_dim, input_dim);
+            ws.fc2_grads.resize(num_labels, hidden_dim);
+        }
+        if (ws.inputs.rows() >= n)
+            return;
+        ws.inputs.resize(n, input_dim);
+        ws.hidden.resize(n, hidden_dim);
+        ws.logits.resize(n, num_labels);
+        ws.output_grad.resize(n, num_labels);
+        ws.hidden_grad.resize(n, hidden_dim);
+    }
+
+    static SimpleCNN read_model_file(const std::string &path)
+    {
+        ModelFile file;
+        file.open(path);
+        if (file.input_dim() <= 0 || file.num_labels() <= 0 || file.num_layers() != 2)
+        {
+            throw std::runtime_error("Invalid model header: " + path);
+        }
+
+        // 模型只能用训练时的预处理方式使用，不一致时拒绝加载，而不是静默地得到错误的输入
+        const ModelMetadata &meta = file.metadata();
+        if (meta.packet_features != TLSDataProcessor::PACKET_FEATURES ||
+            meta.stats_features != TLSDataProcessor::STATS_FEATURES ||
+            meta.size_log_base != TLSDataProcessor::SIZE_LOG_BASE ||
+            static_cast<int>(meta.sequence_length) != TLSDataProcessor::sequence_length_for(file.input_dim()))
+        {
+            throw std::runtime_error("Model preprocessing does not match this build: " + path);
+        }
+
+        SimpleCNN model(file.input_dim(), file.num_labels());
+        copy_layer(file.layer(0), model.fc1);
+        copy_layer(file.layer(1), model.fc2);
+        model.metadata = meta;
+        return model;
     }
 
-    // 保存全连接层权重
-    void save_fc_weights(std::ofstream &ofs, const FCLayer &layer)
+    // 没有魔数的旧格式：int input_dim, int num_labels, 然后逐层的维度、权重和偏置
+    static SimpleCNN read_legacy_model(const std::string &path)
     {
-        const auto &weights = layer.get_weights();
-        const auto &biases = layer.get_biases();
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs.is_open())
+        {
+            throw std::runtime_error("Failed to open model: " + path);
+        }
 
-        // 保存维度信息
-        int output_size = layer.get_output_size();
-        int input_size = layer.get_input_size();
+        int saved_input_dim = 0, saved_num_labels = 0;
+        ifs.read(reinterpret_cast<char *>(&saved_input_dim), sizeof(saved_input_dim));
+        ifs.read(reinterpret_cast<char *>(&saved_num_labels), sizeof(saved_num_labels));
+        if (!ifs || saved_input_dim <= 0 || saved_num_labels <= 0)
+        {
+            throw std::runtime_error("Invalid model header: " + path);
+        }
 
-        ofs.write(reinterpret_cast<const char *>(&output_size), sizeof(output_size));
-        ofs.write(reinterpret_cast<const char *>(&input_size), sizeof(input_size));
+        SimpleCNN model(saved_input_dim, saved_num_labels);
+        load_fc_weights(ifs, model.fc1);
+        load_fc_weights(ifs, model.fc2);
+        if (!ifs)
+        {
+            throw std::runtime_error("Truncated model file: " + path);
+        }
+        return model;
+    }
 
-        // 保存权重
-        for (const auto &row : weights)
+    // 从文件映射整块拷贝一层的权重，行跨度相同时只需一次memcpy
+    static void copy_layer(const ModelLayerView &view, FCLayer &layer)
+    {
+        if (view.output_size != layer.get_output_size() || view.input_size != layer.get_input_size())
         {
-            for (float weight : row)
-            {
-                ofs.write(reinterpret_cast<const char *>(&weight), sizeof(weight));
-            }
+            throw std::runtime_error("Layer dimension mismatch during loading");
         }
 
-        // 保存偏置
-        for (float bias : biases)
+        AlignedMatrix &weights = layer.get_mutable_weights();
+        if (view.stride == weights.stride())
+        {
+            std::memcpy(weights.data(), view.weights, weights.rows() * weights.stride() * sizeof(float));
+        }
+        else
         {
-            ofs.write(reinterpret_cast<const char *>(&bias), sizeof(bias));
+            for (int o = 0; o < view.output_size; ++o)
+                std::memcpy(weights.row(o), view.weights + o * view.stride, view.input_size * sizeof(float));
         }
+        std::memcpy(layer.get_mutable_biases().data(), view.biases, view.output_size * sizeof(float));
     }
 
-    // 加载全连接层权重
+    // 读取旧格式中一层的维度、权重和偏置
     static void load_fc_weights(std::ifstream &ifs, FCLayer &layer)
     {
         int output_size, input_size;
@@ -426,12 +774,9 @@ private:
         auto &biases = layer.get_mutable_biases();
 
         // 加载权重
-        for (auto &row : weights)
+        for (int o = 0; o < output_size; ++o)
         {
-            for (float &weight : row)
-            {
-                ifs.read(reinterpret_cast<char *>(&weight), sizeof(weight));
-            }
+            ifs.read(reinterpret_cast<char *>(weights.row(o)), input_size * sizeof(float));
         }
 
         // 加载偏置
@@ -0,0 +1,264 @@
+/*
+SyntheticData生成可复现的合成数据，用于基准测试(bench)和在没有真实流量时验证整个流程：
+    - 合成TLS会话：每个网站(标签)有自己的记录大小分布，握手(ClientHello/ServerHello/ChangeCipherSpec)之后
+      按网站的分布交替产生客户端请求和服务端响应
+    - pcap文件：以太网链路层的完整TCP连接(三次握手、TLS记录按MSS分段、FIN)，内置解码器和tshark都可解析
+    - 数据集：相同的记录序列直接写入二进制数据集(FeatureDatasetWriter)或TLSRecordToCsv格式的csv
+所有内容由种子决定，同一种子总是生成相同的字节。
+*/
+#ifndef _SYNTHETIC_DATA_HPP_
+#define _SYNTHETIC_DATA_HPP_
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "FeatureDataset.hpp"
+
+// 一个合成会话的TLS记录序列，sizes为TLS记录长度(不含记录头)，directions: 0客户端->服务端，1服务端->客户端
+struct SyntheticTrace
+{
+    int label = 0;
+    std::vector<uint16_t> sizes;
+    std::vector<int8_t> directions;
+    std::vector<uint8_t> content_types; // 22握手，20 ChangeCipherSpec，23应用数据
+};
+
+class SyntheticData
+{
+public:
+    static const uint16_t MSS = 1448;
+
+    // 生成一个网站的会话：record_count条记录(含握手)，大小分布由label决定
+    static SyntheticTrace make_trace(int label, size_t record_count, std::mt19937 &rng)
+    {
+        SyntheticTrace trace;
+        trace.label = label;
+        auto push = [&trace](uint16_t size, int8_t direction, uint8_t type)
+        {
+            trace.sizes.push_back(size);
+            trace.directions.push_back(direction);
+            trace.content_types.push_back(type);
+        };
+
+        // 握手：ClientHello、ServerHello(含证书)、双方的ChangeCipherSpec
+        std::uniform_int_distribution<int> hello(200, 600);
+        push(static_cast<uint16_t>(hello(rng)), 0, 22);
+        push(static_cast<uint16_t>(2000 + 500 * (label % 4) + hello(rng)), 1, 22);
+        push(1, 0, 20);
+        push(1, 1, 20);
+
+        // 应用数据：每个网站的请求/响应大小均值不同
+        std::normal_distribution<float> request(300.0f + 80.0f * label, 40.0f);
+        std::normal_distribution<float> response(1200.0f + 900.0f * label, 300.0f);
+        std::bernoulli_distribution server_turn(0.6 + 0.05 * (label % 5));
+        while (trace.sizes.size() < record_count)
+        {
+            bool from_server = server_turn(rng);
+            float size = from_server ? response(rng) : request(rng);
+            push(static_cast<uint16_t>(std::clamp(size, 32.0f, 16384.0f)), from_server ? 1 : 0, 23);
+        }
+        return trace;
+    }
+
+    // 生成num_samples个会话，标签轮流分配，记录数在[min_records, max_records]内均匀分布
+    static std::vector<SyntheticTrace> make_traces(size_t num_samples, int num_labels, size_t min_records,
+                                                   size_t max_records, unsigned seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<size_t> length(min_records, std::max(min_records, max_records));
+        std::vector<SyntheticTrace> traces;
+        traces.reserve(num_samples);
+        for (size_t i = 0; i < num_samples; ++i)
+            traces.push_back(make_trace(static_cast<int>(i % num_labels), length(rng), rng));
+        return traces;
+    }
+
+    static std::string site_name(int label) { return "site" + std::to_string(label); }
+
+    // 写入二进制数据集，记录大小为帧长度(与Parser的frame_length一致)
+    static bool write_dataset(const std::string &path, const std::vector<SyntheticTrace> &traces, int num_labels)
+    {
+        FeatureDatasetWriter writer;
+        for (int label = 0; label < num_labels; ++label)
+            writer.add_label(label, site_name(label));
+        std::vector<uint16_t> frame_sizes;
+        for (const SyntheticTrace &trace : traces)
+        {
+            frame_sizes.clear();
+            for (uint16_t size : trace.sizes)
+                frame_sizes.push_back(frame_length(size));
+            writer.add_sample(trace.label, frame_sizes.data(), trace.directions.data(), trace.sizes.size());
+        }
+        return writer.write(path);
+    }
+
+    // 写入TLSRecordToCsv格式的csv，并在同一目录下写入site_labels.csv
+    static bool write_csv(const std::string &path, const std::vector<SyntheticTrace> &traces, int num_labels)
+    {
+        std::ofstream ofs(path);
+        if (!ofs.is_open())
+        {
+            std::cerr << "[ERROR] Failed to open output CSV file: " << path << std::endl;
+            return false;
+        }
+        ofs << "site_label,packet_features\n";
+        for (const SyntheticTrace &trace : traces)
+        {
+            ofs << trace.label << ",";
+            for (size_t i = 0; i < trace.sizes.size(); ++i)
+                ofs << (i > 0 ? ";" : "") << frame_length(trace.sizes[i]) << "_" << static_cast<int>(trace.directions[i]);
+            ofs << "\n";
+        }
+
+        size_t last_slash = path.find_last_of('/');
+        std::string label_map_path = (last_slash == std::string::npos ? std::string(".") : path.substr(0, last_slash)) + "/site_labels.csv";
+        std::ofstream labels(label_map_path);
+        labels << "label,site_name\n";
+        for (int label = 0; label < num_labels; ++label)
+            labels << label << "," << site_name(label) << "\n";
+        return static_cast<bool>(ofs) && static_cast<bool>(labels);
+    }
+
+    /*
+    @brief 把若干个会话写入一个以太网pcap文件，每个会话使用不同的客户端端口
+    @param start_us 第一个数据包的时间戳，之后每个包间隔1ms
+    */
+    static bool write_pcap(const std::string &path, const std::vector<SyntheticTrace> &traces, uint64_t start_us = 1700000000000000ULL)
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        if (!ofs.is_open())
+        {
+            std::cerr << "[ERROR] Failed to write pcap file: " << path << std::endl;
+            return false;
+        }
+        uint32_t header[6] = {0xa1b2c3d4, 2 | (4u << 16), 0, 0, 262144, 1};
+        ofs.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+        PcapWriterState state{ofs, start_us};
+        std::vector<uint8_t> payload;
+        for (size_t s = 0; s < traces.size(); ++s)
+        {
+            const SyntheticTrace &trace = traces[s];
+            uint16_t client_port = static_cast<uint16_t>(40000 + s % 20000);
+            uint32_t seq[2] = {1000, 5000}; // 客户端、服务端的初始序号
+
+            write_tcp(state, 0, client_port, seq[0], seq[1], 0x02, nullptr, 0); // SYN
+            write_tcp(state, 1, client_port, seq[1], seq[0] + 1, 0x12, nullptr, 0);
+            seq[0]++;
+            seq[1]++;
+            write_tcp(state, 0, client_port, seq[0], seq[1], 0x10, nullptr, 0);
+
+            for (size_t r = 0; r < trace.sizes.size(); ++r)
+            {
+                int dir = trace.directions[r];
+                build_record(trace.content_types[r], trace.sizes[r], dir, payload);
+                // 超过MSS的记录分成多个TCP段
+                for (size_t offset = 0; offset < payload.size(); offset += MSS)
+                {
+                    uint32_t len = static_cast<uint32_t>(std::min<size_t>(MSS, payload.size() - offset));
+                    write_tcp(state, dir, client_port, seq[dir], seq[1 - dir], 0x18, payload.data() + offset, len);
+                    seq[dir] += len;
+                }
+            }
+
+            write_tcp(state, 0, client_port, seq[0], seq[1], 0x11, nullptr, 0); // FIN
+            write_tcp(state, 1, client_port, seq[1], seq[0] + 1, 0x11, nullptr, 0);
+        }
+        return static_cast<bool>(ofs);
+    }
+
+    // 一条记录在pcap中的帧长度：以太网14 + IPv4 20 + TCP 20 + 记录头5 + 记录(只计最后一个分段)
+    static uint16_t frame_length(uint16_t record_size)
+    {
+        uint32_t payload = record_size + 5u;
+        uint32_t last = payload % MSS == 0 ? MSS : payload % MSS;
+        return static_cast<uint16_t>(54 + last);
+    }
+
+private:
+    struct PcapWriterState
+    {
+        std::ofstream &ofs;
+        uint64_t timestamp_us;
+    };
+
+    // 客户端的握手记录为ClientHello，服务端的为ServerHello
+    static void build_record(uint8_t content_type, uint16_t size, int dir, std::vector<uint8_t> &out)
+    {
+        out.assign(5 + size, 0);
+        out[0] = content_type;
+        out[1] = 3;
+        out[2] = content_type == 22 && dir == 0 ? 1 : 3; // ClientHello的记录版本通常为TLS 1.0
+        out[3] = static_cast<uint8_t>(size >> 8);
+        out[4] = static_cast<uint8_t>(size & 0xFF);
+        if (content_type == 22 && size >= 4)
+        {
+            out[5] = dir == 0 ? 1 : 2;
+            uint32_t body = size - 4u;
+            out[6] = static_cast<uint8_t>(body >> 16);
+            out[7] = static_cast<uint8_t>(body >> 8);
+            out[8] = static_cast<uint8_t>(body);
+        }
+        else if (content_type == 20)
+        {
+            out[5] = 1;
+        }
+        for (size_t i = 9; i < out.size(); ++i)
+            out[i] = static_cast<uint8_t>(i * 131); // 填充内容不影响解析
+    }
+
+    // 写入一个以太网/IPv4/TCP数据包，dir为0时从客户端发出
+    static void write_tcp(PcapWriterState &state, int dir, uint16_t client_port, uint32_t seq, uint32_t ack,
+                          uint8_t flags, const uint8_t *payload, uint32_t payload_len)
+    {
+        static const uint8_t client_ip[4] = {10, 0, 0, 2};
+        static const uint8_t server_ip[4] = {93, 184, 216, 34};
+        uint8_t frame[54];
+        std::memset(frame, 0, sizeof(frame));
+        frame[12] = 0x08; // EtherType IPv4
+
+        uint8_t *ip = frame + 14;
+        uint16_t total_len = static_cast<uint16_t>(40 + payload_len);
+        ip[0] = 0x45;
+        ip[2] = static_cast<uint8_t>(total_len >> 8);
+        ip[3] = static_cast<uint8_t>(total_len);
+        ip[8] = 64;
+        ip[9] = 6; // TCP
+        std::memcpy(ip + 12, dir == 0 ? client_ip : server_ip, 4);
+        std::memcpy(ip + 16, dir == 0 ? server_ip : client_ip, 4);
+
+        uint8_t *tcp = ip + 20;
+        uint16_t src_port = dir == 0 ? client_port : 443;
+        uint16_t dst_port = dir == 0 ? 443 : client_port;
+        tcp[0] = static_cast<uint8_t>(src_port >> 8);
+        tcp[1] = static_cast<uint8_t>(src_port);
+        tcp[2] = static_cast<uint8_t>(dst_port >> 8);
+        tcp[3] = static_cast<uint8_t>(dst_port);
+        for (int i = 0; i < 4; ++i)
+        {
+            tcp[4 + i] = static_cast<uint8_t>(seq >> (24 - 8 * i));
+            tcp[8 + i] = static_cast<uint8_t>(ack >> (24 - 8 * i));
+        }
+        tcp[12] = 0x50; // 数据偏移20字节
+        tcp[13] = flags;
+        tcp[14] = 0xFF;
+        tcp[15] = 0xFF;
+
+        uint32_t frame_len = 54 + payload_len;
+        uint32_t record[4] = {static_cast<uint32_t>(state.timestamp_us / 1000000),
+                              static_cast<uint32_t>(state.timestamp_us % 1000000), frame_len, frame_len};
+        state.ofs.write(reinterpret_cast<const char *>(record), sizeof(record));
+        state.ofs.write(reinterpret_cast<const char *>(frame), sizeof(frame));
+        if (payload_len > 0)
+            state.ofs.write(reinterpret_cast<const char *>(payload), payload_len);
+        state.timestamp_us += 1000;
+    }
+};
+
+#endif // _SYNTHETIC_DATA_HPP_
@@ -1,5 +1,5 @@
 /*
-TLS数据处理器，用于加载、解析、预处理从csv读取的TLS数据，并将这些数据划分为训练集和测试集，以便后续的训练和评估。
+TLS数据处理器，用于加载、解析、预处理TLS数据(二进制数据集或csv)，并将这些数据划分为训练集和测试集，以便后续的训练和评估。
 */
 #ifndef _TLS_DATA_PROCESSOR_HPP_
 #define _TLS_DATA_PROCESSOR_HPP_
@@ -12,8 +12,14 @@ TLS数据处理器，用于加载、解析、预处理从csv读取的TLS数据
 #include <algorithm>
 #include <random>
 #include <cmath>
-#include <numeric>
 #include <iostream>
+#include <cstdint>
+#include <span>
+
+#include "FeatureDataset.hpp"
+#include "ShardedDataset.hpp"
+#include "Featurizer.hpp"
+#include "LabelMap.hpp"
 
 // 一个Sample为一次完整的TLS通信会话的特征化表示。
 struct Sample
@@ -22,27 +28,75 @@ struct Sample
     std::vector<float> features; // 特征向量
 };
 
+// 超过窗口长度的样本的处理方式
+enum class TruncationPolicy
+{
+    HEAD, // 只保留前K条记录，统计特征也只在这K条上计算(与在线分类收到第K条记录时立即判决一致)
+    DROP  // 丢弃整个样本
+};
+
+// 特征窗口：每个样本只使用前max_records条记录，特征维度固定为 max_records * PACKET_FEATURES + STATS_FEATURES，
+// 不再随语料中最长的一次会话变化。max_records为0时使用语料中的最大序列长度
+struct FeatureWindow
+{
+    int max_records = 0;
+    TruncationPolicy policy = TruncationPolicy::HEAD;
+};
+
 class TLSDataProcessor
 {
 private:
-    std::vector<Sample> samples;
-    std::vector<Sample> train_samples;
-    std::vector<Sample> test_samples;
+    std::vector<Sample> samples; // 打乱后前train_size个为训练集，其余为测试集，两者都是samples上的视图，不另存副本
+    size_t train_size = 0;
 
     int num_labels = 0;
     int max_sequence_length = 0;
     float test_ratio = 0.2f;
+    FeatureWindow window;
+    size_t truncated_samples = 0; // 因超过窗口长度被截断或丢弃的样本数
+    size_t total_records = 0;     // 所有样本实际使用的记录数之和
+    std::vector<std::pair<int, std::string>> label_names; // 标签 -> 网站名称，保存到模型文件中
 
+public:
     // 统计特征维度：每个包(大小+方向) + 全局统计特征
-    static const int PACKET_FEATURES = 2; // 大小 + 方向
-    static const int STATS_FEATURES = 6;  // 平均大小、最大、最小、标准差、出包比例、总包数
+    static const int PACKET_FEATURES = Featurizer::PACKET_FEATURES; // 大小 + 方向
+    static const int STATS_FEATURES = Featurizer::STATS_FEATURES;   // 平均大小、最大、最小、标准差、出包比例、总包数
+    static constexpr float SIZE_LOG_BASE = Featurizer::SIZE_LOG_BASE;
 
-public:
-    TLSDataProcessor(const std::string &csv_path)
+    /*
+    @param data_path 二进制数据集(tls_features.bin)、分片数据集(目录或清单，多个用逗号分隔，见ShardedDataset)
+                     或csv(tls_features.csv)，根据文件头自动识别
+    @param window 每个样本使用的记录窗口，默认使用全部记录
+    @param split_seed 划分训练/测试集的随机种子，为0时每次随机。比较不同窗口长度时使用同一种子，保证划分一致
+    */
+    TLSDataProcessor(const std::string &data_path, const FeatureWindow &window = FeatureWindow(), unsigned split_seed = 0)
+        : window(window)
     {
-        load_data(csv_path);
+        if (dataset_format::is_dataset_file(data_path) || shard_format::is_sharded(data_path))
+            load_dataset(data_path);
+        else
+            load_data(data_path);
+        if (window.max_records > 0)
+        {
+            max_sequence_length = window.max_records; // 短于窗口的样本补0，维度不依赖语料
+            std::cout << "[INFO] Feature window: first " << window.max_records << " records, "
+                      << truncated_samples << " samples "
+                      << (window.policy == TruncationPolicy::DROP ? "dropped" : "truncated") << std::endl;
+        }
         normalize_features();
-        shuffle_and_split();
+        shuffle_and_split(split_seed);
+    }
+
+    // 默认数据路径：优先使用二进制数据集，其次是分片数据集(main --shards)，都不存在时回退到csv
+    static std::string default_data_path(const std::string &output_dir = "../output")
+    {
+        std::string dataset_path = output_dir + "/tls_features.bin";
+        std::ifstream ifs(dataset_path, std::ios::binary);
+        if (ifs.good())
+            return dataset_path;
+        if (shard_format::is_sharded(output_dir + "/shards"))
+            return output_dir + "/shards";
+        return output_dir + "/tls_features.csv";
     }
 
     // 获取特征维度
@@ -51,11 +105,46 @@ public:
         return max_sequence_length * PACKET_FEATURES + STATS_FEATURES;
     }
 
+    // 由模型的输入维度反推序列长度(记录数)
+    static int sequence_length_for(int feature_dim) { return Featurizer::sequence_length_for(feature_dim); }
+
     int get_num_labels() const { return num_labels; }
-    const std::vector<Sample> &get_train_samples() const { return train_samples; }
-    const std::vector<Sample> &get_test_samples() const { return test_samples; }
+    int get_sequence_length() const { return max_sequence_length; }
+    const std::vector<std::pair<int, std::string>> &get_label_names() const { return label_names; }
+    std::span<const Sample> get_train_samples() const { return std::span<const Sample>(samples).first(train_size); }
+    std::span<const Sample> get_test_samples() const { return std::span<const Sample>(samples).subspan(train_size); }
+    size_t get_truncated_samples() const { return truncated_samples; }
+
+    // 平均每个样本使用的记录数，即在线分类平均需要等待的记录数
+    double get_mean_records() const { return samples.empty() ? 0.0 : static_cast<double>(total_records) / samples.size(); }
 
 private:
+    // 从二进制数据集(单个文件或分片)加载：直接遍历mmap中的列数组，不做任何文本解析
+    void load_dataset(const std::string &dataset_path)
+    {
+        ShardedDataset dataset;
+        dataset.open(dataset_path);
+        label_names = dataset.get_labels();
+
+        std::unordered_map<int, int> label_counts; // label_counts记录每个网站的样本数
+        samples.reserve(dataset.num_samples());
+
+        for (size_t i = 0; i < dataset.num_samples(); ++i)
+        {
+            DatasetSample record = dataset.sample(i);
+            Sample sample;
+            sample.label = record.label;
+            num_labels = std::max(num_labels, sample.label + 1);
+
+            if (!add_record_features(record.sizes, record.directions, record.length, sample))
+                continue;
+            label_counts[sample.label]++;
+            samples.push_back(std::move(sample));
+        }
+
+        print_distribution(label_counts);
+    }
+
     void load_data(const std::string &csv_path)
     {
         std::ifstream ifs(csv_path);
@@ -81,14 +170,30 @@ private:
             {
                 Sample sample;
                 sample.label = std::stoi(label_str);
-                label_counts[sample.label]++;
                 num_labels = std::max(num_labels, sample.label + 1); //* 确保num_labels为当前最大的标签数，+1是因为sample.label从0开始
 
-                parse_packet_features(feature_str, sample);
+                if (!parse_packet_features(feature_str, sample))
+                    continue;
+                label_counts[sample.label]++;
                 samples.push_back(sample);
             }
         }
 
+        print_distribution(label_counts);
+
+        // csv本身不含网站名称，读取同目录下TLSRecordToCsv生成的标签映射
+        size_t last_slash = csv_path.find_last_of('/');
+        std::string label_map_path = (last_slash == std::string::npos ? std::string(".") : csv_path.substr(0, last_slash)) + "/site_labels.csv";
+        LabelMap label_map;
+        if (label_map.load(label_map_path))
+        {
+            for (size_t i = 0; i < label_map.size(); ++i)
+                label_names.push_back({static_cast<int>(i), label_map.name(static_cast<int>(i))});
+        }
+    }
+
+    void print_distribution(const std::unordered_map<int, int> &label_counts) const
+    {
         // 打印数据分布
         std::cout << "[INFO] Data distribution:" << std::endl;
         for (const auto &pair : label_counts)
@@ -104,11 +209,12 @@ private:
     @brief 解析某一个样本的特征字符串，提取其中的参数(大小和方向)，归一化并添加到sample。同时更新最大序列长度。
     @param feature_str 特征字符串
     @param sample feature_str对应的sample
+    @return 样本按窗口策略被丢弃时返回false
     */
-    void parse_packet_features(const std::string &feature_str, Sample &sample)
+    bool parse_packet_features(const std::string &feature_str, Sample &sample)
     {
-        std::vector<float> packet_sizes; // 一个样本中每个包大小的向量
-        std::vector<float> directions;   // 一个样本中每个包方向的向量
+        std::vector<uint16_t> sizes;    // 一个样本中每个包大小的向量
+        std::vector<int8_t> directions; // 一个样本中每个包方向的向量
 
         std::istringstream feature_stream(feature_str);
         std::string packet_info;
@@ -124,16 +230,8 @@ private:
                     int size = std::stoi(packet_info.substr(0, delim_pos));
                     int direction = std::stoi(packet_info.substr(delim_pos + 1));
 
-                    // 对数归一化包大小，保持在[0,1]范围
-                    float normalized_size = std::log(static_cast<float>(size) + 1.0f) / std::log(1501.0f);
-                    normalized_size = std::min(1.0f, std::max(0.0f, normalized_size)); //* 正溢为1，负溢为0
-
-                    packet_sizes.push_back(normalized_size);
-                    directions.push_back(static_cast<float>(direction));
-
-                    // 添加包特征到序列中
-                    sample.features.push_back(normalized_size);
-                    sample.features.push_back(static_cast<float>(direction));
+                    sizes.push_back(static_cast<uint16_t>(std::min(std::max(size, 0), 65535)));
+                    directions.push_back(static_cast<int8_t>(direction));
                 }
                 catch (const std::exception &e)
                 {
@@ -143,50 +241,32 @@ private:
             }
         }
 
-        // 更新最大序列长度
-        int current_length = sample.features.size() / PACKET_FEATURES;
-        max_sequence_length = std::max(max_sequence_length, current_length);
-
-        // 计算并添加统计特征
-        add_statistical_features(sample, packet_sizes, directions);
+        return add_record_features(sizes.data(), directions.data(), sizes.size(), sample);
     }
 
     /*
-    @brief 计算统计特征，并添加到当前样本尾部
-    @param sample 当前样本
-    @param sizes 当前样本中每个包的大小的集合
-    @param directions 当前样本中每个包的方向的集合
+    @brief 将一个样本的记录序列(大小和方向)归一化并添加到sample，同时更新最大序列长度。csv和二进制数据集共用此函数，
+           特征由Featurizer计算，与预测和在线分类一致
+    @return 样本超过窗口长度且策略为DROP时返回false，sample不变
     */
-    void add_statistical_features(Sample &sample,
-                                  const std::vector<float> &sizes,
-                                  const std::vector<float> &directions)
+    bool add_record_features(const uint16_t *sizes, const int8_t *directions, size_t length, Sample &sample)
     {
-        if (sizes.empty())
-            return;
-
-        // 包大小统计
-        float avg_size = std::accumulate(sizes.begin(), sizes.end(), 0.0f) / sizes.size();
-        float max_size = *std::max_element(sizes.begin(), sizes.end());
-        float min_size = *std::min_element(sizes.begin(), sizes.end());
-
-        // 计算标准差
-        float variance = 0.0f;
-        for (float size : sizes)
+        if (window.max_records > 0 && length > static_cast<size_t>(window.max_records))
         {
-            variance += (size - avg_size) * (size - avg_size);
+            truncated_samples++;
+            if (window.policy == TruncationPolicy::DROP)
+                return false;
+            length = static_cast<size_t>(window.max_records);
         }
-        float std_dev = std::sqrt(variance / sizes.size());
-
-        // 方向统计
-        float outgoing_ratio = std::count(directions.begin(), directions.end(), 1.0f) /
-                               static_cast<float>(directions.size());
+        total_records += length;
 
-        // 总包数（归一化）
-        float total_packets = std::log(static_cast<float>(sizes.size()) + 1.0f) / std::log(101.0f);
+        // 记录特征之后紧跟统计特征，补齐到最大序列长度的工作在normalize_features中完成
+        sample.features.resize(length * PACKET_FEATURES + STATS_FEATURES);
+        Featurizer::featurize(sizes, directions, length, sample.features.data(), sample.features.data() + length * PACKET_FEATURES);
 
-        // 将统计特征暂存，稍后添加
-        sample.features.insert(sample.features.end(),
-                               {avg_size, max_size, min_size, std_dev, outgoing_ratio, total_packets});
+        // 更新最大序列长度
+        max_sequence_length = std::max(max_sequence_length, static_cast<int>(length));
+        return true;
     }
 
     void normalize_features()
@@ -195,44 +275,30 @@ private:
 
         for (auto &sample : samples)
         {
-            // 分离序列特征和统计特征
-            std::vector<float> stats_features;
-            if (sample.features.size() >= STATS_FEATURES)
-            {
-                stats_features.assign(sample.features.end() - STATS_FEATURES, sample.features.end());
-                sample.features.erase(sample.features.end() - STATS_FEATURES, sample.features.end());
-            }
-
-            // 填充序列特征到固定长度
-            int current_length = sample.features.size() / PACKET_FEATURES;
+            // 在序列特征和统计特征之间补0，序列特征填充到固定长度
+            int current_length = static_cast<int>(sample.features.size() - STATS_FEATURES) / PACKET_FEATURES;
             if (current_length < max_sequence_length)
             {
                 int padding_needed = (max_sequence_length - current_length) * PACKET_FEATURES;
-                sample.features.resize(sample.features.size() + padding_needed, 0.0f);
+                sample.features.insert(sample.features.end() - STATS_FEATURES, padding_needed, 0.0f);
             }
-
-            // 重新添加统计特征
-            sample.features.insert(sample.features.end(), stats_features.begin(), stats_features.end());
         }
 
         std::cout << "[INFO] Final feature dimension: " << get_feature_dim() << std::endl;
     }
 
-    void shuffle_and_split()
+    void shuffle_and_split(unsigned seed)
     {
         // 随机打乱
-        auto rng = std::default_random_engine(std::random_device{}());
+        auto rng = std::default_random_engine(seed != 0 ? seed : std::random_device{}());
         std::shuffle(samples.begin(), samples.end(), rng);
 
         // 分割数据集
         size_t test_size = static_cast<size_t>(samples.size() * test_ratio);
-        size_t train_size = samples.size() - test_size;
-
-        train_samples.assign(samples.begin(), samples.begin() + train_size);
-        test_samples.assign(samples.begin() + train_size, samples.end());
+        train_size = samples.size() - test_size;
 
-        std::cout << "[INFO] Train samples: " << train_samples.size()
-                  << ", Test samples: " << test_samples.size() << std::endl;
+        std::cout << "[INFO] Train samples: " << train_size
+                  << ", Test samples: " << test_size << std::endl;
     }
 };
 
@@ -14,6 +14,9 @@
 #include "Parser.hpp"
 #include "FileLoader.hpp"
 #include "DomainManager.hpp"
+#include "FeatureDataset.hpp"
+#include "ShardedDataset.hpp"
+#include "LabelMap.hpp"
 
 class TLSRecordToCsv
 {
@@ -22,8 +25,11 @@ private:
     Parser &parser;
 
     std::string output_csv_path;
+    std::string output_dataset_path;
+    std::string output_shard_dir;
     std::string label_map_path;
     int sample_count = 0;
+    size_t num_shards = 0; // 大于0时按pcap哈希写出num_shards个分片(见ShardedDataset)，不再写单个数据集文件
 
 public:
     TLSRecordToCsv(Parser &parser_ref, const std::string &output_dir = "../output")
@@ -31,11 +37,81 @@ public:
     {
         ensure_output_directory(output_dir);
         output_csv_path = output_dir + "/tls_features.csv";
+        output_dataset_path = output_dir + "/tls_features.bin";
+        output_shard_dir = output_dir + "/shards";
         label_map_path = output_dir + "/site_labels.csv";
         initialize_site_labels();
     }
 
-    // 生成CSV文件：将每个pcap文件的TLS记录序列转换为一行特征数据
+    void set_num_shards(size_t shards) { num_shards = shards; }
+    size_t get_num_shards() const { return num_shards; }
+
+    // 生成二进制数据集：每个pcap文件的TLS记录序列直接按列写入，训练和预测时mmap使用
+    bool generate_dataset()
+    {
+        std::cout << "[INFO] Generating binary dataset for CNN training..." << std::endl;
+
+        const TLSTraceStore &store = parser.get_trace_store();
+        std::vector<int> site_id_labels = resolve_site_labels(store);
+
+        FeatureDatasetWriter writer;
+        ShardedDatasetWriter sharded_writer(num_shards);
+        for (size_t i = 0; i < store.num_traces(); ++i)
+        {
+            TraceView trace = store.trace(i);
+            int site_label = site_id_labels[trace.info->site_id];
+            if (site_label < 0)
+                continue;
+            if (num_shards > 0)
+                sharded_writer.add_sample(shard_format::key_hash(store.site_name(*trace.info), store.file_name(*trace.info)),
+                                          site_label, trace.sizes, trace.directions, trace.length);
+            else
+                writer.add_sample(site_label, trace.sizes, trace.directions, trace.length);
+        }
+
+        if (num_shards > 0 ? !write_dataset(sharded_writer) : !write_dataset(writer))
+            return false;
+
+        std::cout << "[INFO] Dataset generation completed." << std::endl;
+        std::cout << "[INFO] Total samples: " << (num_shards > 0 ? sharded_writer.num_samples() : writer.num_samples()) << std::endl;
+        std::cout << "[INFO] Dataset " << (num_shards > 0 ? "shards: " : "file: ") << get_dataset_path() << std::endl;
+        std::cout << "[INFO] Label map: " << label_map_path << std::endl;
+
+        return true;
+    }
+
+    // 网站名称对应的标签，不在标签映射中时返回-1
+    int label_of(const std::string &site_name) const
+    {
+        auto it = site_labels.find(site_name);
+        return it != site_labels.end() ? it->second : -1;
+    }
+
+    // 写入标签表后保存writer中的样本，并生成标签映射文件
+    bool write_dataset(FeatureDatasetWriter &writer)
+    {
+        for (const auto &pair : sorted_site_labels())
+            writer.add_label(pair.first, pair.second);
+        if (!writer.write(output_dataset_path))
+            return false;
+        generate_label_map();
+        return true;
+    }
+
+    // 写入标签表后保存所有分片和清单
+    bool write_dataset(ShardedDatasetWriter &writer)
+    {
+        for (const auto &pair : sorted_site_labels())
+            writer.add_label(pair.first, pair.second);
+        if (!writer.write(output_shard_dir))
+            return false;
+        generate_label_map();
+        return true;
+    }
+
+    const std::string &get_dataset_path() const { return num_shards > 0 ? output_shard_dir : output_dataset_path; }
+
+    // 生成CSV文件：将每个pcap文件的TLS记录序列转换为一行特征数据(仅用于调试查看)
     bool generate_csv()
     {
         std::cout << "[INFO] Generating CSV file for CNN training..." << std::endl;
@@ -49,49 +125,37 @@ public:
 
         // CSV格式：site_label,packet_features
         // 其中packet_features格式：387_0;1492_1;1000_1;198_0 (大小_方向;大小_方向;...)
-        ofs << "site_label,packet_features" << std::endl;
+        ofs << "site_label,packet_features\n";
 
-        auto &records_map = parser.get_tls_records_map();
+        const TLSTraceStore &store = parser.get_trace_store();
+        std::vector<int> site_id_labels = resolve_site_labels(store);
 
-        // 遍历每个网站
-        for (const auto &site_pair : records_map)
+        // 遍历每个pcap文件对应的trace
+        for (size_t i = 0; i < store.num_traces(); ++i)
         {
-            std::string site_name = site_pair.first;
-
-            // 检查站点是否在标签映射中
-            if (site_labels.find(site_name) == site_labels.end())
-            {
-                std::cerr << "[WARN] Site not found in labels: " << site_name << std::endl;
+            TraceView trace = store.trace(i);
+            int site_label = site_id_labels[trace.info->site_id];
+            if (site_label < 0)
                 continue;
-            }
 
-            int site_label = site_labels[site_name];
-            const auto &site_files = site_pair.second;
+            // 将一个pcap文件的所有TLS记录转换为特征字符串
+            std::string feature_str = convert_records_to_features(trace);
 
-            // 遍历该网站的每个pcap文件
-            for (const auto &file_pair : site_files)
+            if (!feature_str.empty())
             {
-                const std::string &filename = file_pair.first;
-                const auto &tls_records = file_pair.second;
+                ofs << site_label << "," << feature_str << '\n'; // 不逐行flush
+                sample_count++;
 
-                // 将一个pcap文件的所有TLS记录转换为特征字符串
-                std::string feature_str = convert_records_to_features(tls_records);
-
-                if (!feature_str.empty())
+                if (sample_count % 100 == 0)
                 {
-                    ofs << site_label << "," << feature_str << std::endl;
-                    sample_count++;
-
-                    if (sample_count % 100 == 0)
-                    {
-                        std::cout << "[INFO] Processed " << sample_count << " samples..." << std::endl;
-                    }
+                    LOG_INFO << "Processed " << sample_count << " samples...";
                 }
             }
         }
 
         ofs.close();
         generate_label_map();
+        Logger::instance()->flush();
 
         std::cout << "[INFO] CSV generation completed." << std::endl;
         std::cout << "[INFO] Total samples: " << sample_count << std::endl;
@@ -105,20 +169,50 @@ private:
     // 初始化站点标签映射：为每个网站分配一个唯一的数字标签
     void initialize_site_labels()
     {
-        // 从domain_list.txt获取所有域名，确保标签分配的一致性
-        std::vector<std::string> domains = DomainManager::instance()->get_domains();
+        // 从domain_list.txt获取所有域名，网站名排序去重后按顺序编号：同一个域名列表在任何节点、任何一次运行中
+        // 得到相同且连续的标签(多个域名对应同一网站时不留空号)，分片数据集和解析缓存都依赖这一点
+        std::vector<std::string> sites;
+        for (const auto &domain : DomainManager::instance()->get_domains())
+            sites.push_back(LabelMap::site_name_from_domain(domain));
+        std::sort(sites.begin(), sites.end());
+        sites.erase(std::unique(sites.begin(), sites.end()), sites.end());
+
+        for (size_t i = 0; i < sites.size(); ++i)
+            site_labels[sites[i]] = static_cast<int>(i);
 
-        for (size_t i = 0; i < domains.size(); ++i)
+        std::cout << "[INFO] Initialized " << site_labels.size() << " site labels:" << std::endl;
+        for (const auto &site : sites)
         {
-            std::string site_name = extract_site_name_from_domain(domains[i]);
-            site_labels[site_name] = static_cast<int>(i);
+            std::cout << "  " << site << " -> " << site_labels[site] << std::endl;
         }
+    }
 
-        std::cout << "[INFO] Initialized " << site_labels.size() << " site labels:" << std::endl;
+    // 站点编号 -> 标签，-1表示该站点不在标签映射中
+    std::vector<int> resolve_site_labels(const TLSTraceStore &store)
+    {
+        std::vector<int> site_id_labels(store.get_sites().size(), -1);
+        for (size_t site_id = 0; site_id < site_id_labels.size(); ++site_id)
+        {
+            const std::string &site_name = store.get_sites().get(static_cast<uint32_t>(site_id));
+            auto it = site_labels.find(site_name);
+            if (it != site_labels.end())
+                site_id_labels[site_id] = it->second;
+            else
+                std::cerr << "[WARN] Site not found in labels: " << site_name << std::endl;
+        }
+        return site_id_labels;
+    }
+
+    // 按标签值排序的 (标签, 网站名称) 列表
+    std::vector<std::pair<int, std::string>> sorted_site_labels() const
+    {
+        std::vector<std::pair<int, std::string>> sorted_labels;
         for (const auto &pair : site_labels)
         {
-            std::cout << "  " << pair.first << " -> " << pair.second << std::endl;
+            sorted_labels.push_back({pair.second, pair.first});
         }
+        std::sort(sorted_labels.begin(), sorted_labels.end());
+        return sorted_labels;
     }
 
     // 生成标签映射文件
@@ -131,28 +225,21 @@ private:
             return;
         }
 
-        ofs << "label,site_name" << std::endl;
+        ofs << "label,site_name\n";
 
         // 按标签值排序输出
-        std::vector<std::pair<int, std::string>> sorted_labels;
-        for (const auto &pair : site_labels)
+        for (const auto &pair : sorted_site_labels())
         {
-            sorted_labels.push_back({pair.second, pair.first});
-        }
-        std::sort(sorted_labels.begin(), sorted_labels.end());
-
-        for (const auto &pair : sorted_labels)
-        {
-            ofs << pair.first << "," << pair.second << std::endl;
+            ofs << pair.first << "," << pair.second << "\n";
         }
 
         ofs.close();
     }
 
     // 将TLS记录序列转换为特征字符串
-    std::string convert_records_to_features(const std::vector<TLSRecord> &records)
+    std::string convert_records_to_features(const TraceView &trace)
     {
-        if (records.empty())
+        if (trace.length == 0)
         {
             return "";
         }
@@ -162,15 +249,15 @@ private:
 
         // 格式：包大小_方向;包大小_方向;...
         // 例如：387_0;1492_1;1000_1;198_0
-        for (const auto &record : records)
+        for (size_t i = 0; i < trace.length; ++i)
         {
-            if (record.frame_length > 0 && record.tls_direction >= 0)
+            if (trace.sizes[i] > 0 && trace.directions[i] >= 0)
             {
                 if (!first)
                 {
                     ss << ";";
                 }
-                ss << record.frame_length << "_" << record.tls_direction;
+                ss << trace.sizes[i] << "_" << static_cast<int>(trace.directions[i]);
                 first = false;
             }
         }
@@ -178,29 +265,6 @@ private:
         return ss.str();
     }
 
-    // 从域名提取网站名称 (www.baidu.com -> baidu)
-    static std::string extract_site_name_from_domain(const std::string &domain)
-    {
-        std::vector<std::string> parts;
-        std::stringstream ss(domain);
-        std::string part;
-
-        while (std::getline(ss, part, '.'))
-        {
-            parts.push_back(part);
-        }
-
-        if (parts.size() >= 2)
-        {
-            return parts[parts.size() - 2]; // 倒数第二部分
-        }
-        else
-        {
-            std::cerr << "[WARN] Invalid domain format: " << domain << std::endl;
-            return domain;
-        }
-    }
-
     // 确保输出目录存在
     bool ensure_output_directory(const std::string &dir_path)
     {
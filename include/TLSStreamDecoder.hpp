@@ -0,0 +1,227 @@
+/*
+TLSStreamDecoder在每个TCP单向流上跟踪TLS记录的边界，从而在不做完整TCP重组的前提下
+判断一个数据包是否"包含TLS记录"(等价于tshark的 -Y tls)，并取出其中第一个握手消息类型(等价于 -E occurrence=f)。
+
+tshark只在TLS记录完整(重组完成)的那个数据包上标记tls层，所以这里的规则是：
+一个数据包中至少有一个TLS记录在此结束，则认为它是TLS数据包。
+*/
+#ifndef _TLS_STREAM_DECODER_HPP_
+#define _TLS_STREAM_DECODER_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include "PcapReader.hpp"
+
+// 单个数据包的TLS解析结果
+struct TLSPacketInfo
+{
+    bool is_tls = false;         // 本包中是否有TLS记录结束
+    int tls_handshake_type = -1; // 本包中第一个握手消息类型，没有则为-1
+};
+
+class TLSStreamDecoder
+{
+public:
+    // TCP单向流上的TLS记录状态
+    struct StreamState
+    {
+        bool synced = false;          // 是否已对齐到TLS记录边界
+        bool encrypted = false;       // 是否已收到ChangeCipherSpec(之后的握手消息是加密的)
+        uint32_t next_seq = 0;        // 期望的下一个TCP序号
+        uint32_t record_remaining = 0; // 当前记录剩余未读的字节数
+        uint32_t record_consumed = 0;  // 当前记录已读的字节数
+        uint8_t content_type = 0;     // 当前记录的类型
+        int handshake_type = -1;      // 当前记录中的第一个握手类型
+        uint8_t header[5]{};          // 跨包的记录头缓存
+        uint8_t header_len = 0;
+    };
+
+private:
+    static const uint32_t MAX_RECORD_LENGTH = (1 << 14) + 2048; // RFC 8446允许的最大密文长度
+
+    // TCP单向流的标识
+    struct StreamKey
+    {
+        uint8_t src_addr[16];
+        uint8_t dst_addr[16];
+        uint16_t src_port;
+        uint16_t dst_port;
+
+        bool operator==(const StreamKey &other) const
+        {
+            return std::memcmp(this, &other, sizeof(StreamKey)) == 0;
+        }
+    };
+
+    struct StreamKeyHash
+    {
+        size_t operator()(const StreamKey &key) const
+        {
+            // FNV-1a
+            const uint8_t *p = reinterpret_cast<const uint8_t *>(&key);
+            uint64_t h = 1469598103934665603ULL;
+            for (size_t i = 0; i < sizeof(StreamKey); ++i)
+            {
+                h ^= p[i];
+                h *= 1099511628211ULL;
+            }
+            return static_cast<size_t>(h);
+        }
+    };
+
+    std::unordered_map<StreamKey, StreamState, StreamKeyHash> streams;
+
+public:
+    void reset() { streams.clear(); }
+
+    size_t num_streams() const { return streams.size(); }
+
+    TLSPacketInfo process(const TCPPacket &tcp)
+    {
+        TLSPacketInfo info;
+
+        StreamKey key;
+        std::memset(&key, 0, sizeof(key));
+        std::memcpy(key.src_addr, tcp.src_addr, sizeof(key.src_addr));
+        std::memcpy(key.dst_addr, tcp.dst_addr, sizeof(key.dst_addr));
+        key.src_port = tcp.src_port;
+        key.dst_port = tcp.dst_port;
+
+        bool syn = tcp.flags & 0x02;
+        if (!syn && tcp.payload_len == 0)
+            return info;
+        return process(tcp, streams[key]);
+    }
+
+    /*
+    @brief 在调用者持有的单向流状态上处理一个数据包，不查找内部的流表
+           (在线跟踪时每个连接的状态直接放在流表的节点里)
+    */
+    static TLSPacketInfo process(const TCPPacket &tcp, StreamState &state)
+    {
+        TLSPacketInfo info;
+
+        bool syn = tcp.flags & 0x02;
+        if (syn)
+        {
+            // 新连接，丢弃旧状态，SYN占用一个序号
+            state = StreamState();
+            state.next_seq = tcp.seq + 1;
+            return info;
+        }
+
+        if (tcp.payload_len == 0)
+            return info;
+
+        const uint8_t *payload = tcp.payload;
+        uint32_t len = tcp.payload_len;
+        uint32_t seq = tcp.seq;
+
+        if (state.synced)
+        {
+            int32_t diff = static_cast<int32_t>(seq - state.next_seq);
+            if (diff < 0) // 重传或部分重叠，丢弃已处理过的部分
+            {
+                uint32_t overlap = static_cast<uint32_t>(-diff);
+                if (overlap >= len)
+                    return info;
+                payload += overlap;
+                len -= overlap;
+                seq += overlap;
+            }
+            else if (diff > 0) // 丢包导致的空洞，尝试在本包起始处重新对齐
+            {
+                state.synced = false;
+            }
+        }
+
+        if (!state.synced)
+        {
+            if (!looks_like_record_header(payload, len))
+                return info;
+            bool encrypted = state.encrypted;
+            state = StreamState();
+            state.encrypted = encrypted;
+            state.synced = true;
+        }
+
+        state.next_seq = seq + len;
+        walk_records(state, payload, len, info);
+        return info;
+    }
+
+private:
+    static bool valid_header(uint8_t content_type, uint8_t major, uint8_t minor, uint32_t length)
+    {
+        return content_type >= 20 && content_type <= 24 && major == 3 && minor <= 4 && length <= MAX_RECORD_LENGTH;
+    }
+
+    static bool looks_like_record_header(const uint8_t *p, uint32_t len)
+    {
+        if (len < 5)
+            return false;
+        return valid_header(p[0], p[1], p[2], (static_cast<uint32_t>(p[3]) << 8) | p[4]);
+    }
+
+    // 按记录边界遍历TCP载荷
+    static void walk_records(StreamState &state, const uint8_t *p, uint32_t len, TLSPacketInfo &info)
+    {
+        uint32_t pos = 0;
+        while (pos < len)
+        {
+            if (state.record_remaining == 0 && state.header_len < 5) // 读取记录头
+            {
+                uint32_t take = std::min<uint32_t>(5 - state.header_len, len - pos);
+                std::memcpy(state.header + state.header_len, p + pos, take);
+                state.header_len += take;
+                pos += take;
+                if (state.header_len < 5)
+                    break;
+
+                uint32_t record_length = (static_cast<uint32_t>(state.header[3]) << 8) | state.header[4];
+                if (!valid_header(state.header[0], state.header[1], state.header[2], record_length))
+                {
+                    state.synced = false; // 失去同步，等待下一个看起来像记录头的包
+                    break;
+                }
+                state.content_type = state.header[0];
+                state.record_remaining = record_length;
+                state.record_consumed = 0;
+                state.handshake_type = -1;
+
+                if (record_length == 0)
+                {
+                    finish_record(state, info);
+                    continue;
+                }
+            }
+
+            uint32_t take = std::min(state.record_remaining, len - pos);
+            if (take > 0 && state.record_consumed == 0 && state.content_type == 22 && !state.encrypted)
+            {
+                state.handshake_type = p[pos]; // 握手消息的第一个字节为类型
+            }
+            state.record_remaining -= take;
+            state.record_consumed += take;
+            pos += take;
+
+            if (state.record_remaining == 0)
+                finish_record(state, info);
+        }
+    }
+
+    static void finish_record(StreamState &state, TLSPacketInfo &info)
+    {
+        info.is_tls = true;
+        if (state.content_type == 22 && info.tls_handshake_type < 0)
+            info.tls_handshake_type = state.handshake_type;
+        if (state.content_type == 20) // ChangeCipherSpec之后的握手消息均为密文
+            state.encrypted = true;
+        state.header_len = 0;
+    }
+};
+
+#endif // _TLS_STREAM_DECODER_HPP_
@@ -0,0 +1,172 @@
+/*
+TLSTraceStore为按列存储的TLS记录序列容器。一个trace对应一个pcap文件(即一个样本)，
+所有trace的记录连续存放在 size / direction / handshake_type 三个数组中，每个trace只记录自己在数组中的偏移和长度。
+站点名、文件名和IP地址都只驻留一份，trace中保存的是它们的编号。每条记录只占4字节。
+*/
+#ifndef _TLS_TRACE_STORE_HPP_
+#define _TLS_TRACE_STORE_HPP_
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <deque>
+
+// 字符串驻留表：相同的字符串只保存一份，用编号引用
+class StringInterner
+{
+private:
+    std::deque<std::string> strings; // deque保证扩容时已有字符串的地址不变，index中的string_view始终有效
+    std::unordered_map<std::string_view, uint32_t> index;
+
+public:
+    static const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    uint32_t intern(std::string_view str)
+    {
+        auto it = index.find(str);
+        if (it != index.end())
+            return it->second;
+        uint32_t id = static_cast<uint32_t>(strings.size());
+        strings.emplace_back(str);
+        index.emplace(std::string_view(strings.back()), id);
+        return id;
+    }
+
+    const std::string &get(uint32_t id) const
+    {
+        static const std::string empty;
+        return id < strings.size() ? strings[id] : empty;
+    }
+
+    size_t size() const { return strings.size(); }
+};
+
+// 一个trace的元数据
+struct TraceInfo
+{
+    uint32_t site_id = StringInterner::NONE;
+    uint32_t file_id = StringInterner::NONE;
+    uint32_t client_ip_id = StringInterner::NONE;
+    uint32_t server_ip_id = StringInterner::NONE;
+    uint64_t offset = 0; // 在列数组中的起始位置
+    uint32_t length = 0; // 记录数
+};
+
+// 一个trace的只读视图，指针指向TLSTraceStore内部的列数组
+struct TraceView
+{
+    const TraceInfo *info;
+    const uint16_t *sizes;
+    const int8_t *directions;
+    const uint8_t *handshake_types;
+    size_t length;
+};
+
+class TLSTraceStore
+{
+public:
+    static const uint8_t HANDSHAKE_NONE = 0xFF; // 非握手记录
+    static const uint16_t MAX_SIZE = std::numeric_limits<uint16_t>::max();
+
+private:
+    StringInterner sites;
+    StringInterner files;
+    StringInterner addresses;
+
+    std::vector<TraceInfo> traces;
+    std::vector<uint16_t> sizes;
+    std::vector<int8_t> directions;
+    std::vector<uint8_t> handshake_types;
+
+    bool building = false;
+
+public:
+    // 开始一个新的trace，之后通过push_record追加记录，最后调用end_trace
+    void begin_trace(std::string_view site_name, std::string_view file_name)
+    {
+        TraceInfo info;
+        info.site_id = sites.intern(site_name);
+        info.file_id = files.intern(file_name);
+        info.offset = sizes.size();
+        traces.push_back(info);
+        building = true;
+    }
+
+    /*
+    @brief 向当前trace追加一条记录
+    @param ip_src/ip_dst 仅用于在第一次确定方向时驻留该trace的客户端和服务端地址
+    */
+    void push_record(int frame_length, int tls_handshake_type, int tls_direction,
+                     std::string_view ip_src = {}, std::string_view ip_dst = {})
+    {
+        TraceInfo &info = traces.back();
+        if (info.client_ip_id == StringInterner::NONE && tls_direction >= 0 && !ip_src.empty())
+        {
+            info.client_ip_id = addresses.intern(tls_direction == 0 ? ip_src : ip_dst);
+            info.server_ip_id = addresses.intern(tls_direction == 0 ? ip_dst : ip_src);
+        }
+
+        sizes.push_back(static_cast<uint16_t>(std::min<int>(std::max(frame_length, 0), MAX_SIZE)));
+        directions.push_back(static_cast<int8_t>(tls_direction));
+        handshake_types.push_back(tls_handshake_type >= 0 && tls_handshake_type < HANDSHAKE_NONE
+                                      ? static_cast<uint8_t>(tls_handshake_type)
+                                      : HANDSHAKE_NONE);
+        info.length++;
+    }
+
+    // 结束当前trace，keep_empty为false时丢弃没有任何记录的trace
+    void end_trace(bool keep_empty = false)
+    {
+        if (building && !keep_empty && traces.back().length == 0)
+            traces.pop_back();
+        building = false;
+    }
+
+    // 追加另一个store中的一个trace(用于合并线程私有的store)
+    void append_trace(const TLSTraceStore &other, size_t index)
+    {
+        TraceView view = other.trace(index);
+        begin_trace(other.site_name(*view.info), other.file_name(*view.info));
+        TraceInfo &info = traces.back();
+        if (view.info->client_ip_id != StringInterner::NONE)
+        {
+            info.client_ip_id = addresses.intern(other.addresses.get(view.info->client_ip_id));
+            info.server_ip_id = addresses.intern(other.addresses.get(view.info->server_ip_id));
+        }
+        sizes.insert(sizes.end(), view.sizes, view.sizes + view.length);
+        directions.insert(directions.end(), view.directions, view.directions + view.length);
+        handshake_types.insert(handshake_types.end(), view.handshake_types, view.handshake_types + view.length);
+        info.length = static_cast<uint32_t>(view.length);
+        building = false;
+    }
+
+    void reserve_records(size_t count)
+    {
+        sizes.reserve(count);
+        directions.reserve(count);
+        handshake_types.reserve(count);
+    }
+
+    size_t num_traces() const { return traces.size(); }
+    size_t num_records() const { return sizes.size(); }
+    bool empty() const { return traces.empty(); }
+
+    TraceView trace(size_t index) const
+    {
+        const TraceInfo &info = traces[index];
+        return TraceView{&info, sizes.data() + info.offset, directions.data() + info.offset,
+                         handshake_types.data() + info.offset, info.length};
+    }
+
+    const std::string &site_name(const TraceInfo &info) const { return sites.get(info.site_id); }
+    const std::string &file_name(const TraceInfo &info) const { return files.get(info.file_id); }
+    const std::string &client_ip(const TraceInfo &info) const { return addresses.get(info.client_ip_id); }
+    const std::string &server_ip(const TraceInfo &info) const { return addresses.get(info.server_ip_id); }
+    const StringInterner &get_sites() const { return sites; }
+};
+
+#endif // _TLS_TRACE_STORE_HPP_
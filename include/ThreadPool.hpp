@@ -0,0 +1,180 @@
+/*
+WorkStealingPool为一个简单的工作窃取线程池：每个工作线程拥有自己的任务队列，
+自己的任务做完后从其他线程队列的另一端窃取任务，适合耗时差异很大的任务(如大小悬殊的pcap文件)。
+调用parallel_for的线程本身作为0号工作线程参与执行，因此单线程时不会创建任何额外线程。
+*/
+#ifndef _THREAD_POOL_HPP_
+#define _THREAD_POOL_HPP_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+class WorkStealingPool
+{
+private:
+    struct WorkQueue
+    {
+        std::mutex mtx;
+        std::deque<size_t> tasks;
+    };
+
+    size_t num_workers;
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    std::mutex mtx;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    const std::function<void(size_t, size_t)> *job = nullptr; // (task_index, worker_index)
+    size_t generation = 0;
+    size_t active_workers = 0;
+    bool stopping = false;
+    std::exception_ptr first_exception;
+
+public:
+    // num_threads为0时使用硬件线程数
+    explicit WorkStealingPool(size_t num_threads = 0)
+    {
+        num_workers = num_threads > 0 ? num_threads : std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < num_workers; ++i)
+            queues.push_back(std::make_unique<WorkQueue>());
+        for (size_t i = 1; i < num_workers; ++i)
+            threads.emplace_back(&WorkStealingPool::worker_loop, this, i);
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        start_cv.notify_all();
+        for (auto &t : threads)
+            t.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool &other) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &other) = delete;
+
+    size_t size() const { return num_workers; }
+
+    /*
+    @brief 并行执行num_tasks个任务，全部完成后返回。任务中抛出的第一个异常会在这里重新抛出
+    @param fn 任务函数，参数为(任务下标, 工作线程下标)，工作线程下标可用于访问线程私有的缓冲区
+    */
+    void parallel_for(size_t num_tasks, const std::function<void(size_t, size_t)> &fn)
+    {
+        if (num_tasks == 0)
+            return;
+
+        // 按连续的块分配任务，相邻的任务尽量由同一线程执行
+        size_t chunk = (num_tasks + num_workers - 1) / num_workers;
+        for (size_t w = 0; w < num_workers; ++w)
+        {
+            std::lock_guard<std::mutex> lock(queues[w]->mtx);
+            for (size_t t = w * chunk; t < std::min(num_tasks, (w + 1) * chunk); ++t)
+                queues[w]->tasks.push_back(t);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            job = &fn;
+            first_exception = nullptr;
+            active_workers = num_workers - 1;
+            generation++;
+        }
+        start_cv.notify_all();
+
+        run_tasks(0, fn);
+
+        std::unique_lock<std::mutex> lock(mtx);
+        done_cv.wait(lock, [this]
+                     { return active_workers == 0; });
+        job = nullptr;
+        if (first_exception)
+            std::rethrow_exception(first_exception);
+    }
+
+private:
+    void worker_loop(size_t worker)
+    {
+        size_t seen_generation = 0;
+        while (true)
+        {
+            const std::function<void(size_t, size_t)> *current_job;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                start_cv.wait(lock, [&]
+                              { return stopping || generation != seen_generation; });
+                if (stopping)
+                    return;
+                seen_generation = generation;
+                current_job = job;
+            }
+
+            run_tasks(worker, *current_job);
+
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                active_workers--;
+            }
+            done_cv.notify_one();
+        }
+    }
+
+    void run_tasks(size_t worker, const std::function<void(size_t, size_t)> &fn)
+    {
+        size_t task;
+        while (pop_local(worker, task) || steal(worker, task))
+        {
+            try
+            {
+                fn(task, worker);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (!first_exception)
+                    first_exception = std::current_exception();
+            }
+        }
+    }
+
+    // 从自己队列的前端取任务(保持块内顺序)
+    bool pop_local(size_t worker, size_t &task)
+    {
+        WorkQueue &q = *queues[worker];
+        std::lock_guard<std::mutex> lock(q.mtx);
+        if (q.tasks.empty())
+            return false;
+        task = q.tasks.front();
+        q.tasks.pop_front();
+        return true;
+    }
+
+    // 从其他线程队列的尾端窃取任务
+    bool steal(size_t worker, size_t &task)
+    {
+        for (size_t i = 1; i < num_workers; ++i)
+        {
+            WorkQueue &q = *queues[(worker + i) % num_workers];
+            std::lock_guard<std::mutex> lock(q.mtx);
+            if (!q.tasks.empty())
+            {
+                task = q.tasks.back();
+                q.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif // _THREAD_POOL_HPP_
@@ -0,0 +1,286 @@
+/*
+TraceCache为持久化的pcap解析结果缓存。每个pcap文件以路径为键，保存文件大小、修改时间、内容哈希以及解析出的TLS记录序列。
+再次运行时：大小和修改时间都未变化的文件直接复用缓存；元数据变化但内容哈希相同(例如被复制或touch)的文件同样复用；
+其余文件才需要重新解析。
+缓存只对生成它的记录预算(Parser::set_record_budget)有效：预算不同时trace的截断位置不同，整个缓存被忽略。
+
+缓存文件布局(小端)：
+    char magic[8] = "TLSCACHE", uint32 version, uint32 record_budget(0表示不限制), uint64 num_entries
+    每个条目：
+        uint32 path_len, char path[], uint32 site_len, char site[],
+        uint32 client_ip_len, char client_ip[], uint32 server_ip_len, char server_ip[],
+        uint64 file_size, int64 mtime_ns, uint64 content_hash, uint32 num_records,
+        uint16 sizes[num_records], int8 directions[num_records], uint8 handshake_types[num_records]
+*/
+#ifndef _TRACE_CACHE_HPP_
+#define _TRACE_CACHE_HPP_
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <sys/stat.h>
+
+#include "MappedFile.hpp"
+#include "TLSTraceStore.hpp"
+#include "Logger.hpp"
+
+// 判断文件是否变化所用的元数据
+struct FileStamp
+{
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+
+    bool operator==(const FileStamp &other) const { return size == other.size && mtime_ns == other.mtime_ns; }
+
+    static bool of(const std::string &path, FileStamp &stamp)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        stamp.size = static_cast<uint64_t>(st.st_size);
+        stamp.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+        return true;
+    }
+};
+
+class TraceCache
+{
+public:
+    struct Entry
+    {
+        std::string path;
+        FileStamp stamp;
+        uint64_t content_hash = 0;
+        size_t trace_index = 0; // 在store中的trace下标
+    };
+
+private:
+    static constexpr char MAGIC[8] = {'T', 'L', 'S', 'C', 'A', 'C', 'H', 'E'};
+    static const uint32_t VERSION = 1;
+
+    TLSTraceStore store; // 缓存的trace，空文件也保留，避免其被反复解析
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, size_t> index; // 路径 -> entries下标
+    uint32_t record_budget;                        // 解析这些trace时的记录预算
+
+public:
+    explicit TraceCache(size_t record_budget = 0) : record_budget(static_cast<uint32_t>(record_budget)) {}
+
+    // 文件内容的FNV-1a哈希
+    static uint64_t hash_file(const std::string &path)
+    {
+        MappedFile file;
+        if (!file.open(path))
+            return 0;
+        std::string_view data = file.data();
+        uint64_t h = 1469598103934665603ULL;
+        for (char c : data)
+        {
+            h ^= static_cast<uint8_t>(c);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    const Entry *find(const std::string &path) const
+    {
+        auto it = index.find(path);
+        return it == index.end() ? nullptr : &entries[it->second];
+    }
+
+    const TLSTraceStore &get_store() const { return store; }
+    size_t size() const { return entries.size(); }
+
+    // 从另一个store中复制一个trace作为path的缓存条目
+    void add(const std::string &path, const FileStamp &stamp, uint64_t content_hash,
+             const TLSTraceStore &source, size_t trace_index)
+    {
+        Entry entry;
+        entry.path = path;
+        entry.stamp = stamp;
+        entry.content_hash = content_hash;
+        entry.trace_index = store.num_traces();
+        store.append_trace(source, trace_index);
+
+        auto it = index.find(path);
+        if (it != index.end())
+        {
+            entries[it->second] = entry;
+            return;
+        }
+        index[path] = entries.size();
+        entries.push_back(entry);
+    }
+
+    // 加载缓存文件，文件不存在、格式不符或记录预算不同时返回false(视为空缓存)
+    bool load(const std::string &cache_path, size_t expected_budget = 0)
+    {
+        record_budget = static_cast<uint32_t>(expected_budget);
+        store = TLSTraceStore();
+        entries.clear();
+        index.clear();
+
+        struct stat st;
+        if (stat(cache_path.c_str(), &st) != 0)
+            return false;
+
+        MappedFile file;
+        if (!file.open(cache_path))
+            return false;
+        std::string_view data = file.data();
+        size_t pos = 0;
+
+        auto read = [&](void *out, size_t len)
+        {
+            if (pos + len > data.size())
+                return false;
+            std::memcpy(out, data.data() + pos, len);
+            pos += len;
+            return true;
+        };
+        auto read_string = [&](std::string &out)
+        {
+            uint32_t len;
+            if (!read(&len, sizeof(len)) || pos + len > data.size())
+                return false;
+            out.assign(data.data() + pos, len);
+            pos += len;
+            return true;
+        };
+
+        char magic[8];
+        uint32_t version, budget;
+        uint64_t num_entries;
+        if (!read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            !read(&version, sizeof(version)) || version != VERSION ||
+            !read(&budget, sizeof(budget)) || !read(&num_entries, sizeof(num_entries)))
+        {
+            LOG_WARN << "Ignoring invalid trace cache: " << cache_path;
+            return false;
+        }
+        if (budget != record_budget)
+        {
+            LOG_INFO << "Ignoring trace cache built with record budget " << budget << " (current: "
+                     << record_budget << "): " << cache_path;
+            return false;
+        }
+
+        for (uint64_t i = 0; i < num_entries; ++i)
+        {
+            std::string path, site, client_ip, server_ip;
+            FileStamp stamp;
+            uint64_t content_hash;
+            uint32_t num_records;
+            if (!read_string(path) || !read_string(site) || !read_string(client_ip) || !read_string(server_ip) ||
+                !read(&stamp.size, sizeof(stamp.size)) || !read(&stamp.mtime_ns, sizeof(stamp.mtime_ns)) ||
+                !read(&content_hash, sizeof(content_hash)) || !read(&num_records, sizeof(num_records)) ||
+                pos + static_cast<size_t>(num_records) * 4 > data.size())
+            {
+                LOG_WARN << "Truncated trace cache, keeping first " << entries.size() << " entries";
+                return true;
+            }
+
+            const uint8_t *base = reinterpret_cast<const uint8_t *>(data.data() + pos);
+            const uint8_t *directions = base + num_records * sizeof(uint16_t);
+            const uint8_t *handshake_types = directions + num_records;
+            pos += static_cast<size_t>(num_records) * 4;
+
+            Entry entry;
+            entry.path = path;
+            entry.stamp = stamp;
+            entry.content_hash = content_hash;
+            entry.trace_index = store.num_traces();
+
+            store.begin_trace(site, path.substr(path.find_last_of('/') + 1));
+            for (uint32_t r = 0; r < num_records; ++r)
+            {
+                uint16_t size;
+                std::memcpy(&size, base + r * sizeof(uint16_t), sizeof(size));
+                uint8_t handshake_type = handshake_types[r];
+                int8_t direction = static_cast<int8_t>(directions[r]);
+                // 端点地址只在第一条方向已知的记录上驻留
+                store.push_record(size, handshake_type == TLSTraceStore::HANDSHAKE_NONE ? -1 : handshake_type, direction,
+                                  direction == 0 ? client_ip : server_ip, direction == 0 ? server_ip : client_ip);
+            }
+            store.end_trace(true);
+
+            index[path] = entries.size();
+            entries.push_back(entry);
+        }
+        return true;
+    }
+
+    // 保存缓存，先写临时文件再rename
+    bool save(const std::string &cache_path) const
+    {
+        // 缓存先于数据集写入，输出目录可能尚未创建
+        size_t slash = cache_path.find_last_of('/');
+        if (slash != std::string::npos && slash > 0)
+        {
+            std::string dir_path = cache_path.substr(0, slash);
+            struct stat st;
+            if (stat(dir_path.c_str(), &st) != 0 && mkdir(dir_path.c_str(), 0755) != 0)
+            {
+                LOG_ERROR << "Failed to create directory: " << dir_path;
+                return false;
+            }
+        }
+
+        std::string tmp_path = cache_path + ".tmp";
+        std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open())
+        {
+            LOG_ERROR << "Failed to open trace cache: " << tmp_path;
+            return false;
+        }
+
+        auto write = [&](const void *data, size_t len)
+        { ofs.write(static_cast<const char *>(data), static_cast<std::streamsize>(len)); };
+        auto write_string = [&](const std::string &str)
+        {
+            uint32_t len = static_cast<uint32_t>(str.size());
+            write(&len, sizeof(len));
+            write(str.data(), len);
+        };
+
+        uint32_t version = VERSION;
+        uint64_t num_entries = entries.size();
+        write(MAGIC, sizeof(MAGIC));
+        write(&version, sizeof(version));
+        write(&record_budget, sizeof(record_budget));
+        write(&num_entries, sizeof(num_entries));
+
+        for (const auto &entry : entries)
+        {
+            TraceView trace = store.trace(entry.trace_index);
+            uint32_t num_records = static_cast<uint32_t>(trace.length);
+            write_string(entry.path);
+            write_string(store.site_name(*trace.info));
+            write_string(store.client_ip(*trace.info));
+            write_string(store.server_ip(*trace.info));
+            write(&entry.stamp.size, sizeof(entry.stamp.size));
+            write(&entry.stamp.mtime_ns, sizeof(entry.stamp.mtime_ns));
+            write(&entry.content_hash, sizeof(entry.content_hash));
+            write(&num_records, sizeof(num_records));
+            write(trace.sizes, num_records * sizeof(uint16_t));
+            write(trace.directions, num_records);
+            write(trace.handshake_types, num_records);
+        }
+
+        ofs.close();
+        if (!ofs || std::rename(tmp_path.c_str(), cache_path.c_str()) != 0)
+        {
+            LOG_ERROR << "Failed to write trace cache: " << cache_path;
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif // _TRACE_CACHE_HPP_
@@ -0,0 +1,425 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <benchmark/benchmark.h>
+
+#include "SyntheticData.hpp"
+#include "Parser.hpp"
+#include "TLSDataProcessor.hpp"
+#include "SimpleCNN.hpp"
+#include "FixedMLP.hpp"
+#include "QuantizedCNN.hpp"
+#include "FeatureDataset.hpp"
+
+// 基准测试：解析、数据加载、全连接层、推理延迟、训练吞吐以及端到端流程，全部使用SyntheticData生成的合成数据。
+// 用法：
+//     ./bench                                                    运行所有基准测试
+//     ./bench --benchmark_out=bench.json --benchmark_out_format=json   同时输出JSON，便于跨提交比较
+//     ./bench --benchmark_filter=FC                              只运行名称匹配的基准测试
+//     ./bench --generate <dir>                                   只生成合成语料(<dir>/data/<site>/*.pcap和数据集)
+
+namespace
+{
+const int NUM_LABELS = 4;
+const unsigned SEED = 20240601;
+const size_t PCAP_SESSIONS = 200; // 解析基准使用的pcap文件中的会话数
+const size_t DATASET_SAMPLES = 2000;
+
+std::string bench_dir;
+
+std::string path_in(const std::string &name) { return bench_dir + "/" + name; }
+
+// 构造函数中的日志会淹没基准测试的输出，测量期间暂时丢弃std::cout
+class QuietStdout
+{
+private:
+    std::ostringstream sink;
+    std::streambuf *saved;
+
+public:
+    QuietStdout() : saved(std::cout.rdbuf(sink.rdbuf())) {}
+    ~QuietStdout() { std::cout.rdbuf(saved); }
+};
+
+bool is_tshark_available()
+{
+    FILE *fp = popen("which tshark 2>/dev/null", "r");
+    if (!fp)
+        return false;
+    char buf[256];
+    bool found = fgets(buf, sizeof(buf), fp) != NULL;
+    pclose(fp);
+    return found;
+}
+
+void generate_inputs()
+{
+    std::vector<SyntheticTrace> sessions = SyntheticData::make_traces(PCAP_SESSIONS, NUM_LABELS, 20, 60, SEED);
+    SyntheticData::write_pcap(path_in("sessions.pcap"), sessions);
+
+    std::vector<SyntheticTrace> samples = SyntheticData::make_traces(DATASET_SAMPLES, NUM_LABELS, 10, 80, SEED + 1);
+    SyntheticData::write_dataset(path_in("tls_features.bin"), samples, NUM_LABELS);
+    SyntheticData::write_csv(path_in("tls_features.csv"), samples, NUM_LABELS);
+}
+
+// 生成与../data相同布局的合成语料：每个网站一个目录，每个会话一个pcap文件
+int generate_corpus(const std::string &dir, size_t sessions_per_site)
+{
+    mkdir(dir.c_str(), 0755);
+    mkdir((dir + "/data").c_str(), 0755);
+    std::vector<SyntheticTrace> traces = SyntheticData::make_traces(sessions_per_site * NUM_LABELS, NUM_LABELS, 10, 80, SEED);
+    std::ofstream domains(dir + "/domain_list.txt");
+    for (int label = 0; label < NUM_LABELS; ++label)
+    {
+        mkdir((dir + "/data/" + SyntheticData::site_name(label)).c_str(), 0755);
+        domains << "www." << SyntheticData::site_name(label) << ".com\n";
+    }
+    for (size_t i = 0; i < traces.size(); ++i)
+    {
+        std::string path = dir + "/data/" + SyntheticData::site_name(traces[i].label) + "/" + std::to_string(i) + ".pcap";
+        if (!SyntheticData::write_pcap(path, {traces[i]}, 1700000000000000ULL + i * 1000000ULL))
+            return 1;
+    }
+    SyntheticData::write_dataset(dir + "/tls_features.bin", traces, NUM_LABELS);
+    std::cout << "[INFO] Generated " << traces.size() << " sessions in " << dir << std::endl;
+    return 0;
+}
+
+std::vector<Sample> make_samples(size_t count, int input_dim)
+{
+    std::mt19937 rng(SEED);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<Sample> samples(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        samples[i].label = static_cast<int>(i % NUM_LABELS);
+        samples[i].features.resize(input_dim);
+        for (float &v : samples[i].features)
+            v = dist(rng);
+    }
+    return samples;
+}
+
+void fill_random(AlignedMatrix &m, size_t rows, size_t cols)
+{
+    std::mt19937 rng(SEED);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    m.resize(rows, cols);
+    for (size_t r = 0; r < rows; ++r)
+        for (size_t c = 0; c < cols; ++c)
+            m.row(r)[c] = dist(rng);
+}
+
+void set_percentiles(benchmark::State &state, std::vector<double> &latencies_us)
+{
+    if (latencies_us.empty())
+        return;
+    std::sort(latencies_us.begin(), latencies_us.end());
+    state.counters["p50_us"] = latencies_us[latencies_us.size() / 2];
+    state.counters["p99_us"] = latencies_us[std::min(latencies_us.size() - 1, latencies_us.size() * 99 / 100)];
+}
+} // namespace
+
+// ---------------------------------------------------------------- 解析
+
+static void parse_benchmark(benchmark::State &state, ParseBackend backend)
+{
+    QuietStdout quiet;
+    Parser parser(backend, false);
+    parser.set_verbose(false);
+    size_t records = 0;
+    for (auto _ : state)
+    {
+        size_t n = parser.parse_file(path_in("sessions.pcap"), [](const TLSRecord &record)
+                                     { benchmark::DoNotOptimize(record.frame_length); });
+        records += n;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(records));
+    state.counters["records"] = static_cast<double>(records / std::max<size_t>(state.iterations(), 1));
+}
+
+static void BM_ParseNative(benchmark::State &state)
+{
+    parse_benchmark(state, ParseBackend::NATIVE);
+}
+BENCHMARK(BM_ParseNative)->Unit(benchmark::kMillisecond);
+
+static void BM_ParseTshark(benchmark::State &state)
+{
+    if (!is_tshark_available())
+    {
+        state.SkipWithError("tshark is not available");
+        for (auto _ : state)
+        {
+        }
+        return;
+    }
+    parse_benchmark(state, ParseBackend::TSHARK);
+}
+BENCHMARK(BM_ParseTshark)->Unit(benchmark::kMillisecond)->Iterations(3);
+
+// ---------------------------------------------------------------- 数据加载
+
+static void load_benchmark(benchmark::State &state, const std::string &path)
+{
+    QuietStdout quiet;
+    size_t samples = 0;
+    for (auto _ : state)
+    {
+        TLSDataProcessor processor(path, FeatureWindow{}, SEED);
+        samples += processor.get_train_samples().size() + processor.get_test_samples().size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(samples));
+}
+
+static void BM_LoadBinary(benchmark::State &state)
+{
+    load_benchmark(state, path_in("tls_features.bin"));
+}
+BENCHMARK(BM_LoadBinary)->Unit(benchmark::kMillisecond);
+
+static void BM_LoadCsv(benchmark::State &state)
+{
+    load_benchmark(state, path_in("tls_features.csv"));
+}
+BENCHMARK(BM_LoadCsv)->Unit(benchmark::kMillisecond);
+
+// 单个会话的特征提取(在线分类和批量预测的路径)，参数为会话的记录数，特征窗口为79条记录
+static void BM_ExtractFeatures(benchmark::State &state)
+{
+    const int sequence_length = 79;
+    std::mt19937 rng(SEED);
+    SyntheticTrace trace = SyntheticData::make_trace(0, static_cast<size_t>(state.range(0)), rng);
+    std::vector<float> features(sequence_length * Featurizer::PACKET_FEATURES + Featurizer::STATS_FEATURES);
+    for (auto _ : state)
+    {
+        Featurizer::extract_features(trace.sizes.data(), trace.directions.data(), trace.sizes.size(), sequence_length,
+                                     features.data());
+        benchmark::DoNotOptimize(features.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_ExtractFeatures)->Arg(8)->Arg(40)->Arg(79);
+
+// ---------------------------------------------------------------- 全连接层，参数为input_dim，输出为隐藏层的16个神经元
+
+static const int HIDDEN = 16;
+static const size_t BATCH = 32;
+
+static void BM_FCForward(benchmark::State &state)
+{
+    int input_dim = static_cast<int>(state.range(0));
+    FCLayer layer(input_dim, HIDDEN);
+    std::vector<float> input = make_samples(1, input_dim)[0].features;
+    std::vector<float> output(HIDDEN);
+    for (auto _ : state)
+    {
+        layer.forward(input, output);
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.counters["GFLOP/s"] = benchmark::Counter(2.0 * input_dim * HIDDEN * 1e-9, benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_FCForward)->Arg(164)->Arg(1024)->Arg(4096);
+
+static void BM_FCForwardBatch(benchmark::State &state)
+{
+    int input_dim = static_cast<int>(state.range(0));
+    FCLayer layer(input_dim, HIDDEN);
+    AlignedMatrix inputs, outputs;
+    fill_random(inputs, BATCH, input_dim);
+    outputs.resize(BATCH, HIDDEN);
+    for (auto _ : state)
+    {
+        layer.forward_batch(inputs, BATCH, outputs);
+        benchmark::DoNotOptimize(outputs.data());
+    }
+    state.counters["GFLOP/s"] = benchmark::Counter(2.0 * BATCH * input_dim * HIDDEN * 1e-9, benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_FCForwardBatch)->Arg(164)->Arg(1024)->Arg(4096);
+
+static void BM_FCBackward(benchmark::State &state)
+{
+    int input_dim = static_cast<int>(state.range(0));
+    FCLayer layer(input_dim, HIDDEN);
+    AlignedMatrix inputs, gradients, input_gradients;
+    fill_random(inputs, BATCH, input_dim);
+    fill_random(gradients, BATCH, HIDDEN);
+    input_gradients.resize(BATCH, input_dim);
+    LayerGradients grads;
+    grads.resize(HIDDEN, input_dim);
+    for (auto _ : state)
+    {
+        layer.backward_batch(inputs, gradients, BATCH, grads, &input_gradients);
+        benchmark::DoNotOptimize(input_gradients.data());
+    }
+    // 权重梯度和输入梯度各为一次 [batch x hidden x input] 的矩阵乘
+    state.counters["GFLOP/s"] = benchmark::Counter(4.0 * BATCH * input_dim * HIDDEN * 1e-9, benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_FCBackward)->Arg(164)->Arg(1024)->Arg(4096);
+
+// ---------------------------------------------------------------- 单样本推理延迟
+
+static void BM_CNNForward(benchmark::State &state)
+{
+    int input_dim = static_cast<int>(state.range(0));
+    QuietStdout quiet;
+    SimpleCNN model(input_dim, NUM_LABELS);
+    SimpleCNN::InferenceWorkspace ws = model.make_workspace();
+    std::vector<Sample> samples = make_samples(256, input_dim);
+    std::vector<double> latencies_us;
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::span<const float> probs = model.forward(samples[i++ % samples.size()].features, ws);
+        benchmark::DoNotOptimize(probs.data());
+        latencies_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    set_percentiles(state, latencies_us);
+}
+BENCHMARK(BM_CNNForward)->Arg(164)->Arg(1024);
+
+static void BM_QuantizedCNNForward(benchmark::State &state)
+{
+    int input_dim = static_cast<int>(state.range(0));
+    QuietStdout quiet;
+    SimpleCNN model(input_dim, NUM_LABELS);
+    QuantizedCNN quantized(model);
+    QuantizedCNN::InferenceWorkspace ws = quantized.make_workspace();
+    std::vector<Sample> samples = make_samples(256, input_dim);
+    std::vector<double> latencies_us;
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::span<const float> probs = quantized.forward(samples[i++ % samples.size()].features, ws);
+        benchmark::DoNotOptimize(probs.data());
+        latencies_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    set_percentiles(state, latencies_us);
+}
+BENCHMARK(BM_QuantizedCNNForward)->Arg(164)->Arg(1024);
+
+template <int InputDim>
+static void BM_FixedMLPForward(benchmark::State &state)
+{
+    QuietStdout quiet;
+    SimpleCNN model(InputDim, NUM_LABELS);
+    auto fixed = std::make_unique<FixedMLP<InputDim, 16, NUM_LABELS>>(model);
+    auto ws = fixed->make_workspace();
+    std::vector<Sample> samples = make_samples(256, InputDim);
+    std::vector<double> latencies_us;
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::span<const float> probs = fixed->forward(samples[i++ % samples.size()].features, ws);
+        benchmark::DoNotOptimize(probs.data());
+        latencies_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    set_percentiles(state, latencies_us);
+}
+BENCHMARK_TEMPLATE(BM_FixedMLPForward, 164);
+BENCHMARK_TEMPLATE(BM_FixedMLPForward, 1024);
+
+// ---------------------------------------------------------------- 训练吞吐，参数为训练线程数
+
+static void BM_TrainBatch(benchmark::State &state)
+{
+    const int input_dim = 164;
+    QuietStdout quiet;
+    SimpleCNN model(input_dim, NUM_LABELS);
+    model.set_num_threads(static_cast<size_t>(state.range(0)));
+    std::vector<Sample> samples = make_samples(BATCH * 16, input_dim);
+    size_t offset = 0;
+    for (auto _ : state)
+    {
+        float loss = model.train_batch(std::span<const Sample>(samples.data() + offset, BATCH), 0.001f);
+        benchmark::DoNotOptimize(loss);
+        offset = (offset + BATCH) % samples.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * BATCH));
+}
+BENCHMARK(BM_TrainBatch)->Arg(1)->Arg(4)->UseRealTime();
+
+// ---------------------------------------------------------------- 端到端：解析pcap -> 写数据集 -> 加载 -> 训练一个epoch
+
+static void BM_EndToEnd(benchmark::State &state)
+{
+    QuietStdout quiet;
+    Parser parser(ParseBackend::NATIVE, false);
+    parser.set_verbose(false);
+    std::string dataset_path = path_in("e2e.bin");
+    size_t samples = 0;
+    for (auto _ : state)
+    {
+        TLSTraceStore store;
+        store.begin_trace("sessions", "sessions.pcap");
+        parser.parse_file(path_in("sessions.pcap"), [&store](const TLSRecord &r)
+                          { store.push_record(r.frame_length, r.tls_handshake_type, r.tls_direction, r.ip_src, r.ip_dst); });
+        store.end_trace();
+
+        // 合成pcap中的会话按顺序排列，按ClientHello切分为样本，标签与生成时一致(轮流分配)
+        FeatureDatasetWriter writer;
+        for (int label = 0; label < NUM_LABELS; ++label)
+            writer.add_label(label, SyntheticData::site_name(label));
+        TraceView trace = store.trace(0);
+        size_t begin = 0;
+        int session = 0;
+        for (size_t r = 1; r <= trace.length; ++r)
+        {
+            if (r == trace.length || trace.handshake_types[r] == 1)
+            {
+                writer.add_sample(session++ % NUM_LABELS, trace.sizes + begin, trace.directions + begin, r - begin);
+                begin = r;
+            }
+        }
+        writer.write(dataset_path);
+
+        TLSDataProcessor processor(dataset_path, FeatureWindow{}, SEED);
+        SimpleCNN model(processor.get_feature_dim(), processor.get_num_labels());
+        std::span<const Sample> train = processor.get_train_samples();
+        for (size_t i = 0; i < train.size(); i += BATCH)
+            model.train_batch(train.subspan(i, std::min(BATCH, train.size() - i)), 0.001f);
+        samples += writer.num_samples();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(samples));
+}
+BENCHMARK(BM_EndToEnd)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char **argv)
+{
+    if (argc >= 3 && std::string(argv[1]) == "--generate")
+        return generate_corpus(argv[2], argc >= 4 ? static_cast<size_t>(std::max(1, std::atoi(argv[3]))) : 50);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    char dir_template[] = "/tmp/tls_bench_XXXXXX";
+    if (!mkdtemp(dir_template))
+    {
+        std::cerr << "[ERROR] Failed to create temporary directory: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    bench_dir = dir_template;
+    generate_inputs();
+
+    benchmark::AddCustomContext("float_kernels", kernels::isa_name(kernels::current_isa()));
+    benchmark::AddCustomContext("int8_kernels", kernels::quant_isa_name(kernels::current_quant_isa()));
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    for (const char *name : {"sessions.pcap", "tls_features.bin", "tls_features.csv", "site_labels.csv", "e2e.bin"})
+        unlink(path_in(name).c_str());
+    rmdir(bench_dir.c_str());
+    return 0;
+}
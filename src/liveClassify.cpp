@@ -0,0 +1,356 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <iomanip>
+#include <algorithm>
+#include <csignal>
+#include <atomic>
+#include <ctime>
+#include <thread>
+#include <memory>
+#include <span>
+#include <sstream>
+#include <unistd.h>
+
+#include "PacketRing.hpp"
+#include "FlowTracker.hpp"
+#include "SimpleCNN.hpp"
+#include "QuantizedCNN.hpp"
+#include "FixedMLP.hpp"
+#include "Featurizer.hpp"
+#include "LabelMap.hpp"
+#include "Metrics.hpp"
+#include "Logger.hpp"
+
+// 在线分类：从TPACKET_V3环形缓冲区直接抓包，按流拼出前N条TLS记录后立即调用模型分类
+// 多线程时每个线程一个抓包socket，加入同一个PACKET_FANOUT组，内核按流哈希分流，每个线程独占自己的流表
+
+const std::string MODEL_PATH = "../model/tls_model.bin";
+const std::string LABEL_MAP_PATH = "../output/site_labels.csv";
+
+// 构建时指定了冻结模型的形状(CMake的TLS_FIXED_MODEL/TLS_FIXED_SHAPE)时，形状一致的模型使用编译期特化的FixedMLP推理
+#ifdef FIXED_MLP_INPUT_DIM
+using FixedModel = FixedMLP<FIXED_MLP_INPUT_DIM, FIXED_MLP_HIDDEN, FIXED_MLP_CLASSES>;
+#endif
+
+static std::atomic<bool> running{true};
+
+static void handle_signal(int)
+{
+    running = false;
+}
+
+static uint64_t realtime_us()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts); // 与内核的抓包时间戳使用同一时钟
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// 在线分类的指标，所有抓包线程共享(计数器和直方图按线程分片)
+struct LiveMetrics
+{
+    Counter &packets;
+    Counter &drops;
+    Counter &tls_records;
+    Counter &flows_complete;
+    Counter &flows_partial;
+    Histogram &inference;
+    Histogram &latency;
+
+    static LiveMetrics &get()
+    {
+        static LiveMetrics m = []
+        {
+            MetricsRegistry *r = MetricsRegistry::instance();
+            const char *flow_help = "Flows classified, partial flows ended before reaching the record count";
+            return LiveMetrics{
+                r->counter("tls_live_packets_total", "Packets received from the capture ring"),
+                r->counter("tls_live_drops_total", "Packets dropped by the kernel"),
+                r->counter("tls_live_tls_records_total", "TLS records seen in tracked flows"),
+                r->counter("tls_live_flows_classified_total", flow_help, "complete=\"true\""),
+                r->counter("tls_live_flows_classified_total", flow_help, "complete=\"false\""),
+                r->histogram("tls_live_inference_seconds", "Model forward time for one flow"),
+                r->histogram("tls_live_classification_latency_seconds", "Time from the last TLS record of a flow to its result")};
+        }();
+        return m;
+    }
+};
+
+// 一个抓包线程：独占的接收环、流表和推理缓冲区，结果交给缓冲日志输出，不在抓包线程中做I/O
+class CaptureWorker
+{
+public:
+    PacketRing ring;
+    FlowTracker tracker;
+    uint64_t classified = 0;
+    double total_latency_ms = 0.0, max_latency_ms = 0.0;
+
+private:
+    const SimpleCNN &model;
+    const QuantizedCNN *quantized; // 不为nullptr时使用int8推理
+    const LabelMap &label_names;
+    LiveMetrics &metrics;
+    std::vector<float> features;
+    SimpleCNN::InferenceWorkspace ws;
+    QuantizedCNN::InferenceWorkspace quantized_ws;
+#ifdef FIXED_MLP_INPUT_DIM
+    const FixedModel *fixed = nullptr; // 不为nullptr时使用编译期特化的网络推理
+    FixedModel::InferenceWorkspace fixed_ws;
+#endif
+
+public:
+    CaptureWorker(const SimpleCNN &model, const QuantizedCNN *quantized, const LabelMap &label_names,
+                  int records, int sequence_length, int idle_seconds, int port)
+        : tracker(static_cast<size_t>(records), sequence_length, static_cast<uint64_t>(idle_seconds) * 1000000ULL,
+                  static_cast<uint16_t>(port)),
+          model(model), quantized(quantized), label_names(label_names), metrics(LiveMetrics::get()),
+          features(model.get_input_dim()), ws(model.make_workspace())
+    {
+        if (quantized)
+            quantized_ws = quantized->make_workspace();
+    }
+
+#ifdef FIXED_MLP_INPUT_DIM
+    void use_fixed_model(const FixedModel *fixed_model)
+    {
+        fixed = fixed_model;
+        if (fixed)
+            fixed_ws = fixed->make_workspace();
+    }
+#endif
+
+    void run()
+    {
+        FlowTracker::FlowCallback on_flow = [this](const Flow &flow, bool complete)
+        { classify(flow, complete); };
+
+        uint64_t last_expire = realtime_us();
+        while (running)
+        {
+            ring.poll_packets(100, [&](const RawPacket &raw)
+                              { tracker.process(raw, on_flow); });
+
+            uint64_t now = realtime_us();
+            if (now - last_expire >= 1000000)
+            {
+                tracker.expire(now, on_flow);
+                publish_stats();
+                last_expire = now;
+            }
+        }
+        tracker.flush(on_flow);
+        publish_stats();
+    }
+
+private:
+    uint64_t published_packets = 0, published_drops = 0, published_records = 0;
+
+    // 每秒把抓包环和流表的累计统计的增量计入指标
+    void publish_stats()
+    {
+        PacketRing::Stats rs = ring.stats();
+        uint64_t records = tracker.stats().tls_records;
+        metrics.packets.add(rs.packets - published_packets);
+        metrics.drops.add(rs.drops - published_drops);
+        metrics.tls_records.add(records - published_records);
+        published_packets = rs.packets;
+        published_drops = rs.drops;
+        published_records = records;
+    }
+
+    std::span<const float> predict()
+    {
+#ifdef FIXED_MLP_INPUT_DIM
+        if (fixed)
+            return fixed->forward(features, fixed_ws);
+#endif
+        return quantized ? quantized->forward(features, quantized_ws) : model.forward(features, ws);
+    }
+
+    void classify(const Flow &flow, bool complete)
+    {
+        flow.features.finalize(features.data());
+        auto inference_start = std::chrono::steady_clock::now();
+        std::span<const float> probabilities = predict();
+        metrics.inference.observe(std::chrono::steady_clock::now() - inference_start);
+        int predicted = static_cast<int>(std::max_element(probabilities.begin(), probabilities.end()) - probabilities.begin());
+
+        // 延迟：最后一条记录被抓到 -> 分类完成；流时长：第一个数据包 -> 分类完成
+        uint64_t now = realtime_us();
+        double latency_ms = (now - std::min(now, flow.last_record_us)) / 1000.0;
+        double flow_ms = (now - std::min(now, flow.first_seen_us)) / 1000.0;
+        classified++;
+        total_latency_ms += latency_ms;
+        max_latency_ms = std::max(max_latency_ms, latency_ms);
+        metrics.latency.observe_seconds(latency_ms / 1000.0);
+        (complete ? metrics.flows_complete : metrics.flows_partial).add();
+
+        std::string site = label_names.name(predicted);
+        std::ostringstream line;
+        line << "[RESULT] " << PacketDecoder::addr_to_string(flow.key.ip_version, flow.client_addr()) << ":"
+                  << flow.client_port() << " -> "
+                  << PacketDecoder::addr_to_string(flow.key.ip_version, flow.server_addr()) << ":"
+                  << flow.server_port()
+                  << " site=" << site
+                  << " prob=" << std::fixed << std::setprecision(1) << probabilities[predicted] * 100 << "%"
+                  << " records=" << flow.features.records() << (complete ? "" : " (partial)")
+                  << " latency=" << std::setprecision(3) << latency_ms << "ms"
+                  << " flow=" << std::setprecision(1) << flow_ms << "ms";
+        Logger::instance()->print(line.str());
+    }
+};
+
+int main(int argc, char **argv)
+{
+    std::string interface = "any";
+    std::string model_path = MODEL_PATH;
+    std::string label_map_path = LABEL_MAP_PATH;
+    int records = 0;      // 每个流收集的记录数，0表示使用模型的序列长度
+    int idle_seconds = 30; // 空闲流的淘汰时间
+    int port = 443;
+    int num_threads = 1;
+    bool use_int8 = false; // --int8 使用int8量化的权重推理
+    std::string metrics_json; // --metrics-json PATH 每秒写出指标快照
+    int metrics_port = 0;     // --metrics-port N 在127.0.0.1:N/metrics提供Prometheus格式的指标
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if ((arg == "-i" || arg == "--interface") && i + 1 < argc)
+            interface = argv[++i];
+        else if (arg == "--model" && i + 1 < argc)
+            model_path = argv[++i];
+        else if (arg == "--labels" && i + 1 < argc)
+            label_map_path = argv[++i];
+        else if (arg == "--records" && i + 1 < argc)
+            records = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--idle" && i + 1 < argc)
+            idle_seconds = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--port" && i + 1 < argc)
+            port = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--threads" && i + 1 < argc)
+            num_threads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--int8")
+            use_int8 = true;
+        else if (arg == "--metrics-json" && i + 1 < argc)
+            metrics_json = argv[++i];
+        else if (arg == "--metrics-port" && i + 1 < argc)
+            metrics_port = std::max(0, std::atoi(argv[++i]));
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [-i interface] [--model path] [--labels site_labels.csv]"
+                      << " [--records N] [--idle seconds] [--port 443] [--threads N] [--int8]"
+                      << " [--metrics-json path] [--metrics-port N]" << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        SimpleCNN model = SimpleCNN::load_model(model_path);
+        int feature_dim = model.get_input_dim();
+        int sequence_length = static_cast<int>(model.get_metadata().sequence_length);
+        if (records == 0)
+            records = sequence_length;
+        LabelMap label_names;
+        if (!model.get_metadata().labels.empty())
+            label_names.assign(model.get_metadata().labels); // 模型文件自带标签表
+        else
+            label_names.load(label_map_path);
+
+        std::unique_ptr<QuantizedCNN> quantized;
+        if (use_int8)
+        {
+            quantized = std::make_unique<QuantizedCNN>(model);
+            std::cout << "[INFO] int8 inference, kernels: " << kernels::quant_isa_name(kernels::current_quant_isa())
+                      << ", weights: " << quantized->weight_bytes() << " bytes" << std::endl;
+        }
+
+#ifdef FIXED_MLP_INPUT_DIM
+        std::unique_ptr<FixedModel> fixed;
+        if (!use_int8 && FixedModel::matches(model))
+        {
+            fixed = std::make_unique<FixedModel>(model);
+            std::cout << "[INFO] Using compile-time specialized network " << FixedModel::shape() << std::endl;
+        }
+        else if (!use_int8)
+        {
+            std::cout << "[INFO] Model does not match the compiled network shape " << FixedModel::shape()
+                      << ", using the runtime network" << std::endl;
+        }
+#endif
+
+        std::cout << "[INFO] Feature dimension: " << feature_dim << ", classifying after " << records
+                  << " TLS records per flow" << std::endl;
+
+        MetricsExporter metrics_exporter;
+        if (!metrics_json.empty())
+            metrics_exporter.start_json(metrics_json);
+        if (metrics_port > 0 && !metrics_exporter.start_http(metrics_port))
+            return 1;
+
+        int fanout_group = getpid() & 0xffff;
+        std::vector<std::unique_ptr<CaptureWorker>> workers;
+        for (int t = 0; t < num_threads; ++t)
+        {
+            workers.push_back(std::make_unique<CaptureWorker>(model, quantized.get(), label_names, records,
+                                                              sequence_length, idle_seconds, port));
+#ifdef FIXED_MLP_INPUT_DIM
+            workers.back()->use_fixed_model(fixed.get());
+#endif
+            if (!workers.back()->ring.open(interface))
+                return 1;
+            if (num_threads > 1 && !workers.back()->ring.join_fanout(fanout_group))
+                return 1;
+        }
+        if (num_threads > 1)
+            std::cout << "[INFO] " << num_threads << " capture threads in PACKET_FANOUT group " << fanout_group << std::endl;
+
+        std::signal(SIGINT, handle_signal);
+        std::signal(SIGTERM, handle_signal);
+
+        std::vector<std::thread> threads;
+        for (auto &worker : workers)
+            threads.emplace_back(&CaptureWorker::run, worker.get());
+        for (std::thread &thread : threads)
+            thread.join();
+        Logger::instance()->flush(); // 剩余的结果先于汇总输出
+
+        PacketRing::Stats ring_stats;
+        FlowTracker::Stats flow_stats;
+        uint64_t classified = 0;
+        double total_latency_ms = 0.0, max_latency_ms = 0.0;
+        for (auto &worker : workers)
+        {
+            PacketRing::Stats rs = worker->ring.stats();
+            const FlowTracker::Stats &fs = worker->tracker.stats();
+            ring_stats.packets += rs.packets;
+            ring_stats.drops += rs.drops;
+            flow_stats.packets += fs.packets;
+            flow_stats.tls_records += fs.tls_records;
+            flow_stats.flows_created += fs.flows_created;
+            flow_stats.flows_partial += fs.flows_partial;
+            classified += worker->classified;
+            total_latency_ms += worker->total_latency_ms;
+            max_latency_ms = std::max(max_latency_ms, worker->max_latency_ms);
+        }
+
+        std::cout << "\n========== Live Classification Summary ==========" << std::endl;
+        std::cout << "Packets received: " << ring_stats.packets << ", dropped by kernel: " << ring_stats.drops << std::endl;
+        std::cout << "TCP packets tracked: " << flow_stats.packets << ", TLS records: " << flow_stats.tls_records << std::endl;
+        std::cout << "Flows: " << flow_stats.flows_created << ", classified: " << classified
+                  << " (" << flow_stats.flows_partial << " partial)" << std::endl;
+        if (classified > 0)
+        {
+            std::cout << "Classification latency: avg " << std::fixed << std::setprecision(3)
+                      << total_latency_ms / classified << "ms, max " << max_latency_ms << "ms" << std::endl;
+        }
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -1,16 +1,92 @@
 #include <iostream>
 
-#include "HttpsClient.hpp"
+#include "HttpsCollector.hpp"
 #include "DomainManager.hpp"
-#include "Capture.hpp"
 #include "FileLoader.hpp"
 #include "Parser.hpp"
 #include "TLSRecordToCsv.hpp"
+#include "IngestPipeline.hpp"
+#include "Metrics.hpp"
 
 const int MAX_CAPTURE_COUNT = 50;
+const std::string CAPTURE_ROOT = "../capture"; // 采集目录，每次采集一个子目录(抓包环 + 会话日志)
 
 int main(int argc, char **argv)
 {
+    // 解析后端：默认使用内置解码器，--tshark使用tshark，--verify同时运行两者进行校验
+    // --threads N指定解析pcap的线程数，默认使用全部硬件线程
+    ParseBackend parse_backend = ParseBackend::NATIVE;
+    size_t parse_threads = 0;
+    bool export_csv = false; // --csv额外导出文本格式的tls_features.csv，便于调试查看
+    size_t num_shards = 0;   // --shards N按pcap哈希写出N个分片到../output/shards，供多节点预处理后合并训练
+    // --records K只解析每个pcap文件(会话)的前K+1条记录：训练时用--records K的窗口，
+    // 多保留的一条用于--truncate drop判断会话是否超过窗口
+    size_t record_budget = 0;
+    std::string cache_path = "../output/trace_cache.bin"; // --no-cache忽略缓存，重新解析所有pcap文件
+    // --samples N每个域名采集的会话数，--concurrency N同时进行的会话数
+    CollectorOptions collector_options;
+    collector_options.samples_per_domain = MAX_CAPTURE_COUNT;
+    // --ring-size MB抓包环中每个文件的大小，--ring-files N抓包环的文件数
+    size_t ring_file_mb = 100, ring_files = 10;
+    // --pipeline非交互的流水线模式，采集、解析和写入同时进行；--rounds N采集轮数，--skip-capture只处理已有数据
+    bool pipeline = false, skip = false;
+    int rounds = 5;
+    // --metrics-json PATH定期写出指标快照，--metrics-port N在127.0.0.1:N/metrics提供Prometheus格式的指标
+    std::string metrics_json;
+    int metrics_port = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--tshark")
+            parse_backend = ParseBackend::TSHARK;
+        else if (arg == "--verify")
+            parse_backend = ParseBackend::VERIFY;
+        else if (arg == "--csv")
+            export_csv = true;
+        else if (arg == "--shards" && i + 1 < argc)
+            num_shards = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        else if (arg == "--records" && i + 1 < argc)
+        {
+            int k = std::atoi(argv[++i]);
+            record_budget = k > 0 ? static_cast<size_t>(k) + 1 : 0;
+        }
+        else if (arg == "--no-cache")
+            cache_path.clear();
+        else if (arg == "--threads" && i + 1 < argc)
+            parse_threads = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        else if (arg == "--samples" && i + 1 < argc)
+            collector_options.samples_per_domain = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--concurrency" && i + 1 < argc)
+            collector_options.max_concurrency = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--ring-size" && i + 1 < argc)
+            ring_file_mb = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--ring-files" && i + 1 < argc)
+            ring_files = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--pipeline")
+            pipeline = true;
+        else if (arg == "--rounds" && i + 1 < argc)
+            rounds = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--skip-capture")
+            skip = true;
+        else if (arg == "--metrics-json" && i + 1 < argc)
+            metrics_json = argv[++i];
+        else if (arg == "--metrics-port" && i + 1 < argc)
+            metrics_port = std::max(0, std::atoi(argv[++i]));
+    }
+
+    // 流水线模式不保留整个语料库的TLS记录，无法导出CSV
+    if (pipeline && export_csv)
+    {
+        std::cerr << "[ERROR] --csv is not supported with --pipeline, run without --pipeline to export CSV" << std::endl;
+        return 1;
+    }
+
+    MetricsExporter metrics_exporter;
+    if (!metrics_json.empty())
+        metrics_exporter.start_json(metrics_json);
+    if (metrics_port > 0)
+        metrics_exporter.start_http(metrics_port);
+
     // 加载并列出所有目标域名
     DomainManager::instance()->load_domains_from_file("../domain_list.txt");
     if (DomainManager::instance()->is_empty())
@@ -18,48 +94,48 @@ int main(int argc, char **argv)
         std::cerr << "[ERROR] Domain list is empty: " << "../domain_list.txt" << std::endl;
         return 1;
     }
+
+    if (pipeline)
+    {
+        PipelineOptions pipeline_options;
+        pipeline_options.collect = !skip;
+        pipeline_options.rounds = rounds;
+        pipeline_options.collector = collector_options;
+        pipeline_options.ring_file_mb = ring_file_mb;
+        pipeline_options.ring_files = ring_files;
+        pipeline_options.capture_root = CAPTURE_ROOT;
+        pipeline_options.cache_path = cache_path;
+        pipeline_options.parse_threads = parse_threads;
+        try
+        {
+            Parser parser(parse_backend, false);
+            parser.set_record_budget(record_budget);
+            TLSRecordToCsv csv_converter(parser);
+            csv_converter.set_num_shards(num_shards);
+            IngestPipeline ingest(pipeline_options, parser, csv_converter);
+            return ingest.run() > 0 ? 0 : 1;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "[ERROR] EXCEPTION:" << e.what() << std::endl;
+            return 1;
+        }
+    }
+
     std::cout << "PRESS ANY KEY TO CONTINUE..." << std::endl;
     std::cout << "Press 1 to skip capture" << std::endl;
-    char ch = getchar();
+    char ch = skip ? '1' : getchar();
     if (ch == '1')
         goto skip_capture;
 
     DomainManager::instance()->list_domains();
-    // 遍历所有域名，进行抓包和HTTPS请求
-    for (const auto &domain : DomainManager::instance()->get_domains())
     {
-        for (int i = 0; i < MAX_CAPTURE_COUNT; i++)
-        {
-            std::cout << std::endl
-                      << "[INFO] Processing domain: " << domain << std::endl;
-            std::cout << "-----------------------------------------------------------------------" << std::endl;
-
-            Capture capture("any", "host " + domain);
-
-            try
-            {
-                std::cout << "[INFO] Starting capture packets ..." << std::endl;
-                capture.start(domain);
-                sleep(1);
-
-                std::cout << "[INFO] Sending HTTPS request to " << domain << "..." << std::endl;
-                HttpsClient client(domain);
-                sleep(1.5);
-
-                std::cout << "[INFO] Stopping packet capture ..." << std::endl;
-                capture.stop();
-            }
-            catch (const std::exception &e)
-            {
-                std::cerr << "[ERROR] EXCEPTION:" << e.what() << std::endl;
-                if (capture.is_capturing())
-                {
-                    capture.stop();
-                }
-
-                std::cout << "--------------------------------------------------------------------" << std::endl;
-            }
-        }
+        // 整个采集过程只运行一个tcpdump，写入轮转的抓包环；所有域名的会话由HttpsCollector并发发起，
+        // 解析时再按会话日志从抓包环中分离出每个会话(见SessionDemux)
+        std::string timestamp = std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+        if (IngestPipeline::collect_capture(CAPTURE_ROOT + "/" + timestamp, DomainManager::instance()->get_domains(),
+                                            collector_options, ring_file_mb, ring_files) == 0)
+            return 1;
     }
     std::cout << "[INFO] ALl domains processed." << std::endl;
 
@@ -71,14 +147,18 @@ skip_capture:
 
     FileLoader::instance()->start("../data");
     FileLoader::instance()->list_all_files();
-    Parser parser;
+    Parser parser(parse_backend, true, parse_threads, cache_path, record_budget);
+    parser.parse_captures(CAPTURE_ROOT);
 
-    // 添加以下代码用于生成CSV文件
-    std::cout << "Press to continue CSV generation..." << std::endl;
+    // 生成训练用的二进制数据集
+    std::cout << "Press to continue dataset generation..." << std::endl;
     getchar();
 
     TLSRecordToCsv csv_converter(parser);
-    csv_converter.generate_csv();
+    csv_converter.set_num_shards(num_shards);
+    csv_converter.generate_dataset();
+    if (export_csv)
+        csv_converter.generate_csv();
 
     return 0;
 }
\ No newline at end of file
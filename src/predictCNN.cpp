@@ -2,19 +2,87 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <string>
 #include <algorithm>
 #include <iomanip>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <span>
+#include <sys/stat.h>
 
 #include "SimpleCNN.hpp"
 #include "TLSDataProcessor.hpp"
-#include "DomainManager.hpp"
+#include "Featurizer.hpp"
+#include "FeatureDataset.hpp"
+#include "ShardedDataset.hpp"
+#include "LabelMap.hpp"
+#include "Parser.hpp"
+#include "ThreadPool.hpp"
+#include "DirectoryScanner.hpp"
+#include "PredictionClient.hpp"
 
-// 标签到网站名称的映射
-const std::vector<std::string> SITE_NAMES = DomainManager::instance()->get_domains();
-const std::string MODEL_PATH = "../data/tls_model.bin";
+/*
+predictCNN支持两种用法：
+1. 单个文件：pcap文件或特征文件(一行 包大小_方向;包大小_方向;...)，输出每个网站的概率。
+   指定--server <socket>时把记录序列发给常驻的predictServer，不在本进程加载模型
+2. 批量预测：pcap目录(可含按网站划分的子目录)、二进制数据集或分片数据集目录，多线程并行，结果按输入顺序流式输出为text/csv/json
+模型维度和标签表直接从模型文件读取，不需要加载训练数据；特征与训练时使用同一个Featurizer
+旧格式的模型没有标签表，此时使用site_labels.csv(数据集输入使用数据集自带的标签表)
+*/
 
-// 从单个PCAP文件加载TLS特征
-std::vector<float> load_features_from_file(const std::string &file_path, int feature_dim)
+const std::string MODEL_PATH = "../model/tls_model.bin";
+const std::string LABEL_MAP_PATH = "../output/site_labels.csv";
+
+enum class OutputFormat
+{
+    TEXT,
+    CSV,
+    JSON
+};
+
+// 一个待预测的样本：pcap文件，或数据集中的一个样本
+struct PredictItem
+{
+    std::string source;          // 文件路径或 数据集路径#样本序号
+    int true_label = -1;         // 已知的真实标签(数据集标签或pcap所在子目录)，未知为-1
+    size_t dataset_index = 0;    // 数据集样本的序号
+};
+
+static bool is_directory(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// pcap所在目录名即网站名称(与训练数据的目录结构一致)
+static std::string parent_dir_name(const std::string &path)
+{
+    size_t last_slash = path.find_last_of('/');
+    if (last_slash == std::string::npos || last_slash == 0)
+        return "";
+    size_t second_last_slash = path.find_last_of('/', last_slash - 1);
+    size_t begin = second_last_slash == std::string::npos ? 0 : second_last_slash + 1;
+    return path.substr(begin, last_slash - begin);
+}
+
+// 从pcap文件解析记录序列，只保留方向已知且大小非0的记录(与数据集生成一致)
+static void load_records_from_pcap(const Parser &parser, const std::string &path,
+                                   std::vector<uint16_t> &sizes, std::vector<int8_t> &directions)
+{
+    sizes.clear();
+    directions.clear();
+    parser.parse_file(path, [&](const TLSRecord &record)
+                      {
+                          if (record.frame_length <= 0 || record.tls_direction < 0)
+                              return;
+                          sizes.push_back(static_cast<uint16_t>(std::min(record.frame_length, 65535)));
+                          directions.push_back(static_cast<int8_t>(record.tls_direction)); });
+}
+
+// 从特征文件加载记录序列，格式与tls_features.csv中的特征列相同：包大小_方向;包大小_方向;...
+static void load_records_from_feature_file(const std::string &file_path,
+                                           std::vector<uint16_t> &sizes, std::vector<int8_t> &directions)
 {
     std::ifstream file(file_path);
     if (!file.is_open())
@@ -25,95 +93,490 @@ std::vector<float> load_features_from_file(const std::string &file_path, int fea
     std::string line;
     std::getline(file, line); // 读取第一行
 
-    std::vector<float> features;
     std::istringstream iss(line);
     std::string pair;
-
     while (std::getline(iss, pair, ';'))
     {
         size_t delim_pos = pair.find('_');
-        if (delim_pos != std::string::npos)
+        if (delim_pos == std::string::npos)
+            continue;
+        int size = std::atoi(pair.substr(0, delim_pos).c_str());
+        int direction = std::atoi(pair.substr(delim_pos + 1).c_str());
+        sizes.push_back(static_cast<uint16_t>(std::min(std::max(size, 0), 65535)));
+        directions.push_back(static_cast<int8_t>(direction));
+    }
+}
+
+static std::string json_escape(const std::string &str)
+{
+    std::string escaped;
+    escaped.reserve(str.size());
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            escaped += buf;
+        }
+        else
         {
-            int size = std::stoi(pair.substr(0, delim_pos));
-            int direction = std::stoi(pair.substr(delim_pos + 1));
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static std::string csv_escape(const std::string &str)
+{
+    if (str.find_first_of(",\"\n") == std::string::npos)
+        return str;
+    std::string escaped = "\"";
+    for (char c : str)
+    {
+        if (c == '"')
+            escaped += '"';
+        escaped += c;
+    }
+    return escaped + "\"";
+}
+
+// 按输入顺序输出结果：工作线程完成后登记，连续完成的前缀立即写出
+class ResultWriter
+{
+private:
+    std::ostream &out;
+    OutputFormat format;
+    const LabelMap &labels;
+    int num_labels;
+    const std::vector<PredictItem> &items;
+
+    std::mutex mtx;
+    std::vector<float> probabilities; // items.size() * num_labels
+    std::vector<int> predicted;       // -1表示没有可用的TLS记录
+    std::vector<uint8_t> done;
+    size_t next_to_write = 0;
 
-            // 归一化数据包大小
-            float normalized_size = static_cast<float>(size) / 1500.0f;
+public:
+    size_t num_predicted = 0;
+    size_t num_empty = 0;
+    size_t num_labeled = 0;
+    size_t num_correct = 0;
 
-            features.push_back(normalized_size);
-            features.push_back(static_cast<float>(direction));
+    ResultWriter(std::ostream &out, OutputFormat format, const LabelMap &labels, int num_labels,
+                 const std::vector<PredictItem> &items)
+        : out(out), format(format), labels(labels), num_labels(num_labels), items(items),
+          probabilities(items.size() * num_labels), predicted(items.size(), -1), done(items.size(), 0)
+    {
+        if (format == OutputFormat::CSV)
+        {
+            out << "source,true_site,predicted_site,confidence";
+            for (int i = 0; i < num_labels; ++i)
+                out << "," << csv_escape(labels.name(i));
+            out << "\n";
         }
     }
 
-    // 填充到固定长度
-    if (features.size() < feature_dim)
+    // 工作线程写入自己的结果槽，不需要加锁
+    float *slot(size_t index) { return probabilities.data() + index * num_labels; }
+    void set_predicted(size_t index, int label) { predicted[index] = label; }
+
+    // 登记[begin, end)已完成，并写出已经连续完成的结果
+    void complete(size_t begin, size_t end)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (size_t i = begin; i < end; ++i)
+            done[i] = 1;
+        while (next_to_write < items.size() && done[next_to_write])
+            write(next_to_write++);
+        out.flush();
+    }
+
+private:
+    void write(size_t index)
     {
-        features.resize(feature_dim, 0.0f);
+        const PredictItem &item = items[index];
+        int label = predicted[index];
+        if (label < 0)
+        {
+            num_empty++;
+            std::cerr << "[WARN] No TLS records in " << item.source << std::endl;
+            return;
+        }
+        num_predicted++;
+        if (item.true_label >= 0)
+        {
+            num_labeled++;
+            if (item.true_label == label)
+                num_correct++;
+        }
+
+        const float *probs = slot(index);
+        std::string true_site = item.true_label >= 0 ? labels.name(item.true_label) : "";
+        if (format == OutputFormat::TEXT)
+        {
+            out << "[RESULT] " << item.source << " -> " << labels.name(label) << " ("
+                << std::fixed << std::setprecision(2) << probs[label] * 100 << "%)";
+            if (item.true_label >= 0)
+                out << (item.true_label == label ? " [correct]" : " [true: " + true_site + "]");
+            out << "\n";
+        }
+        else if (format == OutputFormat::CSV)
+        {
+            out << csv_escape(item.source) << "," << csv_escape(true_site) << "," << csv_escape(labels.name(label))
+                << "," << std::fixed << std::setprecision(6) << probs[label];
+            for (int i = 0; i < num_labels; ++i)
+                out << "," << probs[i];
+            out << "\n";
+        }
+        else
+        {
+            // JSON Lines：每行一个对象，便于流式处理
+            out << "{\"source\":\"" << json_escape(item.source) << "\",\"true_site\":"
+                << (item.true_label >= 0 ? "\"" + json_escape(true_site) + "\"" : "null")
+                << ",\"predicted_site\":\"" << json_escape(labels.name(label)) << "\",\"confidence\":"
+                << std::fixed << std::setprecision(6) << probs[label] << ",\"probabilities\":{";
+            for (int i = 0; i < num_labels; ++i)
+                out << (i > 0 ? "," : "") << "\"" << json_escape(labels.name(i)) << "\":" << probs[i];
+            out << "}}\n";
+        }
     }
+};
 
-    return features;
+static void print_usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " <pcap_file | feature_file | pcap_dir | tls_features.bin>\n"
+              << "       [--model path] [--labels site_labels.csv] [--threads N]\n"
+              << "       [--format text|csv|json] [--output path] [--server socket]" << std::endl;
 }
 
-int main(int argc, char **argv)
+/*
+@brief 单个文件的记录序列，没有TLS记录时返回false
+@param sequence_length 模型的序列长度，pcap文件只解析到这么多条有效记录为止(之后的记录不影响特征)
+*/
+static bool load_single_records(const std::string &file_path, int sequence_length, std::vector<uint16_t> &sizes,
+                                std::vector<int8_t> &directions)
 {
-    try
+    if (DirectoryScanner::has_pcap_extension(file_path))
     {
-        if (argc < 2)
-        {
-            std::cerr << "Usage: " << argv[0] << " <tls_feature_file>" << std::endl;
-            return 1;
-        }
+        Parser parser(ParseBackend::NATIVE, false);
+        parser.set_record_budget(static_cast<size_t>(std::max(sequence_length, 0)));
+        load_records_from_pcap(parser, file_path, sizes, directions);
+    }
+    else
+    {
+        std::cout << "[INFO] Loading features from " << file_path << std::endl;
+        load_records_from_feature_file(file_path, sizes, directions);
+    }
+    if (sizes.empty())
+    {
+        std::cerr << "[ERROR] No TLS records in " << file_path << std::endl;
+        return false;
+    }
+    return true;
+}
 
-        // 首先从训练数据确定特征维度
-        TLSDataProcessor processor("../output/tls_features.csv");
-        int feature_dim = processor.get_feature_dim();
-        int num_labels = processor.get_num_labels();
+static void print_prediction(const LabelMap &labels, std::span<const float> probabilities)
+{
+    // 找到最可能的网站
+    int predicted_label = std::max_element(probabilities.begin(), probabilities.end()) - probabilities.begin();
 
-        std::cout << "[INFO] Feature dimension: " << feature_dim << std::endl;
-        std::cout << "[INFO] Number of labels: " << num_labels << std::endl;
+    // 输出结果，解析日志先于结果输出
+    Logger::instance()->flush();
+    std::cout << "\n===== Prediction Result =====" << std::endl;
+    std::cout << "Predicted website: " << labels.name(predicted_label) << std::endl;
+    std::cout << "Probabilities:" << std::endl;
+    for (size_t i = 0; i < probabilities.size(); ++i)
+    {
+        std::cout << "  " << std::setw(10) << std::left << labels.name(static_cast<int>(i)) << ": "
+                  << std::fixed << std::setprecision(2) << (probabilities[i] * 100) << "%"
+                  << std::endl;
+    }
+}
 
-        // 加载模型
-        std::cout << "[INFO] Loading model from " << MODEL_PATH << std::endl;
-        SimpleCNN model = SimpleCNN::load_model(MODEL_PATH, feature_dim, num_labels);
+// 单个文件：输出每个网站的概率
+static int predict_single(const SimpleCNN &model, const LabelMap &labels, const std::string &file_path)
+{
+    std::vector<uint16_t> sizes;
+    std::vector<int8_t> directions;
+    if (!load_single_records(file_path, static_cast<int>(model.get_metadata().sequence_length), sizes, directions))
+        return 1;
+
+    int feature_dim = model.get_input_dim();
+    std::vector<float> features(feature_dim);
+    Featurizer::extract_features(sizes.data(), directions.data(), sizes.size(),
+                                 static_cast<int>(model.get_metadata().sequence_length), features.data());
+
+    SimpleCNN::InferenceWorkspace ws = model.make_workspace();
+    print_prediction(labels, model.forward(features, ws));
+    return 0;
+}
 
-        // 加载要预测的特征
-        std::string feature_file = argv[1];
-        std::cout << "[INFO] Loading features from " << feature_file << std::endl;
+// 单个文件，由predictServer预测：本进程只解析记录，标签表也从服务端获取
+static int predict_remote(const std::string &socket_path, const std::string &label_map_path, const std::string &file_path)
+{
+    PredictionClient client;
+    PredictionClient::ModelInfo info;
+    if (!client.connect(socket_path) || !client.info(info))
+        return 1;
 
-        std::vector<float> features = load_features_from_file(feature_file, feature_dim);
+    std::vector<uint16_t> sizes;
+    std::vector<int8_t> directions;
+    if (!load_single_records(file_path, info.sequence_length, sizes, directions))
+        return 1;
+    LabelMap labels;
+    bool has_names = std::any_of(info.labels.begin(), info.labels.end(), [](const std::string &name)
+                                 { return !name.empty(); });
+    if (has_names)
+    {
+        for (size_t i = 0; i < info.labels.size(); ++i)
+            labels.set(static_cast<int>(i), info.labels[i]);
+    }
+    else
+    {
+        labels.load(label_map_path);
+    }
 
-        // 进行预测
-        std::vector<float> probabilities = model.forward(features);
+    PredictionClient::Result result;
+    if (!client.predict_records(sizes.data(), directions.data(), sizes.size(), result))
+        return 1;
+    if (result.status != prediction_protocol::Status::OK)
+    {
+        std::cerr << "[ERROR] Prediction server rejected the request, status " << static_cast<int>(result.status) << std::endl;
+        return 1;
+    }
+    print_prediction(labels, result.probabilities);
+    return 0;
+}
 
-        // 找到最可能的网站
-        int predicted_label = std::max_element(probabilities.begin(), probabilities.end()) - probabilities.begin();
+int main(int argc, char **argv)
+{
+    std::string input_path;
+    std::string model_path = MODEL_PATH;
+    std::string label_map_path = LABEL_MAP_PATH;
+    std::string output_path;
+    std::string server_path; // --server 使用predictServer预测单个文件
+    OutputFormat format = OutputFormat::TEXT;
+    size_t num_threads = 0; // 0表示使用全部硬件线程
 
-        // 输出结果
-        std::cout << "\n===== Prediction Result =====" << std::endl;
-        if (predicted_label < SITE_NAMES.size())
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--model" && i + 1 < argc)
+            model_path = argv[++i];
+        else if (arg == "--labels" && i + 1 < argc)
+            label_map_path = argv[++i];
+        else if (arg == "--output" && i + 1 < argc)
+            output_path = argv[++i];
+        else if (arg == "--server" && i + 1 < argc)
+            server_path = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc)
+            num_threads = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        else if (arg == "--format" && i + 1 < argc)
         {
-            std::cout << "Predicted website: " << SITE_NAMES[predicted_label] << std::endl;
+            std::string name = argv[++i];
+            if (name == "text")
+                format = OutputFormat::TEXT;
+            else if (name == "csv")
+                format = OutputFormat::CSV;
+            else if (name == "json")
+                format = OutputFormat::JSON;
+            else
+            {
+                print_usage(argv[0]);
+                return 1;
+            }
         }
+        else if (input_path.empty() && arg.rfind("--", 0) != 0)
+            input_path = arg;
         else
         {
-            std::cout << "Predicted label: " << predicted_label << std::endl;
+            print_usage(argv[0]);
+            return 1;
         }
+    }
+    if (input_path.empty())
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
 
-        std::cout << "Probabilities:" << std::endl;
+    bool batch = is_directory(input_path) || dataset_format::is_dataset_file(input_path) || shard_format::is_sharded(input_path);
+    if (!server_path.empty())
+    {
+        if (batch)
+        {
+            std::cerr << "[ERROR] --server only predicts single files" << std::endl;
+            return 1;
+        }
+        return predict_remote(server_path, label_map_path, input_path);
+    }
 
-        for (int i = 0; i < num_labels; ++i)
+    // csv/json写到标准输出时，日志改写到标准错误，保证输出可以直接被管道消费
+    std::streambuf *stdout_buf = std::cout.rdbuf();
+    std::ofstream output_file;
+    if (!output_path.empty())
+    {
+        output_file.open(output_path);
+        if (!output_file.is_open())
         {
-            std::string site_name = (i < SITE_NAMES.size()) ? SITE_NAMES[i] : ("Label_" + std::to_string(i));
-            std::cout << "  " << std::setw(10) << std::left << site_name << ": "
-                      << std::fixed << std::setprecision(2) << (probabilities[i] * 100) << "%"
-                      << std::endl;
+            std::cerr << "[ERROR] Failed to open output file: " << output_path << std::endl;
+            return 1;
         }
+    }
+    bool redirect_logs = batch && output_path.empty() && format != OutputFormat::TEXT;
+    if (redirect_logs)
+        std::cout.rdbuf(std::cerr.rdbuf());
+    std::ostream results_out(output_path.empty() ? stdout_buf : output_file.rdbuf());
+
+    int status = 0;
+    try
+    {
+        // 模型和元数据只加载一次，启动时间与训练集大小无关
+        SimpleCNN model = SimpleCNN::load_model(model_path);
+        int feature_dim = model.get_input_dim();
+        int num_labels = model.get_num_labels();
+        int sequence_length = static_cast<int>(model.get_metadata().sequence_length);
 
-        return 0;
+        std::cout << "[INFO] Feature dimension: " << feature_dim << std::endl;
+        std::cout << "[INFO] Number of labels: " << num_labels << std::endl;
+
+        const auto &model_labels = model.get_metadata().labels;
+        if (!batch)
+        {
+            LabelMap labels;
+            if (!model_labels.empty())
+                labels.assign(model_labels);
+            else
+                labels.load(label_map_path);
+            status = predict_single(model, labels, input_path);
+        }
+        else
+        {
+            std::vector<PredictItem> items;
+            ShardedDataset dataset; // 单个数据集文件作为只有一个分片的数据集
+            LabelMap labels;
+            bool from_dataset = !is_directory(input_path) || shard_format::is_sharded(input_path);
+            if (from_dataset)
+            {
+                dataset.open(input_path);
+                labels.assign(!model_labels.empty() ? model_labels : dataset.get_labels());
+                items.resize(dataset.num_samples());
+                for (size_t i = 0; i < items.size(); ++i)
+                {
+                    items[i].source = input_path + "#" + std::to_string(i);
+                    items[i].true_label = dataset.sample(i).label;
+                    items[i].dataset_index = i;
+                }
+            }
+            else
+            {
+                if (!model_labels.empty())
+                    labels.assign(model_labels);
+                else
+                    labels.load(label_map_path);
+                std::vector<std::string> files;
+                DirectoryScanner::ScanStats scan_stats; // 递归收集目录下的pcap文件，按路径排序
+                DirectoryScanner::scan_pcaps(input_path, files, scan_stats, true);
+                items.resize(files.size());
+                for (size_t i = 0; i < files.size(); ++i)
+                {
+                    items[i].source = files[i];
+                    items[i].true_label = labels.find(parent_dir_name(files[i]));
+                }
+            }
+            if (labels.size() > static_cast<size_t>(num_labels))
+                std::cerr << "[WARN] Label map has " << labels.size() << " labels but the model has " << num_labels << std::endl;
+
+            Parser parser(ParseBackend::NATIVE, false);
+            parser.set_verbose(false);
+            parser.set_record_budget(static_cast<size_t>(sequence_length)); // 只解析特征窗口内的记录
+
+            WorkStealingPool pool(num_threads);
+            std::cout << "[INFO] Predicting " << items.size() << (from_dataset ? " samples" : " pcap files")
+                      << " with " << pool.size() << " threads" << std::endl;
+
+            // 每个工作线程独占的推理缓冲区
+            struct WorkerState
+            {
+                SimpleCNN::InferenceWorkspace ws;
+                std::vector<float> features;
+                std::vector<uint16_t> sizes;
+                std::vector<int8_t> directions;
+            };
+            std::vector<WorkerState> workers(pool.size());
+            for (WorkerState &worker : workers)
+            {
+                worker.ws = model.make_workspace();
+                worker.features.resize(feature_dim);
+            }
+
+            ResultWriter writer(results_out, format, labels, num_labels, items);
+
+            // 数据集样本的计算量很小，按块划分任务；pcap文件的解析开销较大，每个文件一个任务
+            const size_t chunk = from_dataset ? 256 : 1;
+            size_t num_tasks = (items.size() + chunk - 1) / chunk;
+
+            auto start = std::chrono::steady_clock::now();
+            pool.parallel_for(num_tasks, [&](size_t task, size_t worker_index)
+                              {
+                                  WorkerState &worker = workers[worker_index];
+                                  size_t begin = task * chunk, end = std::min(items.size(), begin + chunk);
+                                  for (size_t i = begin; i < end; ++i)
+                                  {
+                                      const uint16_t *sizes;
+                                      const int8_t *directions;
+                                      size_t length;
+                                      if (from_dataset)
+                                      {
+                                          DatasetSample sample = dataset.sample(items[i].dataset_index);
+                                          sizes = sample.sizes;
+                                          directions = sample.directions;
+                                          length = sample.length;
+                                      }
+                                      else
+                                      {
+                                          load_records_from_pcap(parser, items[i].source, worker.sizes, worker.directions);
+                                          sizes = worker.sizes.data();
+                                          directions = worker.directions.data();
+                                          length = worker.sizes.size();
+                                      }
+                                      if (length == 0)
+                                          continue;
+
+                                      Featurizer::extract_features(sizes, directions, length, sequence_length,
+                                                                   worker.features.data());
+                                      std::span<const float> probabilities = model.forward(worker.features, worker.ws);
+                                      std::copy(probabilities.begin(), probabilities.end(), writer.slot(i));
+                                      writer.set_predicted(i, static_cast<int>(std::max_element(probabilities.begin(), probabilities.end()) -
+                                                                               probabilities.begin()));
+                                  }
+                                  writer.complete(begin, end); });
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::cout << "\n===== Batch Prediction Summary =====" << std::endl;
+            std::cout << "Predicted: " << writer.num_predicted << ", skipped (no TLS records): " << writer.num_empty << std::endl;
+            if (writer.num_labeled > 0)
+            {
+                std::cout << "Accuracy: " << std::fixed << std::setprecision(2)
+                          << 100.0 * writer.num_correct / writer.num_labeled << "% ("
+                          << writer.num_correct << "/" << writer.num_labeled << " with known labels)" << std::endl;
+            }
+            std::cout << "Time: " << std::fixed << std::setprecision(3) << seconds << "s, Speed: "
+                      << std::setprecision(0) << (seconds > 0 ? items.size() / seconds : 0.0) << " samples/s" << std::endl;
+        }
     }
     catch (const std::exception &e)
     {
         std::cerr << "[ERROR] " << e.what() << std::endl;
-        return 1;
+        status = 1;
     }
-}
\ No newline at end of file
+
+    std::cout.rdbuf(stdout_buf);
+    return status;
+}
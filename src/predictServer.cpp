@@ -0,0 +1,92 @@
+#include <iostream>
+#include <string>
+#include <iomanip>
+#include <algorithm>
+#include <csignal>
+#include <atomic>
+
+#include "SimpleCNN.hpp"
+#include "PredictionServer.hpp"
+#include "Metrics.hpp"
+
+// 常驻的预测服务：模型只加载一次，通过Unix域套接字接收特征向量或记录序列，对同时到达的请求做批量推理
+// 客户端见PredictionClient.hpp，predictCNN --server <socket> 使用该服务预测单个文件
+
+const std::string MODEL_PATH = "../model/tls_model.bin";
+
+static std::atomic<bool> running{true};
+
+static void handle_signal(int)
+{
+    running = false;
+}
+
+int main(int argc, char **argv)
+{
+    std::string model_path = MODEL_PATH;
+    PredictionServerOptions options;
+    std::string metrics_json; // --metrics-json PATH 每秒写出指标快照
+    int metrics_port = 0;     // --metrics-port N 在127.0.0.1:N/metrics提供Prometheus格式的指标
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--model" && i + 1 < argc)
+            model_path = argv[++i];
+        else if (arg == "--socket" && i + 1 < argc)
+            options.socket_path = argv[++i];
+        else if (arg == "--max-batch" && i + 1 < argc)
+            options.max_batch = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--batch-us" && i + 1 < argc)
+            options.batch_budget_us = static_cast<uint32_t>(std::max(0, std::atoi(argv[++i])));
+        else if (arg == "--metrics-json" && i + 1 < argc)
+            metrics_json = argv[++i];
+        else if (arg == "--metrics-port" && i + 1 < argc)
+            metrics_port = std::max(0, std::atoi(argv[++i]));
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--model path] [--socket " << options.socket_path << "]"
+                      << " [--max-batch " << options.max_batch << "] [--batch-us " << options.batch_budget_us << "]"
+                      << " [--metrics-json path] [--metrics-port N]" << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        SimpleCNN model = SimpleCNN::load_model(model_path);
+        std::cout << "[INFO] Feature dimension: " << model.get_input_dim() << ", labels: " << model.get_num_labels()
+                  << ", sequence length: " << model.get_metadata().sequence_length << std::endl;
+
+        MetricsExporter metrics_exporter;
+        if (!metrics_json.empty())
+            metrics_exporter.start_json(metrics_json);
+        if (metrics_port > 0 && !metrics_exporter.start_http(metrics_port))
+            return 1;
+
+        PredictionServer server(model, options);
+        if (!server.start())
+            return 1;
+
+        std::signal(SIGINT, handle_signal);
+        std::signal(SIGTERM, handle_signal);
+        server.run(running);
+        server.shutdown();
+
+        const PredictionServer::Stats &stats = server.stats();
+        std::cout << "\n========== Prediction Server Summary ==========" << std::endl;
+        std::cout << "Connections: " << stats.connections << ", requests: " << stats.requests
+                  << ", rejected: " << stats.rejected << std::endl;
+        if (stats.batches > 0)
+        {
+            std::cout << "Batches: " << stats.batches << ", average batch size: " << std::fixed << std::setprecision(2)
+                      << static_cast<double>(stats.requests) / stats.batches << std::endl;
+        }
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+}
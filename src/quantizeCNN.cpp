@@ -0,0 +1,112 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <span>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+#include "TLSDataProcessor.hpp"
+#include "SimpleCNN.hpp"
+#include "QuantizedCNN.hpp"
+
+// 比较int8量化推理与float推理在测试集上的准确率、一致率和单样本耗时
+
+const std::string MODEL_PATH = "../model/tls_model.bin";
+
+static int argmax(std::span<const float> values)
+{
+    return static_cast<int>(std::max_element(values.begin(), values.end()) - values.begin());
+}
+
+int main(int argc, char *argv[])
+{
+    std::string model_path = MODEL_PATH;
+    std::string data_path = TLSDataProcessor::default_data_path();
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--model" && i + 1 < argc)
+            model_path = argv[++i];
+        else if (arg == "--data" && i + 1 < argc)
+            data_path = argv[++i];
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--model path] [--data dataset.bin|features.csv]" << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        SimpleCNN model = SimpleCNN::load_model(model_path);
+        QuantizedCNN quantized(model);
+
+        std::cout << "[INFO] Data file: " << data_path << std::endl;
+        TLSDataProcessor data_processor(data_path);
+        if (data_processor.get_feature_dim() != model.get_input_dim())
+        {
+            std::cerr << "[ERROR] Model input dimension " << model.get_input_dim() << " does not match data dimension "
+                      << data_processor.get_feature_dim() << std::endl;
+            return 1;
+        }
+
+        const auto &test_samples = data_processor.get_test_samples();
+        if (test_samples.empty())
+        {
+            std::cerr << "[ERROR] No test samples" << std::endl;
+            return 1;
+        }
+
+        SimpleCNN::InferenceWorkspace float_ws = model.make_workspace();
+        QuantizedCNN::InferenceWorkspace int8_ws = quantized.make_workspace();
+        std::vector<float> float_probs(model.get_num_labels());
+
+        size_t float_correct = 0, int8_correct = 0, agree = 0;
+        float max_prob_diff = 0.0f;
+        double float_seconds = 0.0, int8_seconds = 0.0;
+        for (const Sample &sample : test_samples)
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::span<const float> probs = model.forward(sample.features, float_ws);
+            auto middle = std::chrono::steady_clock::now();
+            std::span<const float> int8_probs = quantized.forward(sample.features, int8_ws);
+            auto end = std::chrono::steady_clock::now();
+            float_seconds += std::chrono::duration<double>(middle - start).count();
+            int8_seconds += std::chrono::duration<double>(end - middle).count();
+
+            std::copy(probs.begin(), probs.end(), float_probs.begin());
+            int float_pred = argmax(float_probs);
+            int int8_pred = argmax(int8_probs);
+            float_correct += float_pred == sample.label;
+            int8_correct += int8_pred == sample.label;
+            agree += float_pred == int8_pred;
+            for (size_t k = 0; k < float_probs.size(); ++k)
+                max_prob_diff = std::max(max_prob_diff, std::fabs(float_probs[k] - int8_probs[k]));
+        }
+
+        size_t float_bytes = 0;
+        for (const FCLayer *layer : {&model.get_hidden_layer(), &model.get_output_layer()})
+            float_bytes += (layer->get_weights().rows() * layer->get_weights().stride() + layer->get_biases().size()) * sizeof(float);
+        double n = static_cast<double>(test_samples.size());
+
+        std::cout << "\n========== int8 Quantization Report ==========" << std::endl;
+        std::cout << "Test samples: " << test_samples.size() << std::endl;
+        std::cout << "Kernels: float " << kernels::isa_name(kernels::current_isa())
+                  << ", int8 " << kernels::quant_isa_name(kernels::current_quant_isa()) << std::endl;
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << "Accuracy: float " << float_correct / n * 100 << "%, int8 " << int8_correct / n * 100 << "%" << std::endl;
+        std::cout << "Prediction agreement: " << agree / n * 100 << "%" << std::endl;
+        std::cout << "Max probability difference: " << std::setprecision(4) << max_prob_diff << std::endl;
+        std::cout << "Latency per sample: float " << std::setprecision(3) << float_seconds / n * 1e6 << "us, int8 "
+                  << int8_seconds / n * 1e6 << "us" << std::endl;
+        std::cout << "Weight memory: float " << float_bytes << " bytes, int8 " << quantized.weight_bytes() << " bytes" << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
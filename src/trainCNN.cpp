@@ -4,9 +4,15 @@
 #include <vector>
 #include <algorithm>
 #include <random>
+#include <thread>
+#include <span>
+#include <cstdlib>
+#include <sstream>
+#include <memory>
 
 #include "TLSDataProcessor.hpp"
 #include "SimpleCNN.hpp"
+#include "DatasetStream.hpp"
 
 // 优化后的超参数
 const float LEARNING_RATE = 0.001f; // 适中的学习率
@@ -15,141 +21,368 @@ const int BATCH_SIZE = 4;           // 小批量训练
 
 const std::string MODEL_PATH = "../model/tls_model.bin";
 
-int main(int argc, char *argv[])
+// 内存中的全部样本：每个epoch只打乱样本指针，batch为指针数组上的视图，不拷贝样本
+class InMemorySource
 {
-    try
+private:
+    const TLSDataProcessor &data;
+    std::vector<const Sample *> order;
+
+public:
+    explicit InMemorySource(const TLSDataProcessor &data) : data(data)
     {
-        bool continue_training = false;
-        if (argc > 1 && (std::string(argv[1]) == "--continue" || std::string(argv[1]) == "-c"))
+        for (const Sample &sample : data.get_train_samples())
+            order.push_back(&sample);
+    }
+
+    void for_each_train_batch(size_t batch_size, std::mt19937 &rng, const DatasetStream::BatchCallback &fn)
+    {
+        std::shuffle(order.begin(), order.end(), rng);
+        for (size_t i = 0; i < order.size(); i += batch_size)
         {
-            continue_training = true;
+            size_t end = std::min(i + batch_size, order.size());
+            fn(std::span<const Sample *const>(order.data() + i, end - i));
         }
+    }
 
-        std::cout << "============= TLS Traffic Classification =============" << std::endl;
+    float evaluate(const SimpleCNN &model, bool test) const
+    {
+        return model.evaluate(test ? data.get_test_samples() : data.get_train_samples());
+    }
+};
 
-        // 加载和预处理数据
-        std::cout << "[INFO] Loading and preprocessing data..." << std::endl;
-        TLSDataProcessor data_processor("../output/tls_features.csv");
+// 按分片流式读取的二进制数据集，评估时同样逐分片进行
+class StreamSource
+{
+private:
+    DatasetStream &stream;
 
-        int feature_dim = data_processor.get_feature_dim();
-        int num_labels = data_processor.get_num_labels();
+public:
+    explicit StreamSource(DatasetStream &stream) : stream(stream) {}
 
-        std::cout << "[INFO] Flattened Feature dimension: " << feature_dim << std::endl;
-        std::cout << "[INFO] Number of classes: " << num_labels << std::endl;
+    void for_each_train_batch(size_t batch_size, std::mt19937 &rng, const DatasetStream::BatchCallback &fn)
+    {
+        stream.for_each_train_batch(batch_size, rng, fn);
+    }
 
-        // 创建模型
-        SimpleCNN model(feature_dim, num_labels);
+    float evaluate(const SimpleCNN &model, bool test) const
+    {
+        double correct = 0.0;
+        size_t total = 0;
+        stream.for_each_sample_shard(test, [&](std::span<const Sample> shard)
+                                     {
+                                         correct += model.evaluate(shard) * shard.size();
+                                         total += shard.size();
+                                     });
+        return total > 0 ? static_cast<float>(correct / total) : 0.0f;
+    }
+};
 
-        // 尝试加载已有模型
-        if (continue_training)
+/*
+@brief 训练模型直到早停、达到目标准确率或训练完所有轮数
+@param source 训练数据，InMemorySource或StreamSource
+@param save_path 测试准确率提高时保存模型的路径，为空时不保存
+@return 最佳测试准确率
+*/
+template <typename Source>
+static float train_model(SimpleCNN &model, Source &source, int batch_size, const std::string &save_path)
+{
+    std::cout << "[INFO] Starting training..." << std::endl;
+
+    float learning_rate = LEARNING_RATE;
+    float best_test_acc = 0.0f;
+    int patience = 0;
+    const int max_patience = 30;
+
+    // 训练吞吐量：统计自上次输出以来训练的样本数和耗时(不含评估)
+    size_t samples_since_report = 0;
+    double train_seconds_since_report = 0.0;
+
+    for (int epoch = 0; epoch < EPOCHS; ++epoch)
+    {
+        float epoch_loss = 0.0f;
+        int num_batches = 0;
+
+        // 随机打乱训练数据(只打乱索引)并批量训练
+        std::random_device rd;
+        std::mt19937 g(rd());
+        size_t epoch_samples = 0;
+        model.reset_train_accuracy();
+        auto epoch_start = std::chrono::high_resolution_clock::now();
+        source.for_each_train_batch(batch_size, g, [&](std::span<const Sample *const> batch)
+                                    {
+                                        float batch_loss = model.train_batch(batch, learning_rate);
+                                        epoch_samples += batch.size();
+
+                                        if (!std::isnan(batch_loss) && !std::isinf(batch_loss) && batch_loss < 10.0f)
+                                        {
+                                            epoch_loss += batch_loss;
+                                            num_batches++;
+                                        }
+                                    });
+
+        if (num_batches > 0)
         {
-            try
+            epoch_loss /= num_batches;
+        }
+        samples_since_report += epoch_samples;
+        train_seconds_since_report += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - epoch_start).count();
+
+        // 每10轮评估一次；训练准确率取本轮训练时累计的值(每个batch更新前的预测)，不再对训练集重新前向传播
+        if (epoch % 10 == 0 || epoch == EPOCHS - 1)
+        {
+            float train_acc = model.get_train_accuracy();
+            float test_acc = source.evaluate(model, true);
+
+            std::cout << "Epoch " << std::setw(3) << epoch + 1
+                      << ", Loss: " << std::fixed << std::setprecision(4) << epoch_loss
+                      << ", Train: " << std::fixed << std::setprecision(1) << (train_acc * 100) << "%"
+                      << ", Test: " << std::fixed << std::setprecision(1) << (test_acc * 100) << "%"
+                      << ", LR: " << std::scientific << std::setprecision(1) << learning_rate
+                      << ", Speed: " << std::fixed << std::setprecision(0)
+                      << samples_since_report / std::max(train_seconds_since_report, 1e-9) << " samples/s" << std::endl;
+            samples_since_report = 0;
+            train_seconds_since_report = 0.0;
+
+            // 保存最佳模型
+            if (test_acc > best_test_acc)
             {
-                model = SimpleCNN::load_model(MODEL_PATH, feature_dim, num_labels);
-                std::cout << "[INFO] Continuing from existing model" << std::endl;
+                best_test_acc = test_acc;
+                patience = 0;
+                if (!save_path.empty())
+                    model.save_model(save_path);
+                std::cout << "[INFO] New best test accuracy: "
+                          << std::fixed << std::setprecision(1) << (test_acc * 100) << "%" << std::endl;
             }
-            catch (const std::exception &e)
+            else
             {
-                std::cout << "[INFO] Starting with new model: " << e.what() << std::endl;
+                patience++;
+            }
+
+            // 早停机制
+            if (patience >= max_patience)
+            {
+                std::cout << "[INFO] Early stopping - no improvement for "
+                          << max_patience << " evaluations" << std::endl;
+                break;
+            }
+
+            // 达到目标准确率
+            if (test_acc > 0.85f && train_acc > 0.85f)
+            {
+                std::cout << "[INFO] Target accuracy reached!" << std::endl;
+                break;
             }
         }
 
-        const auto &train_samples = data_processor.get_train_samples();
-        const auto &test_samples = data_processor.get_test_samples();
+        // 学习率衰减
+        if (epoch > 0 && epoch % 50 == 0)
+        {
+            learning_rate *= 0.8f;
+            learning_rate = std::max(learning_rate, 1e-5f);
+            std::cout << "[INFO] Learning rate decreased to: "
+                      << std::scientific << learning_rate << std::endl;
+        }
+    }
 
-        std::cout << "[INFO] Starting training..." << std::endl;
+    return best_test_acc;
+}
 
-        float learning_rate = LEARNING_RATE;
-        float best_test_acc = 0.0f;
-        int patience = 0;
-        const int max_patience = 30;
+// 解析 "4,8,16,32" 形式的窗口长度列表
+static std::vector<int> parse_window_list(const std::string &list)
+{
+    std::vector<int> windows;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        int k = std::atoi(item.c_str());
+        if (k > 0)
+            windows.push_back(k);
+    }
+    return windows;
+}
 
-        auto start_time = std::chrono::high_resolution_clock::now();
+/*
+@brief 对每个窗口长度K用相同的训练/测试划分各训练一个模型，报告准确率随K的变化。
+       K即在线分类需要等待的记录数，用于在分类延迟和准确率之间折中。不覆盖已保存的模型
+*/
+static int sweep_windows(const std::string &data_path, const std::vector<int> &windows, TruncationPolicy policy,
+                         unsigned seed, size_t num_threads, size_t eval_threads, int batch_size)
+{
+    struct SweepResult
+    {
+        int records;
+        int feature_dim;
+        double mean_records;
+        size_t truncated;
+        size_t samples;
+        float test_acc;
+        double seconds;
+    };
+    std::vector<SweepResult> results;
 
-        for (int epoch = 0; epoch < EPOCHS; ++epoch)
-        {
-            float epoch_loss = 0.0f;
-            int num_batches = 0;
+    for (int k : windows)
+    {
+        std::cout << "\n========== Window: first " << k << " records ==========" << std::endl;
+        FeatureWindow window;
+        window.max_records = k;
+        window.policy = policy;
+        TLSDataProcessor data_processor(data_path, window, seed);
 
-            // 随机打乱训练数据
-            std::vector<Sample> shuffled_samples = train_samples;
-            std::random_device rd;
-            std::mt19937 g(rd());
-            std::shuffle(shuffled_samples.begin(), shuffled_samples.end(), g);
+        SimpleCNN model(data_processor.get_feature_dim(), data_processor.get_num_labels());
+        model.set_num_threads(num_threads);
+        model.set_eval_threads(eval_threads);
+        auto start_time = std::chrono::high_resolution_clock::now();
+        InMemorySource source(data_processor);
+        float best_test_acc = train_model(model, source, batch_size, "");
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
 
-            // 批量训练
-            for (size_t i = 0; i < shuffled_samples.size(); i += BATCH_SIZE)
-            {
-                std::vector<Sample> batch;
-                size_t batch_end = std::min(i + BATCH_SIZE, shuffled_samples.size());
-                batch.assign(shuffled_samples.begin() + i, shuffled_samples.begin() + batch_end);
+        results.push_back({k, data_processor.get_feature_dim(), data_processor.get_mean_records(),
+                           data_processor.get_truncated_samples(),
+                           data_processor.get_train_samples().size() + data_processor.get_test_samples().size(),
+                           best_test_acc, seconds});
+    }
 
-                float batch_loss = model.train_batch(batch, learning_rate);
+    std::cout << "\n========== Accuracy vs. Window Size ==========" << std::endl;
+    std::cout << "Split seed: " << seed << ", policy: " << (policy == TruncationPolicy::DROP ? "drop" : "head") << std::endl;
+    std::cout << std::setw(8) << "Records" << std::setw(12) << "Input dim" << std::setw(14) << "Mean waited"
+              << std::setw(12) << "Truncated" << std::setw(12) << "Test acc" << std::setw(10) << "Time" << std::endl;
+    for (const SweepResult &r : results)
+    {
+        std::cout << std::setw(8) << r.records << std::setw(12) << r.feature_dim
+                  << std::setw(14) << std::fixed << std::setprecision(1) << r.mean_records
+                  << std::setw(7) << r.truncated << "/" << std::left << std::setw(4) << r.samples << std::right
+                  << std::setw(11) << std::setprecision(1) << r.test_acc * 100 << "%"
+                  << std::setw(9) << std::setprecision(0) << r.seconds << "s" << std::endl;
+    }
+    return 0;
+}
 
-                if (!std::isnan(batch_loss) && !std::isinf(batch_loss) && batch_loss < 10.0f)
+int main(int argc, char *argv[])
+{
+    try
+    {
+        bool continue_training = false;
+        std::string data_path; // --data PATH 可以重复指定，多个分片目录(各节点的预处理输出)合并为一个数据集
+        size_t num_threads = 1; // --threads N 数据并行训练的线程数，0表示使用全部硬件线程
+        size_t eval_threads = std::max(1u, std::thread::hardware_concurrency()); // --eval-threads N 评估测试集的线程数，与训练线程数无关
+        int batch_size = BATCH_SIZE; // --batch N 多线程时batch需足够大，每个线程才能分到足够的样本
+        FeatureWindow window;        // --records K 只使用每个样本的前K条记录，--truncate head|drop 超出部分的处理方式
+        std::vector<int> sweep;      // --sweep K1,K2,... 评估准确率随窗口长度的变化
+        unsigned seed = 0;           // --seed N 训练/测试划分的随机种子
+        size_t shard_size = 0;       // --stream N 按N个样本一个分片流式读取二进制数据集，0表示全部加载到内存
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--continue" || arg == "-c")
+                continue_training = true;
+            else if (arg == "--data" && i + 1 < argc)
+                data_path += (data_path.empty() ? "" : ",") + std::string(argv[++i]);
+            else if (arg == "--threads" && i + 1 < argc)
+            {
+                int n = std::atoi(argv[++i]);
+                num_threads = n > 0 ? static_cast<size_t>(n) : std::max(1u, std::thread::hardware_concurrency());
+            }
+            else if (arg == "--eval-threads" && i + 1 < argc)
+            {
+                int n = std::atoi(argv[++i]);
+                eval_threads = n > 0 ? static_cast<size_t>(n) : std::max(1u, std::thread::hardware_concurrency());
+            }
+            else if (arg == "--batch" && i + 1 < argc)
+                batch_size = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--records" && i + 1 < argc)
+                window.max_records = std::max(0, std::atoi(argv[++i]));
+            else if (arg == "--truncate" && i + 1 < argc)
+            {
+                std::string policy = argv[++i];
+                if (policy != "head" && policy != "drop")
                 {
-                    epoch_loss += batch_loss;
-                    num_batches++;
+                    std::cerr << "[ERROR] Unknown truncation policy: " << policy << " (expected head or drop)" << std::endl;
+                    return 1;
                 }
+                window.policy = policy == "drop" ? TruncationPolicy::DROP : TruncationPolicy::HEAD;
             }
+            else if (arg == "--sweep" && i + 1 < argc)
+                sweep = parse_window_list(argv[++i]);
+            else if (arg == "--seed" && i + 1 < argc)
+                seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+            else if (arg == "--stream" && i + 1 < argc)
+                shard_size = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        }
+        if (data_path.empty())
+            data_path = TLSDataProcessor::default_data_path();
 
-            if (num_batches > 0)
-            {
-                epoch_loss /= num_batches;
-            }
+        std::cout << "============= TLS Traffic Classification =============" << std::endl;
+
+        if (!sweep.empty())
+        {
+            if (seed == 0)
+                seed = std::random_device{}(); // 所有窗口使用同一划分，结果才可比较
+            return sweep_windows(data_path, sweep, window.policy, seed, num_threads, eval_threads, batch_size);
+        }
 
-            // 每10轮评估一次
-            if (epoch % 10 == 0 || epoch == EPOCHS - 1)
+        // 加载和预处理数据
+        std::cout << "[INFO] Loading and preprocessing data..." << std::endl;
+        std::cout << "[INFO] Data file: " << data_path << std::endl;
+        std::unique_ptr<TLSDataProcessor> data_processor;
+        std::unique_ptr<DatasetStream> stream;
+        if (shard_size > 0)
+        {
+            if (!dataset_format::is_dataset_file(data_path) && !shard_format::is_sharded(data_path))
             {
-                float train_acc = model.evaluate(train_samples);
-                float test_acc = model.evaluate(test_samples);
+                std::cerr << "[ERROR] --stream requires a binary dataset (tls_features.bin or shard directories): " << data_path << std::endl;
+                return 1;
+            }
+            stream = std::make_unique<DatasetStream>(data_path, window, seed, shard_size);
+        }
+        else
+            data_processor = std::make_unique<TLSDataProcessor>(data_path, window, seed);
 
-                std::cout << "Epoch " << std::setw(3) << epoch + 1
-                          << ", Loss: " << std::fixed << std::setprecision(4) << epoch_loss
-                          << ", Train: " << std::fixed << std::setprecision(1) << (train_acc * 100) << "%"
-                          << ", Test: " << std::fixed << std::setprecision(1) << (test_acc * 100) << "%"
-                          << ", LR: " << std::scientific << std::setprecision(1) << learning_rate << std::endl;
+        int feature_dim = stream ? stream->get_feature_dim() : data_processor->get_feature_dim();
+        int num_labels = stream ? stream->get_num_labels() : data_processor->get_num_labels();
 
-                // 保存最佳模型
-                if (test_acc > best_test_acc)
-                {
-                    best_test_acc = test_acc;
-                    patience = 0;
-                    model.save_model(MODEL_PATH);
-                    std::cout << "[INFO] New best test accuracy: "
-                              << std::fixed << std::setprecision(1) << (test_acc * 100) << "%" << std::endl;
-                }
-                else
-                {
-                    patience++;
-                }
+        std::cout << "[INFO] Flattened Feature dimension: " << feature_dim << std::endl;
+        std::cout << "[INFO] Number of classes: " << num_labels << std::endl;
 
-                // 早停机制
-                if (patience >= max_patience)
-                {
-                    std::cout << "[INFO] Early stopping - no improvement for "
-                              << max_patience << " evaluations" << std::endl;
-                    break;
-                }
+        // 创建模型
+        SimpleCNN model(feature_dim, num_labels);
 
-                // 达到目标准确率
-                if (test_acc > 0.85f && train_acc > 0.85f)
-                {
-                    std::cout << "[INFO] Target accuracy reached!" << std::endl;
-                    break;
-                }
+        // 尝试加载已有模型
+        if (continue_training)
+        {
+            try
+            {
+                model = SimpleCNN::load_model(MODEL_PATH, feature_dim, num_labels);
+                std::cout << "[INFO] Continuing from existing model" << std::endl;
             }
-
-            // 学习率衰减
-            if (epoch > 0 && epoch % 50 == 0)
+            catch (const std::exception &e)
             {
-                learning_rate *= 0.8f;
-                learning_rate = std::max(learning_rate, 1e-5f);
-                std::cout << "[INFO] Learning rate decreased to: "
-                          << std::scientific << learning_rate << std::endl;
+                std::cout << "[INFO] Starting with new model: " << e.what() << std::endl;
             }
         }
 
+        model.set_labels(stream ? stream->get_label_names() : data_processor->get_label_names()); // 标签表随模型保存，预测时不再需要site_labels.csv
+        model.set_num_threads(num_threads);
+        model.set_eval_threads(eval_threads);
+        std::cout << "[INFO] Training threads: " << model.get_num_threads() << ", batch size: " << batch_size
+                  << ", evaluation threads: " << model.get_eval_threads() << std::endl;
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        std::unique_ptr<InMemorySource> memory_source;
+        std::unique_ptr<StreamSource> stream_source;
+        float best_test_acc;
+        if (stream)
+        {
+            stream_source = std::make_unique<StreamSource>(*stream);
+            best_test_acc = train_model(model, *stream_source, batch_size, MODEL_PATH);
+        }
+        else
+        {
+            memory_source = std::make_unique<InMemorySource>(*data_processor);
+            best_test_acc = train_model(model, *memory_source, batch_size, MODEL_PATH);
+        }
+
         auto end_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time).count();
 
@@ -159,8 +392,8 @@ int main(int argc, char *argv[])
                   << (best_test_acc * 100) << "%" << std::endl;
 
         // 最终评估
-        float final_train_acc = model.evaluate(train_samples);
-        float final_test_acc = model.evaluate(test_samples);
+        float final_train_acc = stream ? stream_source->evaluate(model, false) : memory_source->evaluate(model, false);
+        float final_test_acc = stream ? stream_source->evaluate(model, true) : memory_source->evaluate(model, true);
 
         std::cout << "Final train accuracy: " << std::fixed << std::setprecision(1)
                   << (final_train_acc * 100) << "%" << std::endl;